@@ -0,0 +1,111 @@
+#include <onix/types.h>
+#include <onix/stdio.h>
+#include <onix/stdlib.h>
+#include <onix/string.h>
+#include <onix/syscall.h>
+#include <onix/memory.h>
+#include <onix/spawn.h>
+#include <onix/errno.h>
+
+// fork + execve 延迟测试，模拟 osh 执行命令的过程，并与 posix_spawn 对比
+// 用法：forkexec [预先占用的页数]
+// 预先占用的页数用于模拟较大的父进程，fork 的开销与其相关
+
+#define DURATION 5 // 每项测试时长（秒）
+
+#define PROGRAM "/bin/forkexec.out"
+#define CHILD "child"
+
+extern char _end[];
+
+static void touch(u32 start, u32 count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        *(u32 *)(start + i * PAGE_SIZE) = i;
+    }
+}
+
+// 等待整秒边界，减少计时误差
+static void align()
+{
+    time_t now = time();
+    while (time() == now)
+        ;
+}
+
+static u32 bench(bool exec)
+{
+    // execve 的参数不包括程序名
+    char *argv[] = {CHILD, NULL};
+    int status;
+    u32 count = 0;
+
+    align();
+    time_t begin = time();
+    while (time() - begin < DURATION)
+    {
+        pid_t pid = fork();
+        if (!pid)
+        {
+            if (exec)
+                execve(PROGRAM, argv, NULL);
+            exit(0);
+        }
+        waitpid(pid, &status);
+        count++;
+    }
+    return count;
+}
+
+static u32 bench_spawn()
+{
+    char *argv[] = {CHILD, NULL};
+    int status;
+    u32 count = 0;
+
+    align();
+    time_t begin = time();
+    while (time() - begin < DURATION)
+    {
+        pid_t pid;
+        int err = posix_spawn(&pid, PROGRAM, NULL, NULL, argv, NULL);
+        if (err != EOK)
+        {
+            printf("spawn %s error %d\n", PROGRAM, err);
+            exit(-1);
+        }
+        waitpid(pid, &status);
+        count++;
+    }
+    return count;
+}
+
+int main(int argc, char const *argv[])
+{
+    // 被执行的子进程直接退出
+    if (argc > 1 && !strcmp(argv[1], CHILD))
+        return 0;
+
+    u32 ballast = 0;
+    if (argc > 1)
+        ballast = atoi(argv[1]);
+
+    u32 base = ((u32)_end + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    if (brk((void *)(base + ballast * PAGE_SIZE)) < 0)
+    {
+        printf("ballast %d pages out of memory\n", ballast);
+        return -1;
+    }
+    touch(base, ballast);
+
+    u32 forks = bench(false);
+    u32 execs = bench(true);
+    u32 spawns = bench_spawn();
+
+    printf("forkexec: %d ballast pages\n", ballast);
+    printf("forkexec: fork+exit %d/s %d us\n", forks / DURATION, DURATION * 1000000 / forks);
+    printf("forkexec: fork+exec %d/s %d us\n", execs / DURATION, DURATION * 1000000 / execs);
+    printf("forkexec: spawn     %d/s %d us\n", spawns / DURATION, DURATION * 1000000 / spawns);
+    return 0;
+}
@@ -1,6 +1,8 @@
 #include <onix/types.h>
 #include <onix/stdio.h>
 #include <onix/syscall.h>
+#include <onix/spawn.h>
+#include <onix/errno.h>
 
 int main()
 {
@@ -13,18 +15,15 @@ int main()
     while (true)
     {
         u32 status;
-        pid_t pid = fork();
-        if (pid)
+        pid_t pid;
+        int err = posix_spawn(&pid, "/bin/osh.out", NULL, NULL, NULL, NULL);
+        if (err != EOK)
         {
-            pid_t child = waitpid(pid, &status);
-            printf("wait pid %d status %d %d\n", child, status, time());
-        }
-        else
-        {
-            int err = execve("/bin/osh.out", NULL, NULL);
-            printf("execve /bin/osh.out error %d\n", err);
-            exit(err);
+            printf("spawn /bin/osh.out error %d\n", err);
+            return err;
         }
+        pid_t child = waitpid(pid, &status);
+        printf("wait pid %d status %d %d\n", child, status, time());
     }
     return 0;
 }
@@ -0,0 +1,88 @@
+#include <onix/types.h>
+#include <onix/stdio.h>
+#include <onix/stdlib.h>
+#include <onix/string.h>
+#include <onix/syscall.h>
+
+// 内存分配测试，随机释放并重新分配若干槽位中的对象，统计每秒分配次数
+// 用法：mallocbench [槽位数量] [最大对象字节数]
+// 对象大小大多是小对象，少量中等对象，偶尔有 mmap 分配的大对象
+
+#define DURATION 5     // 测试时长（秒）
+#define SLOT_MAX 4096  // 最大槽位数量
+#define LARGE_SIZE 0x40000
+
+static void *slots[SLOT_MAX];
+static u32 seed = 1;
+
+static u32 rand()
+{
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+static u32 rand_size(u32 max)
+{
+    u32 r = rand() % 1000;
+    if (r < 900)
+        return rand() % MIN(max, 256) + 1;
+    if (r < 990)
+        return rand() % MIN(max, 4096) + 1;
+    if (r < 999)
+        return rand() % MIN(max, 65536) + 1;
+    return MIN(max, LARGE_SIZE);
+}
+
+int main(int argc, char const *argv[])
+{
+    u32 count = 1024;
+    u32 max = LARGE_SIZE;
+
+    if (argc > 1)
+        count = MIN(atoi(argv[1]), SLOT_MAX);
+    if (argc > 2)
+        max = atoi(argv[2]);
+
+    u32 allocs = 0;
+    u32 failed = 0;
+
+    // 等待整秒边界，减少计时误差
+    time_t now = time();
+    while (time() == now)
+        ;
+
+    time_t begin = time();
+    while (time() - begin < DURATION)
+    {
+        // 每次检查时间之前做一批操作，减少系统调用的影响
+        for (size_t i = 0; i < 1024; i++)
+        {
+            u32 idx = rand() % count;
+            free(slots[idx]);
+
+            u32 size = rand_size(max);
+            slots[idx] = malloc(size);
+            if (!slots[idx])
+            {
+                failed++;
+                continue;
+            }
+
+            // 访问首尾字节，模拟实际使用
+            char *ptr = slots[idx];
+            ptr[0] = 1;
+            ptr[size - 1] = 1;
+            allocs++;
+        }
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        free(slots[i]);
+        slots[i] = NULL;
+    }
+
+    printf("mallocbench: %d slots, max %d bytes\n", count, max);
+    printf("mallocbench: %d allocs %d failed %d allocs/s\n", allocs, failed, allocs / DURATION);
+    return 0;
+}
@@ -0,0 +1,69 @@
+#include <onix/types.h>
+#include <onix/stdio.h>
+#include <onix/stdlib.h>
+#include <onix/string.h>
+#include <onix/syscall.h>
+#include <onix/memory.h>
+
+// 系统调用访问还没有缺页映射的缓冲区
+// 匿名映射、大块 malloc 和堆都在第一次访问时才映射，read/write 不能因此返回错误
+// 用法：mmapio
+
+#define MSG "onix mmap io"
+#define MSG_LEN (sizeof(MSG) - 1)
+
+static int failed = 0;
+
+static void check(bool ok, char *name)
+{
+    printf("mmapio: %s %s\n", name, ok ? "ok" : "failed");
+    if (!ok)
+        failed++;
+}
+
+// 通过管道读入 buf，buf 的页还没有被访问过
+static void read_into(fd_t pipefd[2], char *buf, char *name)
+{
+    write(pipefd[1], MSG, MSG_LEN);
+    int len = read(pipefd[0], buf, MSG_LEN);
+    check(len == MSG_LEN && !memcmp(buf, MSG, MSG_LEN), name);
+}
+
+int main(int argc, char const *argv[])
+{
+    fd_t pipefd[2];
+    if (pipe(pipefd) < 0)
+    {
+        printf("mmapio: pipe failed\n");
+        return -1;
+    }
+
+    // 跨越两页的匿名映射
+    char *map = mmap(NULL, PAGE_SIZE * 2, PROT_READ | PROT_WRITE, MAP_PRIVATE, EOF, 0);
+    read_into(pipefd, map + PAGE_SIZE - MSG_LEN / 2, "read anonymous map");
+
+    // 从没有访问过的页写出，内容应该为 0
+    char *zero = mmap(NULL, PAGE_SIZE, PROT_READ, MAP_PRIVATE, EOF, 0);
+    int len = write(pipefd[1], zero, MSG_LEN);
+    char buf[MSG_LEN];
+    bool ok = len == MSG_LEN && read(pipefd[0], buf, MSG_LEN) == MSG_LEN;
+    for (size_t i = 0; ok && i < MSG_LEN; i++)
+    {
+        ok = buf[i] == 0;
+    }
+    check(ok, "write anonymous map");
+
+    // 只读的映射不能作为 read 的缓冲区
+    check(read(pipefd[0], zero, MSG_LEN) < 0, "read readonly map");
+
+    // 大块 malloc 使用匿名映射
+    char *large = malloc(256 * 1024);
+    read_into(pipefd, large + 128 * 1024, "read malloc");
+    free(large);
+
+    munmap(map, PAGE_SIZE * 2);
+    munmap(zero, PAGE_SIZE);
+    close(pipefd[0]);
+    close(pipefd[1]);
+    return failed ? -1 : 0;
+}
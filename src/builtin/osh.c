@@ -14,6 +14,7 @@
 #include <onix/tty.h>
 #include <onix/errno.h>
 #include <onix/signal.h>
+#include <onix/spawn.h>
 
 #define MAX_CMD_LEN 256
 #define MAX_ARG_NR 16
@@ -89,7 +90,12 @@ void builtin_logo()
 
 void builtin_test(int argc, char *argv[])
 {
-    test();
+    if (argc < 2)
+    {
+        test(NULL);
+        return;
+    }
+    print_error(test(argv[1]));
 }
 
 void builtin_pwd()
@@ -172,6 +178,15 @@ void builtin_umount(int argc, char *argv[])
     print_error(umount(argv[1]));
 }
 
+void builtin_swapon(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        return;
+    }
+    print_error(swapon(argv[1]));
+}
+
 void builtin_mkfs(int argc, char *argv[])
 {
     if (argc < 2)
@@ -279,58 +294,60 @@ rollback:
     return EOF;
 }
 
+// 添加子进程的重定向操作
+static void redirect(posix_spawn_file_actions_t *actions, fd_t fd, fd_t newfd)
+{
+    if (fd == EOF)
+        return;
+    posix_spawn_file_actions_adddup2(actions, fd, newfd);
+    posix_spawn_file_actions_addclose(actions, fd);
+}
+
 pid_t builtin_command(char *filename, char *argv[], fd_t infd, fd_t outfd, fd_t errfd, pid_t *pgid)
 {
-    int status;
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    redirect(&actions, infd, STDIN_FILENO);
+    redirect(&actions, outfd, STDOUT_FILENO);
+    redirect(&actions, errfd, STDERR_FILENO);
+
+    // 设置进程组 pgid，恢复 SIGINT 默认处理
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGDEF);
+    posix_spawnattr_setpgroup(&attr, *pgid);
+    posix_spawnattr_setsigdefault(&attr, SIGMASK(SIGINT));
+
+    // 不拷贝 osh 的地址空间，直接创建子进程执行程序
+    pid_t pid;
+    int err = posix_spawn(&pid, filename, &actions, &attr, argv, envp);
 
-    pid_t pid = fork();
-    if (pid)
-    {
-        if (infd != EOF)
-        {
-            close(infd);
-        }
-        if (outfd != EOF)
-        {
-            close(outfd);
-        }
-        if (errfd != EOF)
-        {
-            close(errfd);
-        }
-        if (*pgid == 0)
-        {
-            *pgid = pid;
-        }
-        return pid;
-    }
     if (infd != EOF)
     {
-        fd_t fd = dup2(infd, STDIN_FILENO);
         close(infd);
     }
     if (outfd != EOF)
     {
-        fd_t fd = dup2(outfd, STDOUT_FILENO);
         close(outfd);
     }
     if (errfd != EOF)
     {
-        fd_t fd = dup2(errfd, STDERR_FILENO);
         close(errfd);
     }
 
-    // 设置进程组 pgid
-    setpgid(0, *pgid);
+    if (err != EOK)
+    {
+        printf("osh: %s: %s\n", filename, strerror(err));
+        return EOF;
+    }
+
     if (*pgid == 0)
     {
+        *pgid = pid;
         // 设置 TTY 前台进程组为第一个进程
-        ioctl(STDIN_FILENO, TIOCSPGRP, getpid());
+        ioctl(STDIN_FILENO, TIOCSPGRP, pid);
     }
-
-    signal(SIGINT, (int)SIG_DFL);
-    int i = execve(filename, argv, envp);
-    exit(i);
+    return pid;
 }
 
 void builtin_exec(int argc, char *argv[])
@@ -360,8 +377,8 @@ void builtin_exec(int argc, char *argv[])
         {
             argv[i] = NULL;
             int ret = pipe(pipefd);
-            builtin_command(name, bargv, infd, pipefd[1], EOF, &pgid);
-            count++;
+            if (builtin_command(name, bargv, infd, pipefd[1], EOF, &pgid) != EOF)
+                count++;
             infd = pipefd[0];
             int len = strlen(name) + 1;
             name += len;
@@ -384,10 +401,11 @@ void builtin_exec(int argc, char *argv[])
         p = false;
     }
 
-    int pid = builtin_command(name, bargv, infd, dupfd[1], dupfd[2], &pgid);
+    if (builtin_command(name, bargv, infd, dupfd[1], dupfd[2], &pgid) != EOF)
+        count++;
 
     // 等待所有子进程运行结束
-    for (size_t i = 0; i <= count;)
+    for (size_t i = 0; i < count;)
     {
         pid_t child = waitpid(-1, &status);
         if (child > 0)
@@ -459,6 +477,10 @@ static void execute(int argc, char *argv[])
     {
         return builtin_mkfs(argc, argv);
     }
+    if (!strcmp(line, "swapon"))
+    {
+        return builtin_swapon(argc, argv);
+    }
     return builtin_exec(argc, argv);
 }
 
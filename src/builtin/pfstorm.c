@@ -0,0 +1,68 @@
+#include <onix/types.h>
+#include <onix/stdio.h>
+#include <onix/stdlib.h>
+#include <onix/syscall.h>
+#include <onix/memory.h>
+
+// 缺页风暴测试，反复扩大堆内存并逐页写入，触发缺页分配物理页，再缩小堆释放
+// 用法：pfstorm [每轮页数] [预先占用的页数]
+// 预先占用的页数用于模拟内存逐渐被占满的情况
+
+#define DURATION 5 // 测试时长（秒）
+
+extern char _end[];
+
+static void touch(u32 start, u32 count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        *(u32 *)(start + i * PAGE_SIZE) = i;
+    }
+}
+
+int main(int argc, char const *argv[])
+{
+    u32 count = 256;
+    u32 ballast = 0;
+
+    if (argc > 1)
+        count = atoi(argv[1]);
+    if (argc > 2)
+        ballast = atoi(argv[2]);
+
+    u32 base = ((u32)_end + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    u32 start = base + ballast * PAGE_SIZE;
+
+    if (brk((void *)start) < 0)
+    {
+        printf("ballast %d pages out of memory\n", ballast);
+        return -1;
+    }
+    touch(base, ballast);
+
+    u32 faults = 0;
+    u32 rounds = 0;
+
+    // 等待整秒边界，减少计时误差
+    time_t now = time();
+    while (time() == now)
+        ;
+
+    time_t begin = time();
+    while (time() - begin < DURATION)
+    {
+        if (brk((void *)(start + count * PAGE_SIZE)) < 0)
+        {
+            printf("storm %d pages out of memory\n", count);
+            return -1;
+        }
+        touch(start, count);
+        brk((void *)start);
+        faults += count;
+        rounds++;
+    }
+
+    printf("pfstorm: %d pages per round, %d ballast pages\n", count, ballast);
+    printf("pfstorm: %d rounds %d faults %d faults/s\n", rounds, faults, faults / DURATION);
+    return 0;
+}
@@ -11,14 +11,20 @@
 static char tx_buf[BUFLEN];
 static char rx_buf[BUFLEN];
 
-static int ping_input(ip_t *ip, ip_addr_t addr, size_t bytes)
+// 两个时间相差的微秒数
+static u32 elapsed_us(timespec_t *start, timespec_t *end)
+{
+    return (end->tv_sec - start->tv_sec) * 1000000 + (end->tv_nsec - start->tv_nsec) / 1000;
+}
+
+static int ping_input(ip_t *ip, ip_addr_t addr, size_t bytes, u32 us)
 {
     if (ip->proto != IP_PROTOCOL_ICMP)
         return EOK;
 
     icmp_echo_t *echo = ip->echo;
-    printf("%d bytes from %r: icmp_seq=%d ttl=%d icmp=%d\n",
-           bytes, ip->src, echo->seq, ip->ttl, echo->type);
+    printf("%d bytes from %r: icmp_seq=%d ttl=%d icmp=%d time=%d.%03d ms\n",
+           bytes, ip->src, echo->seq, ip->ttl, echo->type, us / 1000, us % 1000);
     return EOK;
 }
 
@@ -77,6 +83,7 @@ int main(int argc, char const *argv[])
 
     u32 len = sizeof(icmp_echo_t) + sizeof(message);
 
+    timespec_t start, end;
     int count = 4;
     while (count--)
     {
@@ -84,6 +91,7 @@ int main(int argc, char const *argv[])
         echo->chksum = 0;
         echo->chksum = ip_chksum(echo, len);
 
+        clock_gettime(CLOCK_MONOTONIC, &start);
         ret = send(fd, tx_buf, len + sizeof(ip_t), 0);
         if (ret < 0)
         {
@@ -92,6 +100,7 @@ int main(int argc, char const *argv[])
         }
 
         ret = recv(fd, rx_buf, sizeof(rx_buf), 0);
+        clock_gettime(CLOCK_MONOTONIC, &end);
         if (ret == -ETIME)
         {
             printf("ping %r timeout...\n", addr);
@@ -104,7 +113,7 @@ int main(int argc, char const *argv[])
             goto rollback;
         }
 
-        ret = ping_input((ip_t *)rx_buf, addr, ret);
+        ret = ping_input((ip_t *)rx_buf, addr, ret, elapsed_us(&start, &end));
         if (ret < 0)
         {
             printf("input error\n");
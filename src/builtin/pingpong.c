@@ -0,0 +1,65 @@
+#include <onix/types.h>
+#include <onix/stdio.h>
+#include <onix/syscall.h>
+
+// 进程切换测试，父子进程通过两个管道来回传递一个字节
+// 每个来回至少包含两次进程切换，每次切换都会重新加载页目录
+// 用法：pingpong
+
+#define DURATION 5 // 测试时长（秒）
+
+int main(int argc, char const *argv[])
+{
+    fd_t ping[2];
+    fd_t pong[2];
+    if (pipe(ping) < 0 || pipe(pong) < 0)
+    {
+        printf("pingpong: pipe error\n");
+        return -1;
+    }
+
+    char ch = 0;
+    pid_t pid = fork();
+    if (!pid)
+    {
+        close(ping[1]);
+        close(pong[0]);
+        while (read(ping[0], &ch, 1) == 1 && ch)
+        {
+            write(pong[1], &ch, 1);
+        }
+        exit(0);
+    }
+
+    close(ping[0]);
+    close(pong[1]);
+
+    u32 rounds = 0;
+
+    // 等待整秒边界，减少计时误差
+    time_t now = time();
+    while (time() == now)
+        ;
+
+    time_t begin = time();
+    while (time() - begin < DURATION)
+    {
+        ch = 1;
+        write(ping[1], &ch, 1);
+        read(pong[0], &ch, 1);
+        rounds++;
+    }
+
+    // 通知子进程退出
+    ch = 0;
+    write(ping[1], &ch, 1);
+
+    int status;
+    waitpid(pid, &status);
+
+    // 每个来回两次切换
+    u32 rate = rounds * 2 / DURATION;
+    printf("pingpong: %d rounds %d switches/s %u ns/switch\n",
+           rounds, rate, 1000000000U / rate);
+    return 0;
+}
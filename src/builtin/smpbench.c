@@ -0,0 +1,67 @@
+#include <onix/types.h>
+#include <onix/stdio.h>
+#include <onix/stdlib.h>
+#include <onix/syscall.h>
+
+// 多处理器测试，N 个进程各自完成同样的计算量，统计总耗时
+// N 从 1 开始每轮加倍，直到最大进程数量，N 不超过处理器数量时耗时应该基本不变
+// 用法：smpbench [最大进程数量]
+
+#define WORK 50000000 // 每个进程的循环次数
+#define TASK_MAX 32
+
+static void worker()
+{
+    // 只在寄存器和栈上计算，不进入内核
+    u32 volatile sum = 0;
+    for (u32 i = 0; i < WORK; i++)
+    {
+        sum += i ^ (sum >> 3);
+    }
+    exit(0);
+}
+
+static u32 elapsed_ms(timespec_t *start, timespec_t *end)
+{
+    return (end->tv_sec - start->tv_sec) * 1000 + (end->tv_nsec - start->tv_nsec) / 1000000;
+}
+
+int main(int argc, char const *argv[])
+{
+    int max = 8;
+    if (argc > 1)
+        max = MIN(atoi(argv[1]), TASK_MAX);
+
+    pid_t pids[TASK_MAX];
+    u32 base = 0;
+    for (int n = 1; n <= max; n *= 2)
+    {
+        timespec_t start;
+        timespec_t end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        for (int i = 0; i < n; i++)
+        {
+            pids[i] = fork();
+            if (!pids[i])
+                worker();
+        }
+
+        int status;
+        for (int i = 0; i < n; i++)
+        {
+            waitpid(pids[i], &status);
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        u32 ms = elapsed_ms(&start, &end);
+        if (n == 1)
+            base = ms;
+
+        // 加速比：n 份计算量按单进程耗时需要的时间与实际耗时之比
+        u32 speedup = ms ? base * n * 100 / ms : 0;
+        printf("smpbench: %d tasks %u ms speedup %u.%02u\n",
+               n, ms, speedup / 100, speedup % 100);
+    }
+    return 0;
+}
@@ -0,0 +1,78 @@
+#include <onix/types.h>
+#include <onix/stdio.h>
+#include <onix/stdlib.h>
+#include <onix/syscall.h>
+
+// 调度测试，N 个进程不停地让出执行权，统计每秒的调度次数
+// N 从 1 开始每轮加倍，直到最大进程数量，观察调度开销随进程数量的变化
+// N 大于 1 时每次让出都会切换到另一个进程
+// 用法：yieldbench [最大进程数量]
+
+#define DURATION 2 // 每轮测试时长（秒）
+#define TASK_MAX 32
+
+typedef struct bench_t
+{
+    volatile bool stop;           // 通知子进程退出
+    volatile u32 count[TASK_MAX]; // 每个子进程让出的次数
+} bench_t;
+
+static void worker(bench_t *bench, int idx)
+{
+    while (!bench->stop)
+    {
+        yield();
+        bench->count[idx]++;
+    }
+    exit(0);
+}
+
+int main(int argc, char const *argv[])
+{
+    int max = 16;
+    if (argc > 1)
+        max = MIN(atoi(argv[1]), TASK_MAX);
+
+    // 父子进程共享统计结果
+    bench_t *bench = mmap(NULL, sizeof(bench_t), PROT_READ | PROT_WRITE, MAP_SHARED, EOF, 0);
+    if ((int)bench < 0)
+    {
+        printf("yieldbench: mmap error\n");
+        return -1;
+    }
+
+    pid_t pids[TASK_MAX];
+    for (int n = 1; n <= max; n *= 2)
+    {
+        bench->stop = false;
+        for (int i = 0; i < n; i++)
+        {
+            bench->count[i] = 0;
+        }
+
+        for (int i = 0; i < n; i++)
+        {
+            pids[i] = fork();
+            if (!pids[i])
+                worker(bench, i);
+        }
+
+        sleep(DURATION * 1000);
+        bench->stop = true;
+
+        int status;
+        u32 total = 0;
+        for (int i = 0; i < n; i++)
+        {
+            waitpid(pids[i], &status);
+            total += bench->count[i];
+        }
+
+        u32 rate = total / DURATION;
+        printf("yieldbench: %d tasks %d yields/s %u ns/yield\n",
+               n, rate, rate ? 1000000000U / rate : 0);
+    }
+
+    munmap(bench, sizeof(bench_t));
+    return 0;
+}
@@ -75,7 +75,7 @@ int sys_read(fd_t fd, char *buf, int count)
     if (running_task()->uid == KERNEL_USER)
         user = false;
 
-    if (!memory_access(buf, count, false, user))
+    if (!memory_access(buf, count, true, user))
         return -EINVAL;
 
     file_t *file;
@@ -102,7 +102,7 @@ int sys_readdir(fd_t fd, dirent_t *dir, u32 count)
     if (running_task()->uid == KERNEL_USER)
         user = false;
 
-    if (!memory_access(dir, sizeof(dirent_t), false, user))
+    if (!memory_access(dir, sizeof(dirent_t), true, user))
         return -EINVAL;
 
     file_t *file;
@@ -132,7 +132,7 @@ int sys_write(unsigned int fd, char *buf, int count)
     if (running_task()->uid == KERNEL_USER)
         user = false;
 
-    if (!memory_access(buf, count, true, user))
+    if (!memory_access(buf, count, false, user))
         return -EINVAL;
 
     file_t *file;
@@ -149,7 +149,10 @@ int sys_write(unsigned int fd, char *buf, int count)
     int len = inode->op->write(inode, buf, count, file->offset);
 
     if (len > 0)
+    {
+        inode_page_update(inode, file->offset, buf, len);
         file->offset += len;
+    }
 
     return len;
 }
@@ -21,6 +21,23 @@
 
 static inode_t inode_table[INODE_NR];
 
+#define PAGE_HASH_NR 256 // 页缓存哈希表大小
+#define PAGE_HASH(inode, index) ((((inode) - inode_table) * 31 + (index)) % PAGE_HASH_NR)
+
+// 页缓存，每个结点缓存文件的一页
+typedef struct page_cache_t
+{
+    list_node_t node;  // 文件的页缓存链表结点
+    list_node_t hnode; // 哈希表结点
+    inode_t *inode;    // 所属的文件
+    idx_t index;       // 文件中的页索引
+    u32 page;          // 物理页地址，在用户内存中，内核通过临时映射访问
+} page_cache_t;
+
+static list_t page_hash[PAGE_HASH_NR]; // 按文件和页索引查找页缓存
+static u32 page_cache_count = 0;       // 页缓存数量
+static u32 page_hand = 0;              // 回收时扫描的哈希表位置
+
 // 申请一个 inode
 inode_t *get_free_inode()
 {
@@ -33,8 +50,9 @@ inode_t *get_free_inode()
             assert(!inode->desc);
             assert(!inode->super);
             assert(!inode->op);
-            assert(!inode->rxwaiter);
-            assert(!inode->txwaiter);
+            assert(!wait_queue_active(&inode->rxwait));
+            assert(!wait_queue_active(&inode->txwait));
+            assert(list_empty(&inode->page_list));
             return inode;
         }
     }
@@ -51,8 +69,9 @@ void put_free_inode(inode_t *inode)
     assert(!inode->desc);
     assert(!inode->super);
     assert(!inode->op);
-    assert(!inode->rxwaiter);
-    assert(!inode->txwaiter);
+    assert(!wait_queue_active(&inode->rxwait));
+    assert(!wait_queue_active(&inode->txwait));
+    assert(list_empty(&inode->page_list));
 }
 
 // 获取根 inode
@@ -97,9 +116,183 @@ void iput(inode_t *inode)
 {
     if (!inode)
         return;
+
+    // 最后一个引用，文件映射已经全部解除，释放页缓存
+    if (inode->count == 1)
+        inode_page_release(inode);
+
     inode->op->close(inode);
 }
 
+// 查找第 index 页的页缓存
+static page_cache_t *inode_page_find(inode_t *inode, idx_t index)
+{
+    list_t *list = &page_hash[PAGE_HASH(inode, index)];
+    for (list_node_t *node = list->head.next; node != &list->tail; node = node->next)
+    {
+        page_cache_t *cache = element_entry(page_cache_t, hnode, node);
+        if (cache->inode == inode && cache->index == index)
+            return cache;
+    }
+    return NULL;
+}
+
+// 删除页缓存，释放物理页
+static void inode_page_free(page_cache_t *cache)
+{
+    assert(frame_count(cache->page) == 1);
+    list_remove(&cache->node);
+    list_remove(&cache->hnode);
+    free_frames(cache->page, 1);
+    kfree(cache);
+    page_cache_count--;
+}
+
+err_t inode_page_get(inode_t *inode, idx_t index, u32 *page)
+{
+    page_cache_t *cache = inode_page_find(inode, index);
+    if (cache)
+    {
+        *page = cache->page;
+        return EOK;
+    }
+
+    // 超出文件的部分为 0
+    u32 paddr = get_zero_page();
+    if (!paddr)
+        return -ENOMEM;
+
+    off_t offset = index * PAGE_SIZE;
+    if (offset < inode->size)
+    {
+        // 页在用户内存中，先读到内核页里再拷贝
+        char *buf = (char *)alloc_kpage(1);
+        if (!buf)
+        {
+            free_frames(paddr, 1);
+            return -ENOMEM;
+        }
+
+        // 读取失败的页不能留在页缓存中，否则之后的映射都会看到错误的数据
+        int len = MIN(PAGE_SIZE, inode->size - offset);
+        bool ok = inode->op->read(inode, buf, len, offset) == len;
+        if (ok)
+            frame_write(paddr, 0, buf, len);
+        free_kpage((u32)buf, 1);
+
+        if (!ok)
+        {
+            free_frames(paddr, 1);
+            return -EIO;
+        }
+    }
+
+    // 申请内存和读取文件都可能阻塞，期间其他任务可能已经读入了同一页
+    cache = inode_page_find(inode, index);
+    if (cache)
+    {
+        free_frames(paddr, 1);
+        *page = cache->page;
+        return EOK;
+    }
+
+    cache = (page_cache_t *)kmalloc(sizeof(page_cache_t));
+    cache->inode = inode;
+    cache->index = index;
+    cache->page = paddr;
+    list_push(&inode->page_list, &cache->node);
+    list_push(&page_hash[PAGE_HASH(inode, index)], &cache->hnode);
+    page_cache_count++;
+
+    LOGK("inode %d page cache %d read 0x%p\n", inode->nr, index, paddr);
+    *page = paddr;
+    return EOK;
+}
+
+void inode_page_sync(inode_t *inode, idx_t index)
+{
+    page_cache_t *cache = inode_page_find(inode, index);
+    if (!cache)
+        return;
+
+    // 只写回文件范围内的数据，不改变文件大小
+    off_t offset = index * PAGE_SIZE;
+    if (offset >= inode->size)
+        return;
+
+    char *buf = (char *)alloc_kpage(1);
+    if (!buf)
+        return;
+
+    int len = MIN(PAGE_SIZE, inode->size - offset);
+    frame_read(cache->page, 0, buf, len);
+    inode->op->write(inode, buf, len, offset);
+    free_kpage((u32)buf, 1);
+    LOGK("inode %d page cache %d write back\n", inode->nr, index);
+}
+
+void inode_page_update(inode_t *inode, off_t offset, char *data, int len)
+{
+    if (list_empty(&inode->page_list) || len <= 0)
+        return;
+
+    char *buf = (char *)alloc_kpage(1);
+    if (!buf)
+        return;
+
+    // 将写入的数据拷贝到对应的页缓存中，页中其他位置共享映射的修改不受影响
+    for (int done = 0; done < len;)
+    {
+        off_t pos = offset + done;
+        u32 start = pos % PAGE_SIZE;
+        u32 count = MIN(PAGE_SIZE - start, len - done);
+
+        // data 是用户内存，可能缺页，先拷贝到内核页中
+        memcpy(buf, data + done, count);
+
+        page_cache_t *cache = inode_page_find(inode, pos / PAGE_SIZE);
+        if (cache)
+            frame_write(cache->page, start, buf, count);
+        done += count;
+    }
+    free_kpage((u32)buf, 1);
+}
+
+void inode_page_release(inode_t *inode)
+{
+    list_t *list = &inode->page_list;
+    while (!list_empty(list))
+    {
+        page_cache_t *cache = element_entry(page_cache_t, node, list->head.next);
+        inode_page_free(cache);
+    }
+}
+
+u32 inode_page_shrink(u32 count)
+{
+    u32 freed = 0;
+    for (size_t i = 0; i < PAGE_HASH_NR && page_cache_count && freed < count; i++)
+    {
+        list_t *list = &page_hash[page_hand];
+        page_hand = (page_hand + 1) % PAGE_HASH_NR;
+
+        for (list_node_t *node = list->head.next; node != &list->tail && freed < count;)
+        {
+            page_cache_t *cache = element_entry(page_cache_t, hnode, node);
+            node = node->next;
+
+            // 还被映射的页可能有没写回的修改，不能丢弃
+            if (frame_count(cache->page) != 1)
+                continue;
+
+            inode_page_free(cache);
+            freed++;
+        }
+    }
+    LOGK("page cache shrink %d pages, %d left\n", freed, page_cache_count);
+    return freed;
+}
+
 void inode_init()
 {
     memset(inode_table, 0, sizeof(inode_table));
@@ -108,5 +301,13 @@ void inode_init()
         inode_t *inode = &inode_table[i];
         inode->dev = EOF;
         inode->type = FS_TYPE_NONE;
+        list_init(&inode->page_list);
+        wait_queue_init(&inode->rxwait);
+        wait_queue_init(&inode->txwait);
+    }
+
+    for (size_t i = 0; i < PAGE_HASH_NR; i++)
+    {
+        list_init(&page_hash[i]);
     }
 }
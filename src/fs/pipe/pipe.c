@@ -10,15 +10,20 @@
 
 #define LOGK(fmt, args...) DEBUGK(fmt, ##args)
 
+// 创建管道，内核内存不足返回 NULL
 static inode_t *pipe_open()
 {
+    // 管道缓冲区一页内存
+    void *addr = (void *)alloc_kpage(1);
+    if (!addr)
+        return NULL;
+
     inode_t *inode = get_free_inode();
     // 但是被占用了
     inode->dev = -FS_TYPE_PIPE;
     // 申请内存，表示缓冲队列
     inode->desc = (void *)kmalloc(sizeof(fifo_t));
-    // 管道缓冲区一页内存
-    inode->addr = (void *)alloc_kpage(1);
+    inode->addr = addr;
     // 两个文件
     inode->count = 2;
     // 管道类型
@@ -41,8 +46,11 @@ static void pipe_close(inode_t *inode)
 
     // 释放描述符 fifo
     kfree(inode->desc);
+    inode->desc = NULL;
     // 释放缓冲区
     free_kpage((u32)inode->addr, 1);
+    inode->addr = NULL;
+    inode->op = NULL;
     // 释放 inode
     put_free_inode(inode);
 }
@@ -51,20 +59,15 @@ static int pipe_read(inode_t *inode, char *data, int count, off_t offset)
 {
     fifo_t *fifo = (fifo_t *)inode->desc;
     int nr = 0;
+    int ret;
     while (nr < count)
     {
-        if (fifo_empty(fifo))
-        {
-            assert(inode->rxwaiter == NULL);
-            inode->rxwaiter = running_task();
-            task_block(inode->rxwaiter, NULL, TASK_BLOCKED, TIMELESS);
-        }
+        // 可能有多个读者，被唤醒时数据可能已经被别人读走
+        wait_event(ret, &inode->rxwait, !fifo_empty(fifo), TASK_BLOCKED, TIMELESS);
+        assert(ret == EOK);
+
         data[nr++] = fifo_get(fifo);
-        if (inode->txwaiter)
-        {
-            task_unblock(inode->txwaiter, EOK);
-            inode->txwaiter = NULL;
-        }
+        wake_up_all(&inode->txwait, EOK);
     }
     return nr;
 }
@@ -73,20 +76,14 @@ static int pipe_write(inode_t *inode, char *data, int count, off_t offset)
 {
     fifo_t *fifo = (fifo_t *)inode->desc;
     int nr = 0;
+    int ret;
     while (nr < count)
     {
-        if (fifo_full(fifo))
-        {
-            assert(inode->txwaiter == NULL);
-            inode->txwaiter = running_task();
-            task_block(inode->txwaiter, NULL, TASK_BLOCKED, TIMELESS);
-        }
+        wait_event(ret, &inode->txwait, !fifo_full(fifo), TASK_BLOCKED, TIMELESS);
+        assert(ret == EOK);
+
         fifo_put(fifo, data[nr++]);
-        if (inode->rxwaiter)
-        {
-            task_unblock(inode->rxwaiter, EOK);
-            inode->rxwaiter = NULL;
-        }
+        wake_up_all(&inode->rxwait, EOK);
     }
     return nr;
 }
@@ -96,6 +93,8 @@ int sys_pipe(fd_t pipefd[2])
     // LOGK("pipe system call!!!!!!! %d\n", sizeof(fifo_t));
 
     inode_t *inode = pipe_open();
+    if (!inode)
+        return -ENOMEM;
 
     task_t *task = running_task();
     file_t *files[2];
@@ -0,0 +1,83 @@
+#ifndef ONIX_APIC_H
+#define ONIX_APIC_H
+
+#include <onix/types.h>
+
+#define LAPIC_BASE 0xFEE00000 // 本地 APIC 默认物理地址
+
+#define LAPIC_ID 0x20           // 本地 APIC 编号
+#define LAPIC_VERSION 0x30      // 版本
+#define LAPIC_TPR 0x80          // 任务优先级
+#define LAPIC_EOI 0xB0          // 中断结束
+#define LAPIC_SVR 0xF0          // 伪中断向量
+#define LAPIC_ESR 0x280         // 错误状态
+#define LAPIC_ICR_LOW 0x300     // 中断命令低 32 位
+#define LAPIC_ICR_HIGH 0x310    // 中断命令高 32 位
+#define LAPIC_LVT_TIMER 0x320   // 定时器本地向量
+#define LAPIC_LVT_LINT0 0x350   // LINT0 本地向量
+#define LAPIC_LVT_LINT1 0x360   // LINT1 本地向量
+#define LAPIC_LVT_ERROR 0x370   // 错误本地向量
+#define LAPIC_TIMER_INIT 0x380  // 定时器初始计数
+#define LAPIC_TIMER_COUNT 0x390 // 定时器当前计数
+#define LAPIC_TIMER_DIV 0x3E0   // 定时器分频
+
+#define LAPIC_SVR_ENABLE 0x100     // 软件启用本地 APIC
+#define LAPIC_LVT_MASKED 0x10000   // 屏蔽
+#define LAPIC_LVT_PERIODIC 0x20000 // 定时器周期模式
+#define LAPIC_LVT_EXTINT 0x700     // 外部中断，连接 8259
+#define LAPIC_LVT_NMI 0x400        // 不可屏蔽中断
+#define LAPIC_TIMER_DIV16 0b0011   // 定时器 16 分频
+
+#define ICR_FIXED 0x000    // 固定向量
+#define ICR_INIT 0x500     // INIT
+#define ICR_STARTUP 0x600  // STARTUP
+#define ICR_PENDING 0x1000 // 正在发送
+#define ICR_ASSERT 0x4000  // 电平有效
+#define ICR_LEVEL 0x8000   // 电平触发
+
+#define IOAPIC_BASE 0xFEC00000 // IOAPIC 默认物理地址
+
+#define IOAPIC_REGSEL 0x00 // 寄存器选择
+#define IOAPIC_WINDOW 0x10 // 寄存器数据
+#define IOAPIC_VERSION 0x1 // 版本和重定向表项数量
+#define IOAPIC_REDTBL 0x10 // 重定向表，每个引脚两个寄存器
+
+#define IOAPIC_LOW 0x2000     // 低电平有效
+#define IOAPIC_LEVEL 0x8000   // 电平触发
+#define IOAPIC_MASKED 0x10000 // 屏蔽
+
+// MSI 消息地址，中断发送到 apic_id 处理器
+#define MSI_ADDRESS(apic_id) (LAPIC_BASE | ((apic_id) << 12))
+
+// 映射本地 APIC 寄存器，base 为物理地址
+void lapic_map(u32 base);
+
+// 初始化当前处理器的本地 APIC，extint 表示通过 LINT0 接收 8259 的中断
+void lapic_init(bool extint);
+
+bool lapic_enabled(); // 本地 APIC 是否可用
+u32 lapic_id();       // 当前处理器的本地 APIC 编号
+void lapic_eoi();     // 通知本地 APIC 中断处理结束
+
+// 向 apic_id 处理器发送 vector 处理器间中断
+void lapic_send_ipi(u32 apic_id, u32 vector);
+
+// 用 INIT-SIPI-SIPI 启动 apic_id 处理器，从物理地址 addr 开始执行实模式代码
+void lapic_startup(u32 apic_id, u32 addr);
+
+// 用时钟源测量本地 APIC 定时器的频率，在启动处理器上调用
+void lapic_timer_calibrate();
+
+// 本地 APIC 定时器以 HZ 的频率周期产生 vector 中断
+void lapic_timer_start(u32 vector);
+
+// 设置 irq 连接的 IOAPIC 引脚和触发方式，没有设置的 irq 连接同号引脚，边沿触发
+void ioapic_route(u32 irq, u32 pin, u32 flags);
+
+// 映射 IOAPIC 寄存器，屏蔽所有引脚，中断发送到当前处理器
+void ioapic_map(u32 base);
+
+// 打开或屏蔽 irq，向量为 IRQ_MASTER_NR + irq
+void ioapic_mask(u32 irq, bool enable);
+
+#endif
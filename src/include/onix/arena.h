@@ -11,15 +11,21 @@
 
 #define DESC_COUNT 7
 
-typedef list_node_t block_t; // 内存块
+// 内存块，空闲时链接到所在 arena 的空闲链表
+typedef struct block_t
+{
+    struct block_t *next; // 下一个空闲块
+} block_t;
 
 // 内存描述符
 typedef struct arena_descriptor_t
 {
-    u32 total_block;  // 一页内存分成了多少块
-    u32 block_size;   // 块大小
-    int page_count;   // 空闲页数量
-    list_t free_list; // 空闲列表
+    u32 total_block; // 一页内存分成了多少块
+    u32 block_size;  // 块大小
+    int page_count;  // 页数量
+    list_t partial;  // 部分空闲的页
+    list_t full;     // 没有空闲块的页
+    list_t empty;    // 全部空闲的页
 } arena_descriptor_t;
 
 // 一页或多页内存
@@ -29,6 +35,9 @@ typedef struct arena_t
     u32 count;                // 当前剩余多少块 或 页数
     u32 large;                // 表示是不是超过 1024 字节
     u32 magic;                // 魔数
+    list_node_t node;         // 描述符中链表的结点
+    block_t *free;            // 页内空闲块链表
+    u32 unused;               // 从未分配过的第一个块的索引
 } arena_t;
 
 void *kmalloc(size_t size);
@@ -3,11 +3,16 @@
 
 #include <onix/types.h>
 
+#define BITMAP_GROUPS 256 // 摘要的位数，每一位对应一组字
+
 typedef struct bitmap_t
 {
-    u8 *bits;   // 位图缓冲区
-    u32 length; // 位图缓冲区长度
-    u32 offset; // 位图开始的偏移
+    u8 *bits;                        // 位图缓冲区
+    u32 length;                      // 位图缓冲区长度
+    u32 offset;                      // 位图开始的偏移
+    u32 cursor;                      // 下次扫描开始的位置 next-fit
+    u32 shift;                       // 每组有 2^shift 个字
+    u32 summary[BITMAP_GROUPS / 32]; // 摘要位图，置位表示该组的字已全满
 } bitmap_t;
 
 // 初始化位图
@@ -0,0 +1,63 @@
+#ifndef ONIX_CLOCK_H
+#define ONIX_CLOCK_H
+
+#include <onix/types.h>
+#include <onix/list.h>
+
+#define HZ 100
+#define JIFFY (1000 / HZ) // 时间片毫秒数
+
+#define NSEC_PER_USEC 1000
+#define NSEC_PER_MSEC 1000000
+#define NSEC_PER_SEC 1000000000
+#define NSEC_PER_JIFFY (NSEC_PER_SEC / HZ)
+
+#define TSC_SHIFT 22 // 周期换算纳秒的乘数左移位数
+
+// 时间页，内核维护，只读映射到所有进程的 USER_VTIME_ADDR，用户态读取时间不需要系统调用
+// 除了时间片，其他字段在开机时设置之后不再改变
+typedef struct vtime_t
+{
+    u64 tsc_boot;         // 开机时的时间戳
+    u32 tsc_khz;          // 时间戳计数器频率（kHz）
+    u32 tsc_mult;         // 每个周期的纳秒数，左移 TSC_SHIFT 位
+    u32 volatile jiffies; // 时间片，时钟中断中更新
+    time_t startup_time;  // 开机时间，1970 年以来的秒数
+} vtime_t;
+
+// 高精度定时器，按纳秒超时时间排序，超时时在时钟中断中调用处理函数
+typedef struct hrtimer_t
+{
+    list_node_t node;                    // 定时器链表节点
+    u64 expires;                         // 超时时间（开机以来的纳秒数）
+    void (*handler)(struct hrtimer_t *); // 超时处理函数
+    void *arg;                           // 参数
+} hrtimer_t;
+
+struct timespec_t;
+
+// 时间页中开机以来的纳秒数
+u64 vtime_monotonic(vtime_t *vt);
+// 用时间页得到 clock 时钟的时间
+int vtime_gettime(vtime_t *vt, int clock, struct timespec_t *tp);
+
+// 开机以来的纳秒数
+u64 clock_monotonic();
+// 设置开机时间
+void clock_set_startup(time_t time);
+
+// 进入空闲状态，停止周期时钟，需要在关中断时调用
+void clock_idle_enter();
+// 退出空闲状态，恢复周期时钟
+void clock_idle_exit();
+
+// 初始化高精度定时器
+void hrtimer_init(hrtimer_t *timer, void (*handler)(hrtimer_t *), void *arg);
+// 启动定时器，在 expires 纳秒时超时
+void hrtimer_start(hrtimer_t *timer, u64 expires);
+// 取消定时器，返回定时器是否处于启动状态
+bool hrtimer_cancel(hrtimer_t *timer);
+// 定时器是否处于启动状态
+bool hrtimer_active(hrtimer_t *timer);
+
+#endif
@@ -105,4 +105,31 @@ typedef struct cpu_version_t
 
 void cpu_version(cpu_version_t *ver);
 
+enum
+{
+    CR4_VME = 1 << 0, // Virtual-8086 Mode Extensions
+    CR4_PVI = 1 << 1, // Protected-Mode Virtual Interrupts
+    CR4_TSD = 1 << 2, // Time Stamp Disable 只有内核可以执行 rdtsc
+    CR4_DE = 1 << 3,  // Debugging Extensions
+    CR4_PSE = 1 << 4, // Page Size Extensions 启用 4M 页
+    CR4_PAE = 1 << 5, // Physical Address Extension
+    CR4_MCE = 1 << 6, // Machine-Check Enable
+    CR4_PGE = 1 << 7, // Page Global Enable 启用全局页，切换 cr3 不刷新全局页的快表
+};
+
+// 得到 cr4 寄存器
+u32 get_cr4();
+
+// 设置 cr4 寄存器
+void set_cr4(u32 cr4);
+
+// 读取时间戳计数器
+static _inline u64 cpu_rdtsc()
+{
+    u64 tsc;
+    asm volatile("rdtsc\n"
+                 : "=A"(tsc));
+    return tsc;
+}
+
 #endif
@@ -4,6 +4,7 @@
 #include <onix/types.h>
 #include <onix/list.h>
 #include <onix/stat.h>
+#include <onix/wait.h>
 
 #define MAXNAMELEN 64
 
@@ -66,10 +67,11 @@ typedef struct inode_t
     int uid; // 用户 id
     int gid; // 组 id
 
-    struct super_t *super;   // 超级块
-    struct fs_op_t *op;      // 文件系统操作
-    struct task_t *rxwaiter; // 读等待进程
-    struct task_t *txwaiter; // 写等待进程
+    struct super_t *super; // 超级块
+    struct fs_op_t *op;    // 文件系统操作
+    wait_queue_t rxwait;   // 读等待队列
+    wait_queue_t txwait;   // 写等待队列
+    list_t page_list;      // 页缓存链表，用于文件映射
 } inode_t;
 
 typedef struct super_t
@@ -165,6 +167,17 @@ void fs_register_op(int type, fs_op_t *op);
 inode_t *get_free_inode();
 void put_free_inode(inode_t *inode);
 
+// 获取文件第 index 页的页缓存，不存在则从文件读入，物理页地址存入 page
+err_t inode_page_get(inode_t *inode, idx_t index, u32 *page);
+// 将第 index 页的页缓存写回文件
+void inode_page_sync(inode_t *inode, idx_t index);
+// 文件被写入后，将写入的 len 字节数据 data 拷贝到相应的页缓存
+void inode_page_update(inode_t *inode, off_t offset, char *data, int len);
+// 内存回收，丢弃没有被映射的页缓存
+u32 inode_page_shrink(u32 count);
+// 释放 inode 的全部页缓存
+void inode_page_release(inode_t *inode);
+
 file_t *get_file();
 void put_file(file_t *file);
 
@@ -12,6 +12,8 @@
 #define USER_CODE_IDX 4
 #define USER_DATA_IDX 5
 
+#define CPU_TSS_IDX 8 // 应用处理器的任务状态段，每个处理器一项
+
 #define KERNEL_CODE_SELECTOR (KERNEL_CODE_IDX << 3)
 #define KERNEL_DATA_SELECTOR (KERNEL_DATA_IDX << 3)
 #define KERNEL_TSS_SELECTOR (KERNEL_TSS_IDX << 3)
@@ -84,6 +86,9 @@ typedef struct tss_t
     u32 ssp;           // 任务影子栈指针
 } _packed tss_t;
 
+struct cpu_t;
+
 void gdt_init();
+void tss_init(struct cpu_t *cpu); // 初始化处理器的任务状态段
 
 #endif
\ No newline at end of file
@@ -3,6 +3,7 @@
 
 #include <onix/types.h>
 #include <onix/mutex.h>
+#include <onix/softirq.h>
 
 #define SECTOR_SIZE 512     // 扇区大小
 #define CD_SECTOR_SIZE 2048 // 光盘扇区大小
@@ -78,6 +79,7 @@ typedef struct ide_ctrl_t
     ide_disk_t *active;            // 当前选择的磁盘
     u8 control;                    // 控制字节
     struct task_t *waiter;         // 等待控制器的进程
+    tasklet_t tasklet;             // 中断下半部，唤醒等待的进程
     ide_prd_t prd;                 // Physical Region Descriptor
 } ide_ctrl_t;
 
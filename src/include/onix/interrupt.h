@@ -48,6 +48,11 @@
 #define IRQ_MASTER_NR 0x20 // 主片起始向量号
 #define IRQ_SLAVE_NR 0x28  // 从片起始向量号
 
+#define INTR_APIC_TIMER 0x30 // 本地 APIC 定时器
+#define INTR_RESCHEDULE 0x31 // 处理器间中断，重新调度
+#define INTR_MSI_NIC 0x32    // 网卡 MSI 中断
+#define INTR_SPURIOUS 0x3f   // 本地 APIC 伪中断
+
 typedef struct gate_t
 {
     u16 offset0;    // 段内偏移 0 ~ 15 位
@@ -70,6 +75,12 @@ void set_exception_handler(u32 intr, handler_t handler);
 void set_interrupt_handler(u32 irq, handler_t handler);
 void set_interrupt_mask(u32 irq, bool enable);
 
+// 设置本地 APIC 中断处理函数，包括处理器间中断和 MSI 中断
+void set_apic_handler(u32 vector, handler_t handler);
+
+// 外部中断改由 IOAPIC 传递，不再使用 8259
+void ioapic_enable(bool imcr);
+
 bool interrupt_disable();             // 清除 IF 位，返回设置之前的值
 bool get_interrupt_state();           // 获得 IF 位
 void set_interrupt_state(bool state); // 设置 IF 位
@@ -2,6 +2,7 @@
 #define ONIX_MEMORY_H
 
 #include <onix/types.h>
+#include <onix/list.h>
 
 #define PAGE_SIZE 0x1000     // 一页的大小 4K
 #define MEMORY_BASE 0x100000 // 1M，可用内存开始的位置
@@ -33,6 +34,9 @@
 // 用户栈底地址
 #define USER_STACK_BOTTOM (USER_STACK_TOP - USER_STACK_SIZE)
 
+// 内核时间页，只读映射到所有进程
+#define USER_VTIME_ADDR USER_STACK_TOP
+
 // 内核页目录索引
 #define KERNEL_PAGE_DIR 0x1000
 
@@ -53,6 +57,20 @@ typedef struct page_entry_t
     u32 index : 20;  // 页索引
 } _packed page_entry_t;
 
+// 虚拟内存区域，记录 mmap 的映射范围，按开始地址有序链接在进程中
+typedef struct vm_area_t
+{
+    list_node_t node;      // 链表结点
+    u32 start;             // 开始地址
+    u32 end;               // 结束地址
+    int prot;              // 保护标志
+    int maxprot;           // 允许设置的保护标志
+    int flags;             // 映射标志
+    struct inode_t *inode; // 映射的文件，匿名映射为 NULL
+    struct shm_t *shm;     // 映射的共享内存段，其他映射为 NULL
+    off_t offset;          // 文件偏移，或者共享内存段中的偏移
+} vm_area_t;
+
 // 得到 cr2 寄存器
 u32 get_cr2();
 
@@ -62,12 +80,28 @@ u32 get_cr3();
 // 设置 cr3 寄存器，参数是页目录的地址
 void set_cr3(u32 pde);
 
-// 分配 count 个连续的内核页
+// 分配 count 个连续的内核页，回收之后仍然不足返回 0
 u32 alloc_kpage(u32 count);
 
 // 释放 count 个连续的内核页
 void free_kpage(u32 vaddr, u32 count);
 
+// 分配 count 个连续的物理页，返回物理地址
+u32 alloc_frames(u32 count);
+
+// 释放 count 个连续的物理页
+void free_frames(u32 paddr, u32 count);
+
+// 分配一页清零的物理内存，内存不足返回 0，用 free_frames 释放
+u32 get_zero_page();
+
+// 读写物理页 paddr 中 [offset, offset + len) 的内容，buf 必须是内核内存
+void frame_write(u32 paddr, u32 offset, void *buf, u32 len);
+void frame_read(u32 paddr, u32 offset, void *buf, u32 len);
+
+// 物理页 paddr 的引用数量
+u32 frame_count(u32 paddr);
+
 // 获取页表项
 page_entry_t *get_entry(u32 vaddr, bool create);
 
@@ -75,25 +109,72 @@ page_entry_t *get_entry(u32 vaddr, bool create);
 void flush_tlb(u32 vaddr);
 
 // 将 vaddr 映射物理内存
-void link_page(u32 vaddr);
+err_t link_page(u32 vaddr);
 
 // 去掉 vaddr 对应的物理内存映射
 void unlink_page(u32 vaddr);
 
-// 映射物理内存页
-void map_page(u32 vaddr, u32 paddr);
-// 映射物理内存区域
-void map_area(u32 paddr, u32 size);
+// 映射物理内存页，内存不足返回 -ENOMEM
+err_t map_page(u32 vaddr, u32 paddr);
+// 将内核页只读映射到所有进程
+void map_user_readonly(u32 vaddr, u32 paddr);
+// 映射物理内存区域，内存不足返回 -ENOMEM
+err_t map_area(u32 paddr, u32 size);
+// 映射设备寄存器区域，只有内核可以访问，禁止缓存
+void map_mmio(u32 paddr, u32 size);
 
-// 拷贝页目录
+// 拷贝页目录，内核内存不足返回 NULL
 page_entry_t *copy_pde();
 
+// 创建只有内核映射的页目录，内核内存不足返回 NULL
+page_entry_t *create_pde();
+
 // 释放页目录
 void free_pde();
 
 // 获取虚拟地址 vaddr 对应的物理地址
 u32 get_paddr(u32 vaddr);
 
+struct task_t;
+
+// 预先清零的页池统计
+typedef struct zero_pool_stat_t
+{
+    u32 count;  // 池中页数
+    u32 size;   // 池的容量
+    u32 hits;   // 从池中取到页的次数
+    u32 misses; // 池为空，同步清零的次数
+} zero_pool_stat_t;
+
+// 向预先清零的页池中补充一页，池已满或没有空闲内存返回 false
+bool zero_pool_fill();
+
+// 获取预先清零的页池统计
+void zero_pool_stat(zero_pool_stat_t *stat);
+
+// 内存区域，不同区域的内存需要不同的回收函数
+typedef enum zone_t
+{
+    ZONE_KERNEL, // 内核页，alloc_kpage 分配，1M ~ 12M
+    ZONE_USER,   // 用户页，伙伴系统分配，16M 以上
+    ZONE_NR,
+} zone_t;
+
+// 内存回收函数，尝试回收 count 页，返回实际回收的页数
+typedef u32 (*shrinker_t)(u32 count);
+
+// 注册 zone 区域的内存回收函数，分配内存失败时依次调用
+void shrinker_register(zone_t zone, shrinker_t shrinker);
+
+// 回收 zone 区域 count 页内存，返回实际回收的页数
+u32 memory_reclaim(zone_t zone, u32 count);
+
+// 拷贝当前进程的文件映射到 child
+void mmap_fork(struct task_t *child);
+
+// 解除当前进程全部的文件映射
+void mmap_exit();
+
 // 检测内存是否可以访问
 bool memory_access(void *vaddr, int size, bool write, bool user);
 
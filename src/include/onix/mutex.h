@@ -4,16 +4,46 @@
 #include <onix/types.h>
 #include <onix/list.h>
 
+// 自旋锁，用于多处理器之间的短临界区，持有期间不能阻塞
+typedef struct spinlock_t
+{
+    u32 volatile locked; // 是否被持有
+} spinlock_t;
+
+void spin_init(spinlock_t *lock);   // 初始化自旋锁
+void spin_lock(spinlock_t *lock);   // 加锁，忙等直到持有
+void spin_unlock(spinlock_t *lock); // 解锁
+
+bool spin_lock_irqsave(spinlock_t *lock);                 // 关中断并加锁，返回之前的中断状态
+void spin_unlock_irqrestore(spinlock_t *lock, bool intr); // 解锁并恢复中断状态
+
+// 互斥量，释放时直接交给优先级最高的等待者
+// 持有者的优先级低于等待者时，继承等待者的优先级，直到释放
 typedef struct mutex_t
 {
-    bool value;     // 信号量
-    list_t waiters; // 等待队列
+    bool value;            // 信号量
+    list_t waiters;        // 等待队列
+    struct task_t *holder; // 持有者
+    list_node_t node;      // 持有者的互斥量链表节点
+    u32 contended;         // 需要等待的次数
 } mutex_t;
 
 void mutex_init(mutex_t *mutex);   // 初始化互斥量
 void mutex_lock(mutex_t *mutex);   // 尝试持有互斥量
 void mutex_unlock(mutex_t *mutex); // 释放互斥量
 
+// 互斥量竞争统计
+typedef struct mutex_stat_t
+{
+    u32 locks;     // 持有次数
+    u32 contended; // 需要等待的次数
+    u32 handoffs;  // 释放时直接交给等待者的次数
+    u32 boosts;    // 提升持有者优先级的次数
+} mutex_stat_t;
+
+// 获取互斥量竞争统计
+void mutex_stat(mutex_stat_t *stat);
+
 typedef struct lock_t
 {
     struct task_t *holder; // 持有者
@@ -28,8 +28,7 @@ typedef struct netif_t
     list_node_t node; // 链表节点
     char name[16];    // 名字
 
-    list_t rx_pbuf_list; // 接收缓冲队列
-    lock_t rx_lock;      // 接收锁
+    list_t rx_pbuf_list; // 接收缓冲队列，关中断访问
     int rx_pbuf_size;    // 接收队列大小
 
     list_t tx_pbuf_list; // 发送缓冲队列
@@ -4,6 +4,7 @@
 #include <onix/net/types.h>
 #include <onix/net/pbuf.h>
 #include <onix/list.h>
+#include <onix/wait.h>
 
 typedef struct pkt_pcb_t
 {
@@ -16,7 +17,7 @@ typedef struct pkt_pcb_t
     int protocol;
 
     list_t rx_pbuf_list;
-    struct task_t *rx_waiter;
+    wait_queue_t rx_wait;
 } pkt_pcb_t;
 
 err_t pkt_input(netif_t *netif, pbuf_t *pbuf);
@@ -6,6 +6,7 @@
 #include <onix/net/types.h>
 #include <onix/net/pbuf.h>
 #include <onix/list.h>
+#include <onix/wait.h>
 
 #define RAW_TTL 255
 
@@ -17,7 +18,7 @@ typedef struct raw_pcb_t
     u16 protocol;
 
     list_t rx_pbuf_list;
-    struct task_t *rx_waiter;
+    wait_queue_t rx_wait;
 } raw_pcb_t;
 
 err_t raw_input(netif_t *netif, pbuf_t *pbuf);
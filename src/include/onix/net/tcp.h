@@ -3,6 +3,7 @@
 
 #include <onix/net/types.h>
 #include <onix/list.h>
+#include <onix/wait.h>
 
 #define TCP_MSS (1500 - 40)  // 默认 MSS 大小
 #define TCP_WINDOW 8192      // 默认窗口大小
@@ -178,9 +179,9 @@ typedef struct tcp_pcb_t
     list_t outseq;  // 已收到的无序报文
     list_t recved;  // 已收到的有序报文
 
-    struct task_t *ac_waiter; // 接受等待进程
-    struct task_t *tx_waiter; // 写等待进程
-    struct task_t *rx_waiter; // 读等待进程
+    wait_queue_t ac_wait; // 接受和连接等待队列
+    wait_queue_t tx_wait; // 写等待队列
+    wait_queue_t rx_wait; // 读等待队列
 } tcp_pcb_t;
 
 // 获取初始序列号
@@ -3,6 +3,7 @@
 
 #include <onix/net/types.h>
 #include <onix/list.h>
+#include <onix/wait.h>
 
 enum
 {
@@ -33,8 +34,8 @@ typedef struct udp_pcb_t
 
     u32 flags; // 状态
 
-    list_t rx_pbuf_list;      // 接收缓冲队列
-    struct task_t *rx_waiter; // 等待进程
+    list_t rx_pbuf_list;  // 接收缓冲队列
+    wait_queue_t rx_wait; // 接收等待队列
 } udp_pcb_t;
 
 int udp_input(netif_t *netif, pbuf_t *pbuf);
@@ -15,6 +15,7 @@
 #define PCI_CONF_BASE_ADDR3 0x1C
 #define PCI_CONF_BASE_ADDR4 0x20
 #define PCI_CONF_BASE_ADDR5 0x24
+#define PCI_CONF_CAPABILITY 0x34 // 能力链表指针
 #define PCI_CONF_INTERRUPT 0x3C
 
 #define PCI_CLASS_MASK 0xFF0000
@@ -28,16 +29,17 @@
 #define PCI_BAR_IO_MASK (~0x3)
 #define PCI_BAR_MEM_MASK (~0xF)
 
-#define PCI_COMMAND_IO 0x0001          // Enable response in I/O space
-#define PCI_COMMAND_MEMORY 0x0002      // Enable response in Memory space
-#define PCI_COMMAND_MASTER 0x0004      // Enable bus mastering
-#define PCI_COMMAND_SPECIAL 0x0008     // Enable response to special cycles
-#define PCI_COMMAND_INVALIDATE 0x0010  // Use memory write and invalidate
-#define PCI_COMMAND_VGA_PALETTE 0x0020 // Enable palette snooping
-#define PCI_COMMAND_PARITY 0x0040      // Enable parity checking
-#define PCI_COMMAND_WAIT 0x0080        // Enable address/data stepping
-#define PCI_COMMAND_SERR 0x0100        // Enable SERR/
-#define PCI_COMMAND_FAST_BACK 0x0200   // Enable back-to-back writes
+#define PCI_COMMAND_IO 0x0001           // Enable response in I/O space
+#define PCI_COMMAND_MEMORY 0x0002       // Enable response in Memory space
+#define PCI_COMMAND_MASTER 0x0004       // Enable bus mastering
+#define PCI_COMMAND_SPECIAL 0x0008      // Enable response to special cycles
+#define PCI_COMMAND_INVALIDATE 0x0010   // Use memory write and invalidate
+#define PCI_COMMAND_VGA_PALETTE 0x0020  // Enable palette snooping
+#define PCI_COMMAND_PARITY 0x0040       // Enable parity checking
+#define PCI_COMMAND_WAIT 0x0080         // Enable address/data stepping
+#define PCI_COMMAND_SERR 0x0100         // Enable SERR/
+#define PCI_COMMAND_FAST_BACK 0x0200    // Enable back-to-back writes
+#define PCI_COMMAND_INTX_DISABLE 0x0400 // INTx Emulation Disable
 
 #define PCI_STATUS_CAP_LIST 0x010    // Support Capability List
 #define PCI_STATUS_66MHZ 0x020       // Support 66 Mhz PCI 2.1 bus
@@ -49,6 +51,12 @@
 #define PCI_STATUS_DEVSEL_MEDIUM 0x200
 #define PCI_STATUS_DEVSEL_SLOW 0x400
 
+#define PCI_CAP_ID_MSI 0x05 // Message Signalled Interrupts
+
+#define PCI_MSI_FLAGS_ENABLE 0x0001 // MSI feature enabled
+#define PCI_MSI_FLAGS_QSIZE 0x0070  // Message queue size configured
+#define PCI_MSI_FLAGS_64BIT 0x0080  // 64-bit addresses allowed
+
 typedef struct pci_addr_t
 {
     u8 RESERVED : 2; // 最低位
@@ -84,6 +92,12 @@ void pci_outl(u8 bus, u8 dev, u8 func, u8 addr, u32 value);
 err_t pci_find_bar(pci_device_t *device, pci_bar_t *bar, int type);
 u8 pci_interrupt(pci_device_t *device);
 
+// 查找能力，返回能力在配置空间中的偏移，不存在返回 0
+u8 pci_find_capability(pci_device_t *device, u8 id);
+
+// 启用 MSI，设备写 data 到 address 产生中断，同时关闭 INTx 中断
+err_t pci_enable_msi(pci_device_t *device, u32 address, u32 data);
+
 const char *pci_classname(u32 classcode);
 
 pci_device_t *pci_find_device(u16 vendorid, u16 deviceid);
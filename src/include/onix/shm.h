@@ -0,0 +1,33 @@
+#ifndef ONIX_SHM_H
+#define ONIX_SHM_H
+
+#include <onix/types.h>
+
+#define SHM_NR 32             // 共享内存段数量
+#define SHM_SIZE_MAX 0x400000 // 共享内存段最大 4M
+
+// 共享内存段，页框在第一次访问时分配，段本身持有每个页框的一个引用
+typedef struct shm_t
+{
+    key_t key;    // 键值，IPC_PRIVATE 或者已删除的段不能通过键值查找
+    u32 size;     // 段大小，字节
+    u32 pages;    // 段大小，页数
+    u32 *frames;  // 每页的物理地址，还没有分配为 0
+    u32 attach;   // 映射到进程中的区域数量
+    bool removed; // 已经删除，最后一个区域解除映射时释放
+    pid_t cpid;   // 创建者的进程 id
+} shm_t;
+
+// 获取 shmid 对应的共享内存段，不存在返回 NULL
+shm_t *shm_get(int shmid);
+
+// 获取段中第 index 页的物理地址，第一次访问时分配清零的页，内存不足返回 0
+u32 shm_page_get(shm_t *shm, idx_t index);
+
+// 段映射到进程中，区域数量加一
+void shm_attach(shm_t *shm);
+
+// 区域解除映射，区域数量减一，已删除的段没有映射时释放
+void shm_detach(shm_t *shm);
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef ONIX_SLAB_H
+#define ONIX_SLAB_H
+
+#include <onix/types.h>
+#include <onix/list.h>
+
+#define KMEM_CACHE_NR 16 // 对象缓存数量
+#define KMEM_NAME_LEN 16 // 对象缓存名长度
+
+typedef void (*kmem_ctor_t)(void *object);
+
+// 对象缓存，每种内核对象一个
+typedef struct kmem_cache_t
+{
+    char name[KMEM_NAME_LEN]; // 缓存名
+    u32 size;                 // 对象大小
+    u32 stride;               // 对象占用的空间，包括空闲链接
+    u32 link;                 // 空闲链接在对象中的偏移
+    u32 count;                // 每页对象数量
+    kmem_ctor_t ctor;         // 对象构造函数，只在新页中调用
+    list_t partial;           // 部分使用的页
+    list_t full;              // 全部使用的页
+    list_t empty;             // 全部空闲的页
+
+    u32 pages;   // 占用的页数
+    u32 idle;    // 全部空闲的页数
+    u32 active;  // 正在使用的对象数量
+    u32 allocs;  // 累计分配次数
+    u32 frees;   // 累计释放次数
+    u32 grows;   // 累计申请新页次数
+    u32 shrinks; // 累计归还页次数
+} kmem_cache_t;
+
+// 对象缓存页，页首是描述符，随后是对象
+typedef struct slab_t
+{
+    list_node_t node;    // 链表结点
+    kmem_cache_t *cache; // 所属的缓存
+    void *free;          // 空闲对象链表
+    u32 inuse;           // 正在使用的对象数量
+    u32 magic;           // 魔数
+} slab_t;
+
+// 创建对象缓存，ctor 可以为 NULL
+kmem_cache_t *kmem_cache_create(const char *name, size_t size, kmem_ctor_t ctor);
+
+// 从缓存中分配一个对象
+void *kmem_cache_alloc(kmem_cache_t *cache);
+
+// 将对象释放回缓存，有构造函数的对象释放时应当恢复到构造后的状态
+void kmem_cache_free(kmem_cache_t *cache, void *object);
+
+// cache 之后的下一个缓存，cache 为 NULL 时返回第一个，没有返回 NULL
+kmem_cache_t *kmem_cache_next(kmem_cache_t *cache);
+
+#endif
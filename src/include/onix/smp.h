@@ -0,0 +1,45 @@
+#ifndef ONIX_SMP_H
+#define ONIX_SMP_H
+
+#include <onix/types.h>
+#include <onix/global.h>
+
+#define CPU_NR 8 // 最多支持的处理器数量
+
+// 应用处理器启动代码的物理地址，需要 4K 对齐且在 1M 以内
+#define AP_TRAMPOLINE 0x8000
+
+// 每个处理器的数据
+typedef struct cpu_t
+{
+    u32 id;                  // 处理器编号，启动处理器为 0
+    u32 apic_id;             // 本地 APIC 编号
+    bool volatile online;    // 已经启动，可以执行任务
+    bool locked;             // 持有大内核锁
+    u32 preempt_count;       // 禁止抢占计数，不为 0 时中断不切换任务
+    bool need_resched;       // 禁止抢占期间需要调度，恢复抢占时执行
+    struct task_t *current;  // 正在执行的任务
+    struct task_t *idle;     // 空闲任务
+    struct task_t *fpu_task; // 浮点环境所属的任务
+    tss_t tss;               // 任务状态段
+} cpu_t;
+
+extern cpu_t cpus[CPU_NR];
+extern u32 cpu_count; // 处理器数量
+
+// 当前处理器
+cpu_t *cpu_current();
+
+// 处理器是否空闲，没有就绪和正在执行的任务
+bool cpu_idle(cpu_t *cpu);
+
+// 除了当前处理器，其他处理器是否都空闲
+bool smp_idle();
+
+// 大内核锁，同一时刻只有一个处理器执行内核代码
+// 从用户态进入内核时获取，返回用户态和空闲暂停时释放，内核中的任务切换不释放
+void kernel_lock();       // 当前处理器没有持有时获取
+void kernel_unlock();     // 释放
+void kernel_lock_relax(); // 短暂释放，让其他处理器进入内核
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef ONIX_SOFTIRQ_H
+#define ONIX_SOFTIRQ_H
+
+#include <onix/types.h>
+#include <onix/list.h>
+
+// 软中断，硬件中断处理函数只应答设备，其余工作推迟到软中断中完成
+// 软中断在中断返回时打开中断执行，处理不完时交给 softirqd 线程
+// 软中断处理函数不能阻塞，也不能获取 lock_t 和 mutex_t
+enum
+{
+    SOFTIRQ_HI,      // 高优先级小任务，磁盘 IO 完成
+    SOFTIRQ_TASKLET, // 小任务，网卡收发
+    SOFTIRQ_NR,
+};
+
+// 小任务，同一个小任务在执行之前多次调度只执行一次
+typedef struct tasklet_t
+{
+    list_node_t node;                    // 软中断链表节点
+    void (*handler)(struct tasklet_t *); // 处理函数
+    void *arg;                           // 参数
+    bool scheduled;                      // 已经调度，等待执行
+} tasklet_t;
+
+// 注册软中断处理函数
+void softirq_register(u32 nr, void (*handler)());
+// 标记软中断等待执行，在中断返回时执行
+void softirq_raise(u32 nr);
+// 执行等待的软中断，需要在关中断时调用
+void softirq_run();
+
+// 初始化小任务
+void tasklet_init(tasklet_t *tasklet, void (*handler)(tasklet_t *), void *arg);
+// 调度小任务
+void tasklet_schedule(tasklet_t *tasklet);
+// 调度高优先级小任务，在普通小任务之前执行
+void tasklet_hi_schedule(tasklet_t *tasklet);
+
+#endif
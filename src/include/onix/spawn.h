@@ -0,0 +1,79 @@
+#ifndef ONIX_SPAWN_H
+#define ONIX_SPAWN_H
+
+#include <onix/types.h>
+#include <onix/signal.h>
+
+#if 0
+#include <spawn.h>
+#endif
+
+#define SPAWN_ACTION_NR 8 // 文件操作最大数量
+
+enum spawn_flag_t
+{
+    POSIX_SPAWN_SETPGROUP = 2,  // 设置进程组
+    POSIX_SPAWN_SETSIGDEF = 4,  // 将信号处理恢复默认
+    POSIX_SPAWN_SETSIGMASK = 8, // 设置信号屏蔽码
+};
+
+enum spawn_action_type_t
+{
+    SPAWN_ACTION_DUP2 = 1, // dup2(fd, newfd)
+    SPAWN_ACTION_CLOSE,    // close(fd)
+};
+
+typedef struct spawn_action_t
+{
+    int type;   // 操作类型
+    fd_t fd;    // 文件描述符
+    fd_t newfd; // dup2 的目标描述符
+} spawn_action_t;
+
+// 子进程执行程序之前，按顺序执行的文件操作
+typedef struct posix_spawn_file_actions_t
+{
+    int count;                               // 操作数量
+    spawn_action_t actions[SPAWN_ACTION_NR]; // 操作
+} posix_spawn_file_actions_t;
+
+// 子进程属性
+typedef struct posix_spawnattr_t
+{
+    int flags;           // 标志 spawn_flag_t
+    pid_t pgroup;        // 进程组，0 表示以子进程 pid 为进程组
+    sigset_t sigdefault; // 恢复默认处理的信号
+    sigset_t sigmask;    // 信号屏蔽码
+} posix_spawnattr_t;
+
+#define SPAWN_PAGES 4 // spawn 参数占用的内核页数
+
+// 内核中保存的 spawn 参数，子进程执行程序之后释放
+typedef struct spawn_t
+{
+    char *filename;                     // 程序路径
+    char **argv;                        // 参数
+    char **envp;                        // 环境变量
+    posix_spawn_file_actions_t actions; // 文件操作
+    posix_spawnattr_t attr;             // 子进程属性
+} spawn_t;
+
+int posix_spawn_file_actions_init(posix_spawn_file_actions_t *actions);
+int posix_spawn_file_actions_adddup2(posix_spawn_file_actions_t *actions, fd_t fd, fd_t newfd);
+int posix_spawn_file_actions_addclose(posix_spawn_file_actions_t *actions, fd_t fd);
+
+int posix_spawnattr_init(posix_spawnattr_t *attr);
+int posix_spawnattr_setflags(posix_spawnattr_t *attr, int flags);
+int posix_spawnattr_setpgroup(posix_spawnattr_t *attr, pid_t pgroup);
+int posix_spawnattr_setsigdefault(posix_spawnattr_t *attr, sigset_t sigdefault);
+int posix_spawnattr_setsigmask(posix_spawnattr_t *attr, sigset_t sigmask);
+
+// 创建子进程并执行 path，不拷贝父进程的地址空间
+// 成功返回 0，并将子进程 pid 写入 pid；失败返回错误码
+// 与 execve 一样，argv 不包括程序名
+int posix_spawn(pid_t *pid, char *path,
+                posix_spawn_file_actions_t *actions,
+                posix_spawnattr_t *attr,
+                char *argv[], char *envp[]);
+
+#endif
@@ -17,9 +17,17 @@ u8 bcd_to_bin(u8 value);
 u8 bin_to_bcd(u8 value);
 
 u32 div_round_up(u32 num, u32 size);
+// 64 位整数除以 32 位整数，返回商，余数存入 rem
+u64 div64(u64 num, u32 base, u32 *rem);
 
 bool isdigit(int c);
 
 int atoi(const char *str);
 
+// 用户态内存分配
+void *malloc(size_t size);
+void free(void *ptr);
+void *calloc(size_t count, size_t size);
+void *realloc(void *ptr, size_t size);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,40 @@
+#ifndef ONIX_SWAP_H
+#define ONIX_SWAP_H
+
+#include <onix/types.h>
+
+// 换出到交换区的页表项，present 为 0 时 CPU 不使用其余位
+// 保留原页表项的权限位，换入时恢复
+typedef struct swap_entry_t
+{
+    u8 present : 1;   // 必须为 0
+    u8 write : 1;     // 同 page_entry_t
+    u8 user : 1;      // 同 page_entry_t
+    u8 swapped : 1;   // 页在交换区中，原 pwt 位
+    u8 reserved0 : 4; // 保留，必须为 0
+    u8 reserved1 : 1; // 保留，必须为 0
+    u8 shared : 1;    // 同 page_entry_t
+    u8 privat : 1;    // 同 page_entry_t
+    u8 readonly : 1;  // 同 page_entry_t
+    u32 slot : 20;    // 交换区槽位
+} _packed swap_entry_t;
+
+// 分配一个交换槽位，交换区已满或未启用返回 0
+u32 swap_alloc();
+
+// 槽位引用加一，fork 拆分页表时使用
+void swap_dup(u32 slot);
+
+// 槽位引用减一，减到 0 时释放
+void swap_free(u32 slot);
+
+// 交换区剩余的槽位数量
+u32 swap_avail();
+
+// 从槽位读入一页
+err_t swap_read(u32 slot, void *page);
+
+// 将一页写入槽位
+err_t swap_write(u32 slot, void *page);
+
+#endif
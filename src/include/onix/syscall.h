@@ -56,12 +56,16 @@ typedef enum syscall_t
     SYS_NR_SIGACTION = 67,
     SYS_NR_SGETMASK = 68,
     SYS_NR_SSETMASK = 69,
+    SYS_NR_SWAPON = 87,
     SYS_NR_READDIR = 89,
     SYS_NR_MMAP = 90,
     SYS_NR_MUNMAP = 91,
+    SYS_NR_MPROTECT = 125,
+    SYS_NR_MSYNC = 144,
     SYS_NR_YIELD = 158,
     SYS_NR_SLEEP = 162,
     SYS_NR_GETCWD = 183,
+    SYS_NR_CLOCK_GETTIME = 265,
 
     SYS_NR_SOCKET = 359,
     SYS_NR_BIND = 361,
@@ -78,6 +82,13 @@ typedef enum syscall_t
     SYS_NR_RECVMSG,
     SYS_NR_SHUTDOWN,
     SYS_NR_RESOLV,
+    SYS_NR_SPAWN,
+    SYS_NR_NANOSLEEP,
+
+    SYS_NR_SHMGET = 395,
+    SYS_NR_SHMCTL,
+    SYS_NR_SHMAT,
+    SYS_NR_SHMDT,
 
     SYS_NR_MKFS = SYSCALL_SIZE - 1,
 } syscall_t;
@@ -96,9 +107,55 @@ enum mmap_type_t
     MAP_SHARED = 1,
     MAP_PRIVATE = 2,
     MAP_FIXED = 0x10,
+
+    MS_ASYNC = 1,
+    MS_INVALIDATE = 2,
+    MS_SYNC = 4,
 };
 
-u32 test();
+#if 0
+#include <sys/shm.h>
+#endif
+
+enum ipc_type_t
+{
+    IPC_PRIVATE = 0,
+
+    IPC_CREAT = 01000,
+    IPC_EXCL = 02000,
+
+    IPC_RMID = 0,
+    IPC_STAT = 2,
+
+    SHM_RDONLY = 010000,
+};
+
+// 时间，秒和纳秒
+typedef struct timespec_t
+{
+    time_t tv_sec; // 秒
+    int32 tv_nsec; // 纳秒 [0，999999999]
+} timespec_t;
+
+typedef enum clockid_t
+{
+    CLOCK_REALTIME = 0,         // 墙上时间，从 1970 年开始
+    CLOCK_MONOTONIC = 1,        // 开机以来的时间
+    CLOCK_REALTIME_COARSE = 5,  // 精确到时间片的墙上时间
+    CLOCK_MONOTONIC_COARSE = 6, // 精确到时间片的开机以来的时间
+} clockid_t;
+
+// 共享内存段信息
+typedef struct shmid_ds_t
+{
+    key_t shm_key;    // 键值
+    size_t shm_segsz; // 段大小
+    u32 shm_nattch;   // 映射的区域数量
+    pid_t shm_cpid;   // 创建者的进程 id
+} shmid_ds_t;
+
+// 内核测试，name 为 NULL 时执行默认测试
+u32 test(char *name);
 
 pid_t fork();
 void exit(int status);
@@ -109,6 +166,10 @@ int execve(char *filename, char *argv[], char *envp[]);
 
 void yield();
 void sleep(u32 ms);
+// 获取 clock 时钟的时间，精确到纳秒
+int clock_gettime(clockid_t clock, timespec_t *tp);
+// 睡眠 req 时间，被信号打断时返回 -EINTR，剩余时间存入 rem
+int nanosleep(const timespec_t *req, timespec_t *rem);
 
 pid_t getpid();
 pid_t getppid();
@@ -132,6 +193,19 @@ int ioctl(fd_t fd, int cmd, int args);
 int brk(void *addr);
 void *mmap(void *addr, size_t length, int prot, int flags, int fd, off_t offset);
 int munmap(void *addr, size_t length);
+// 将共享文件映射写回文件
+int msync(void *addr, size_t length, int flags);
+// 修改映射区域的保护标志
+int mprotect(void *addr, size_t length, int prot);
+
+// 获取 key 对应的共享内存段，IPC_CREAT 时不存在则创建
+int shmget(key_t key, size_t size, int flags);
+// 共享内存段控制，支持 IPC_STAT 和 IPC_RMID
+int shmctl(int shmid, int cmd, shmid_ds_t *buf);
+// 将共享内存段映射到进程中
+void *shmat(int shmid, const void *addr, int flags);
+// 解除 shmat 映射的共享内存段
+int shmdt(const void *addr);
 
 // 打开文件
 fd_t open(char *filename, int flags, int mode);
@@ -178,6 +252,9 @@ int mount(char *devname, char *dirname, int flags);
 // 卸载设备
 int umount(char *target);
 
+// 启用交换设备
+int swapon(char *devname);
+
 // 创建设备文件
 int mknod(char *filename, int mode, int dev);
 
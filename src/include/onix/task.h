@@ -4,14 +4,20 @@
 #include <onix/types.h>
 #include <onix/list.h>
 #include <onix/signal.h>
+#include <onix/clock.h>
 
 #define KERNEL_USER 0
 #define NORMAL_USER 1000
 
-#define TASK_NR 64
+// 每个进程占用三个内核页：任务页、pwd 和页目录，内核页不足时 fork 和 spawn 返回 -ENOMEM
+#define TASK_NR 512     // 最大任务数量
+#define PID_MAX 32768   // pid 从 0 到 PID_MAX - 1 循环分配
+#define PID_HASH_NR 256 // pid、进程组、会话哈希表大小
 #define TASK_NAME_LEN 16
 #define TASK_FILE_NR 16 // 进程文件数量
 
+#define TASK_PRIORITY_NR 32 // 优先级数量，优先级同时也是时间片的长度
+
 typedef void target_t();
 
 typedef enum task_state_t
@@ -35,8 +41,15 @@ typedef struct task_t
 {
     u32 *stack;                         // 内核栈
     list_node_t node;                   // 任务阻塞节点
+    list_node_t tnode;                  // 任务链表结点
+    list_node_t hnode;                  // pid 哈希链表结点
+    list_node_t pgnode;                 // 进程组哈希链表结点
+    list_node_t snode;                  // 会话哈希链表结点
+    list_t children;                    // 子进程链表
+    list_node_t sibling;                // 父进程的子进程链表结点
     task_state_t state;                 // 任务状态
-    u32 priority;                       // 任务优先级
+    u32 priority;                       // 任务优先级，可能因为优先级继承提升
+    u32 base_priority;                  // 基础优先级，不再继承时恢复
     int ticks;                          // 剩余时间片
     u32 jiffies;                        // 上次执行时全局时间片
     char name[TASK_NAME_LEN];           // 任务名
@@ -48,7 +61,7 @@ typedef struct task_t
     pid_t sid;                          // 进程会话
     dev_t tty;                          // tty 设备
     u32 pde;                            // 页目录物理地址
-    struct bitmap_t *vmap;              // 进程虚拟内存位图
+    list_t vma_list;                    // 进程映射区域链表，按地址有序
     u32 text;                           // 代码段地址
     u32 data;                           // 数据段地址
     u32 end;                            // 程序结束地址
@@ -64,10 +77,15 @@ typedef struct task_t
     u32 signal;                         // 进程信号位图
     u32 blocked;                        // 进程信号屏蔽位图
     struct timer_t *alarm;              // 闹钟定时器
-    struct timer_t *timer;              // 超时定时器
+    hrtimer_t timer;                    // 阻塞超时定时器
+    list_t timers;                      // 任务添加的全部定时器，退出时删除
     sigaction_t actions[MAXSIG];        // 信号处理函数
     struct fpu_t *fpu;                  // fpu 指针
+    struct spawn_t *spawn;              // spawn 参数，执行程序后释放
     u32 flags;                          // 特殊标记
+    struct cpu_t *cpu;                  // 所在处理器的就绪队列，或上次执行的处理器
+    list_t mutexes;                     // 持有的互斥量
+    struct mutex_t *mutex;              // 阻塞等待的互斥量
     u32 magic;                          // 内核魔数，用于检测栈溢出
 } task_t;
 
@@ -113,17 +131,43 @@ typedef struct intr_frame_t
 } intr_frame_t;
 
 task_t *get_task(pid_t pid);
+
+// 修改进程组，同时调整进程组链表
+void task_set_pgid(task_t *task, pid_t pgid);
+// 修改会话，同时调整会话链表
+void task_set_sid(task_t *task, pid_t sid);
+
+// 进程组 pgid 中 task 之后的下一个进程，task 为 NULL 时返回第一个，没有返回 NULL
+task_t *pgrp_next(pid_t pgid, task_t *task);
+// 会话 sid 中 task 之后的下一个进程，task 为 NULL 时返回第一个，没有返回 NULL
+task_t *session_next(pid_t sid, task_t *task);
 task_t *running_task();
 void schedule();
 
+// 禁止和恢复当前处理器的抢占，可以嵌套，需要在关中断时调用
+void preempt_disable();
+void preempt_enable();
+// 中断处理函数中需要切换任务时调用，禁止抢占时推迟到恢复抢占时调度
+void preempt_schedule();
+
+// 创建处理器 cpu 的空闲任务，空闲任务只在自己的处理器上执行
+task_t *task_idle_create(struct cpu_t *cpu);
+
 void task_exit(int status);
 pid_t task_fork();
+
+// 释放 spawn 参数，子进程执行程序之后调用
+void task_spawn_release(task_t *task);
 pid_t task_waitpid(pid_t pid, int32 *status);
 
 void task_yield();
 int task_block(task_t *task, list_t *blist, task_state_t state, int timeout_ms);
+int task_block_until(task_t *task, list_t *blist, task_state_t state, u64 expires);
 void task_unblock(task_t *task, int reason);
 
+// 设置任务的优先级，就绪的任务移到对应优先级的就绪链表
+void task_set_priority(task_t *task, u32 priority);
+
 void task_sleep(u32 ms);
 
 void task_to_user_mode();
@@ -8,7 +8,8 @@ typedef void *handler_t;
 
 typedef struct timer_t
 {
-    list_node_t node;                  // 链表节点
+    list_node_t node;                  // 时间轮槽链表节点
+    list_node_t tnode;                 // 任务定时器链表节点
     struct task_t *task;               // 相关任务
     u32 expires;                       // 超时时间
     void (*handler)(struct timer_t *); // 超时处理函数
@@ -22,6 +23,8 @@ timer_t *timer_add(u32 expire_ms, handler_t handler, void *arg);
 void timer_put(timer_t *timer);
 // 唤醒定时器
 void timer_wakeup();
+// 下一个需要处理的时间片
+u32 timer_next_jiffies();
 // 移除 task 相关的全部定时器
 void timer_remove(struct task_t *task);
 // 更新定时器超时
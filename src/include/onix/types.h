@@ -48,6 +48,7 @@ typedef unsigned long long u64;
 
 typedef int32 pid_t;
 typedef int32 dev_t;
+typedef int32 key_t; // 进程间通信键值
 
 typedef u32 time_t;
 typedef u32 idx_t;
@@ -0,0 +1,44 @@
+#ifndef ONIX_WAIT_H
+#define ONIX_WAIT_H
+
+#include <onix/types.h>
+#include <onix/list.h>
+
+// 等待队列，可以有多个任务同时等待，任务的阻塞节点直接链接在队列中
+// 被信号唤醒或者超时的任务由 task_unblock 从队列中删除
+typedef struct wait_queue_t
+{
+    list_t waiters; // 等待的任务，新任务在头部
+} wait_queue_t;
+
+void wait_queue_init(wait_queue_t *wq);   // 初始化等待队列
+bool wait_queue_active(wait_queue_t *wq); // 是否有任务在等待
+
+// 超时 timeout_ms 毫秒对应的纳秒时间，timeout_ms 不大于 0 时返回 0 表示不会超时
+u64 wait_expires(int timeout_ms);
+
+// 当前任务在等待队列上阻塞，直到被唤醒，或者到达 expires 纳秒，返回唤醒的原因
+err_t wait_until(wait_queue_t *wq, int state, u64 expires);
+
+// 当前任务在等待队列上阻塞，直到被唤醒，或者超时 timeout_ms 毫秒
+err_t wait_timeout(wait_queue_t *wq, int state, int timeout_ms);
+
+void wake_up(wait_queue_t *wq, int reason);     // 唤醒等待最久的任务
+void wake_up_all(wait_queue_t *wq, int reason); // 唤醒全部任务
+
+// 等待直到 condition 成立，每次被唤醒时重新检查，总的超时时间为 timeout_ms 毫秒
+// ret 为 EOK 表示条件成立，否则为唤醒的原因，比如超时 -ETIME，需要在关中断时调用
+#define wait_event(ret, wq, condition, state, timeout_ms)  \
+    do                                                     \
+    {                                                      \
+        u64 __expires = wait_expires(timeout_ms);          \
+        (ret) = EOK;                                       \
+        while (!(condition))                               \
+        {                                                  \
+            (ret) = wait_until((wq), (state), __expires);  \
+            if ((ret) < EOK)                               \
+                break;                                     \
+        }                                                  \
+    } while (0)
+
+#endif
@@ -0,0 +1,200 @@
+#include <onix/apic.h>
+#include <onix/interrupt.h>
+#include <onix/clock.h>
+#include <onix/memory.h>
+#include <onix/stdlib.h>
+#include <onix/debug.h>
+#include <onix/assert.h>
+
+#define LOGK(fmt, args...) DEBUGK(fmt, ##args)
+
+#define LAPIC_CALIBRATE_NS (NSEC_PER_JIFFY * 5) // 定时器校准时长 50 毫秒
+
+#define IOAPIC_IRQ_NR 16 // ISA 中断数量
+
+// irq 连接的 IOAPIC 引脚
+typedef struct ioapic_route_t
+{
+    bool valid; // 配置表中有对应的表项
+    u8 pin;     // 引脚
+    u32 flags;  // 触发方式和极性
+} ioapic_route_t;
+
+static u32 lapic_base;  // 本地 APIC 寄存器映射的地址
+static u32 timer_count; // 定时器每个时间片的计数
+
+static u32 ioapic_base; // IOAPIC 寄存器映射的地址
+static u32 ioapic_pins; // 引脚数量
+static u32 ioapic_dest; // 中断发送的本地 APIC 编号
+static ioapic_route_t ioapic_routes[IOAPIC_IRQ_NR];
+
+static _inline u32 lapic_read(u32 reg)
+{
+    return *(u32 volatile *)(lapic_base + reg);
+}
+
+static _inline void lapic_write(u32 reg, u32 value)
+{
+    *(u32 volatile *)(lapic_base + reg) = value;
+}
+
+// 忙等 ns 纳秒
+static void lapic_delay(u64 ns)
+{
+    u64 expires = clock_monotonic() + ns;
+    while (clock_monotonic() < expires)
+        ;
+}
+
+void lapic_map(u32 base)
+{
+    lapic_base = base;
+    map_mmio(base, PAGE_SIZE);
+}
+
+void lapic_init(bool extint)
+{
+    assert(lapic_base);
+
+    // 启用本地 APIC，设置伪中断向量，接受所有优先级的中断
+    lapic_write(LAPIC_SVR, LAPIC_SVR_ENABLE | INTR_SPURIOUS);
+    lapic_write(LAPIC_TPR, 0);
+
+    // 使用 8259 时启动处理器通过 LINT0 接收中断，其他情况屏蔽
+    if (extint)
+        lapic_write(LAPIC_LVT_LINT0, LAPIC_LVT_EXTINT);
+    else
+        lapic_write(LAPIC_LVT_LINT0, LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_LVT_LINT1, LAPIC_LVT_NMI);
+
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_LVT_ERROR, LAPIC_LVT_MASKED);
+
+    // 错误状态寄存器需要先写再读
+    lapic_write(LAPIC_ESR, 0);
+    lapic_write(LAPIC_ESR, 0);
+    lapic_eoi();
+}
+
+bool lapic_enabled()
+{
+    return lapic_base != 0;
+}
+
+u32 lapic_id()
+{
+    return lapic_read(LAPIC_ID) >> 24;
+}
+
+void lapic_eoi()
+{
+    lapic_write(LAPIC_EOI, 0);
+}
+
+// 写中断命令寄存器，等待发送完成
+static void lapic_icr(u32 apic_id, u32 command)
+{
+    lapic_write(LAPIC_ICR_HIGH, apic_id << 24);
+    lapic_write(LAPIC_ICR_LOW, command);
+    while (lapic_read(LAPIC_ICR_LOW) & ICR_PENDING)
+        ;
+}
+
+void lapic_send_ipi(u32 apic_id, u32 vector)
+{
+    lapic_icr(apic_id, ICR_FIXED | vector);
+}
+
+void lapic_startup(u32 apic_id, u32 addr)
+{
+    assert((addr & 0xfff) == 0 && addr < 0x100000);
+
+    // INIT 复位处理器，等待 10 毫秒
+    lapic_icr(apic_id, ICR_INIT | ICR_LEVEL | ICR_ASSERT);
+    lapic_icr(apic_id, ICR_INIT | ICR_LEVEL);
+    lapic_delay(10 * NSEC_PER_MSEC);
+
+    // 发送两次 STARTUP，向量是起始地址的页号
+    for (size_t i = 0; i < 2; i++)
+    {
+        lapic_icr(apic_id, ICR_STARTUP | (addr >> 12));
+        lapic_delay(200 * NSEC_PER_USEC);
+    }
+}
+
+void lapic_timer_calibrate()
+{
+    lapic_write(LAPIC_TIMER_DIV, LAPIC_TIMER_DIV16);
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_TIMER_INIT, 0xffffffff);
+    lapic_delay(LAPIC_CALIBRATE_NS);
+    u32 count = 0xffffffff - lapic_read(LAPIC_TIMER_COUNT);
+    lapic_write(LAPIC_TIMER_INIT, 0);
+
+    timer_count = count / (LAPIC_CALIBRATE_NS / NSEC_PER_JIFFY);
+    LOGK("lapic timer %d counts per jiffy\n", timer_count);
+}
+
+void lapic_timer_start(u32 vector)
+{
+    assert(timer_count);
+    lapic_write(LAPIC_TIMER_DIV, LAPIC_TIMER_DIV16);
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_PERIODIC | vector);
+    lapic_write(LAPIC_TIMER_INIT, timer_count);
+}
+
+static u32 ioapic_read(u32 reg)
+{
+    *(u32 volatile *)(ioapic_base + IOAPIC_REGSEL) = reg;
+    return *(u32 volatile *)(ioapic_base + IOAPIC_WINDOW);
+}
+
+static void ioapic_write(u32 reg, u32 value)
+{
+    *(u32 volatile *)(ioapic_base + IOAPIC_REGSEL) = reg;
+    *(u32 volatile *)(ioapic_base + IOAPIC_WINDOW) = value;
+}
+
+void ioapic_route(u32 irq, u32 pin, u32 flags)
+{
+    assert(irq < IOAPIC_IRQ_NR);
+    ioapic_route_t *route = &ioapic_routes[irq];
+    route->valid = true;
+    route->pin = pin;
+    route->flags = flags & (IOAPIC_LOW | IOAPIC_LEVEL);
+}
+
+void ioapic_map(u32 base)
+{
+    assert(lapic_base);
+    ioapic_base = base;
+    map_mmio(base, PAGE_SIZE);
+
+    ioapic_pins = ((ioapic_read(IOAPIC_VERSION) >> 16) & 0xff) + 1;
+    ioapic_dest = lapic_id();
+    for (size_t pin = 0; pin < ioapic_pins; pin++)
+    {
+        ioapic_write(IOAPIC_REDTBL + pin * 2, IOAPIC_MASKED);
+    }
+    LOGK("ioapic base 0x%X %d pins\n", base, ioapic_pins);
+}
+
+void ioapic_mask(u32 irq, bool enable)
+{
+    assert(irq < IOAPIC_IRQ_NR);
+    ioapic_route_t *route = &ioapic_routes[irq];
+
+    u32 pin = irq;
+    u32 low = IRQ_MASTER_NR + irq;
+    if (route->valid)
+    {
+        pin = route->pin;
+        low |= route->flags;
+    }
+    assert(pin < ioapic_pins);
+
+    if (!enable)
+        low |= IOAPIC_MASKED;
+    ioapic_write(IOAPIC_REDTBL + pin * 2 + 1, ioapic_dest << 24);
+    ioapic_write(IOAPIC_REDTBL + pin * 2, low);
+}
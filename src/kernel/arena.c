@@ -9,6 +9,8 @@
 extern u32 free_pages;
 static arena_descriptor_t descriptors[DESC_COUNT];
 
+static u32 arena_shrink(u32 count);
+
 // arena 初始化
 void arena_init()
 {
@@ -19,9 +21,12 @@ void arena_init()
         desc->block_size = block_size;
         desc->total_block = (PAGE_SIZE - sizeof(arena_t)) / block_size;
         desc->page_count = 0;
-        list_init(&desc->free_list);
+        list_init(&desc->partial);
+        list_init(&desc->full);
+        list_init(&desc->empty);
         block_size <<= 1; // block *= 2;
     }
+    shrinker_register(ZONE_KERNEL, arena_shrink);
 }
 
 // 获得 arena 第 idx 块内存指针
@@ -38,6 +43,14 @@ static arena_t *get_block_arena(block_t *block)
     return (arena_t *)((u32)block & 0xfffff000);
 }
 
+// 将 arena 移动到描述符的 list 链表中，不做查重，保证 O(1)
+static void arena_move(list_t *list, arena_t *arena)
+{
+    if (arena->node.next)
+        list_remove(&arena->node);
+    list_insert_after(&list->head, &arena->node);
+}
+
 void *kmalloc(size_t size)
 {
     arena_descriptor_t *desc = NULL;
@@ -51,6 +64,8 @@ void *kmalloc(size_t size)
         u32 count = div_round_up(asize, PAGE_SIZE);
 
         arena = (arena_t *)alloc_kpage(count);
+        if (!arena)
+            panic("Out of kernel memory!!!");
         memset(arena, 0, count * PAGE_SIZE);
         arena->large = true;
         arena->count = count;
@@ -70,9 +85,21 @@ void *kmalloc(size_t size)
 
     assert(desc != NULL);
 
-    if (list_empty(&desc->free_list))
+    if (!list_empty(&desc->partial))
+    {
+        arena = element_entry(arena_t, node, desc->partial.head.next);
+    }
+    else if (!list_empty(&desc->empty))
+    {
+        arena = element_entry(arena_t, node, desc->empty.head.next);
+        arena_move(&desc->partial, arena);
+    }
+    else
     {
+        // 新页的块在第一次分配时才使用，不需要逐块加入空闲链表
         arena = (arena_t *)alloc_kpage(1);
+        if (!arena)
+            panic("Out of kernel memory!!!");
         memset(arena, 0, PAGE_SIZE);
 
         desc->page_count++;
@@ -81,24 +108,32 @@ void *kmalloc(size_t size)
         arena->large = false;
         arena->count = desc->total_block;
         arena->magic = ONIX_MAGIC;
+        arena->free = NULL;
+        arena->unused = 0;
 
-        for (size_t i = 0; i < desc->total_block; i++)
-        {
-            block = get_arena_block(arena, i);
-            assert(!list_search(&arena->desc->free_list, block));
-            list_push(&arena->desc->free_list, block);
-            assert(list_search(&arena->desc->free_list, block));
-        }
+        arena_move(&desc->partial, arena);
     }
 
-    block = list_pop(&desc->free_list);
-
-    arena = get_block_arena(block);
     assert(arena->magic == ONIX_MAGIC && !arena->large);
+    assert(arena->count > 0);
+
+    if (arena->free)
+    {
+        block = arena->free;
+        arena->free = block->next;
+    }
+    else
+    {
+        block = get_arena_block(arena, arena->unused++);
+    }
 
     // memset(block, 0, desc->block_size);
 
     arena->count--;
+    if (!arena->count)
+    {
+        arena_move(&desc->full, arena);
+    }
 
     return block;
 }
@@ -119,21 +154,54 @@ void kfree(void *ptr)
         return;
     }
 
-    list_push(&arena->desc->free_list, block);
+    arena_descriptor_t *desc = arena->desc;
+
+    block->next = arena->free;
+    arena->free = block;
+
+    if (!arena->count)
+    {
+        arena_move(&desc->partial, arena);
+    }
+
     arena->count++;
+    assert(arena->count <= desc->total_block);
+
+    if (arena->count < desc->total_block)
+        return;
 
-    if (arena->count == arena->desc->total_block && arena->desc->page_count > BUF_COUNT)
+    // 整页空闲，缓存页足够多时直接释放，否则留作缓存
+    if (desc->page_count > BUF_COUNT)
     {
-        for (size_t i = 0; i < arena->desc->total_block; i++)
-        {
-            block = get_arena_block(arena, i);
-            assert(list_search(&arena->desc->free_list, block));
-            list_remove(block);
-            assert(!list_search(&arena->desc->free_list, block));
-        }
-        arena->desc->page_count--;
-        assert(arena->desc->page_count >= BUF_COUNT);
+        list_remove(&arena->node);
+        arena->magic = 0;
+        desc->page_count--;
+        assert(desc->page_count >= BUF_COUNT);
 
         free_kpage((u32)arena, 1);
+        return;
+    }
+
+    arena_move(&desc->empty, arena);
+}
+
+// 内存回收，释放缓存的空闲页
+static u32 arena_shrink(u32 count)
+{
+    u32 freed = 0;
+    for (size_t i = 0; i < DESC_COUNT && freed < count; i++)
+    {
+        arena_descriptor_t *desc = &descriptors[i];
+        while (freed < count && !list_empty(&desc->empty))
+        {
+            arena_t *arena = element_entry(arena_t, node, list_pop(&desc->empty));
+            assert(arena->count == desc->total_block);
+            arena->magic = 0;
+            desc->page_count--;
+
+            free_kpage((u32)arena, 1);
+            freed++;
+        }
     }
+    return freed;
 }
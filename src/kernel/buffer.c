@@ -84,17 +84,18 @@ static void hash_remove(bdesc_t *desc, buffer_t *buf)
     }
 }
 
-// 初始化缓冲
+// 初始化缓冲，同一页的缓冲描述符连续存放，便于回收时找到整页
+// 内核内存不足返回 -ENOMEM，调用者等待已有的缓冲释放
 static err_t buffer_alloc(bdesc_t *desc)
 {
-    buffer_t *buf = NULL;
     void *addr = (void *)alloc_kpage(1);
-    int left = PAGE_SIZE;
+    if (!addr)
+        return -ENOMEM;
+    buffer_t *buf = kmalloc(sizeof(buffer_t) * (PAGE_SIZE / desc->size));
 
     for (size_t left = PAGE_SIZE; left > 0;
-         left -= desc->size, addr += desc->size, desc->count++)
+         left -= desc->size, addr += desc->size, desc->count++, buf++)
     {
-        buf = kmalloc(sizeof(buffer_t));
 
         buf->desc = desc;
         buf->data = addr;
@@ -268,6 +269,68 @@ err_t bdirty(buffer_t *buf, bool dirty)
     buf->dirty = dirty;
 }
 
+// 尝试释放 buf 所在的整页，页中所有缓冲都未被引用且与磁盘一致才可以释放
+static bool buffer_free_page(bdesc_t *desc, buffer_t *buf)
+{
+    u32 page = (u32)buf->data & ~(PAGE_SIZE - 1);
+    u32 count = PAGE_SIZE / desc->size;
+    buffer_t *first = buf - ((u32)buf->data - page) / desc->size;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        buffer_t *ptr = &first[i];
+        if (ptr->count || ptr->dirty)
+            return false;
+        assert(ptr->rnode.next);
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        buffer_t *ptr = &first[i];
+        list_remove(&ptr->rnode);
+        hash_remove(desc, ptr);
+    }
+
+    free_kpage(page, 1);
+    kfree(first);
+    desc->count -= count;
+    LOGK("buffer size %d shrink count %d\n", desc->size, desc->count);
+    return true;
+}
+
+// 从链表尾部（最远未访问）开始查找可以释放的页
+static u32 buffer_shrink_list(bdesc_t *desc, list_t *list, u32 count)
+{
+    u32 freed = 0;
+    list_node_t *node = list->tail.prev;
+    while (freed < count && node != &list->head)
+    {
+        buffer_t *buf = element_entry(buffer_t, rnode, node);
+        if (!buffer_free_page(desc, buf))
+        {
+            node = node->prev;
+            continue;
+        }
+        // 链表已经改变，从头开始
+        freed++;
+        node = list->tail.prev;
+    }
+    return freed;
+}
+
+// 内存回收，优先释放未使用的缓冲，然后是空闲的缓冲
+static u32 buffer_shrink(u32 count)
+{
+    u32 freed = 0;
+    for (size_t i = 0; i < BUFFER_DESC_NR && freed < count; i++)
+    {
+        bdesc_t *desc = &bdescs[i];
+        freed += buffer_shrink_list(desc, &desc->free_list, count - freed);
+        freed += buffer_shrink_list(desc, &desc->idle_list, count - freed);
+    }
+    return freed;
+}
+
 void buffer_init()
 {
     LOGK("buffer_t size is %d\n", sizeof(buffer_t));
@@ -294,4 +357,6 @@ void buffer_init()
             list_init(&desc->hash_table[i]);
         }
     }
+
+    shrinker_register(ZONE_KERNEL, buffer_shrink);
 }
@@ -1,18 +1,41 @@
+#include <onix/clock.h>
 #include <onix/io.h>
 #include <onix/interrupt.h>
 #include <onix/assert.h>
 #include <onix/debug.h>
 #include <onix/task.h>
 #include <onix/timer.h>
+#include <onix/cpu.h>
+#include <onix/memory.h>
+#include <onix/syscall.h>
+#include <onix/stdlib.h>
+#include <onix/errno.h>
+#include <onix/string.h>
+#include <onix/smp.h>
+
+#define LOGK(fmt, args...) DEBUGK(fmt, ##args)
 
 #define PIT_CHAN0_REG 0X40
 #define PIT_CHAN2_REG 0X42
 #define PIT_CTRL_REG 0X43
 
-#define HZ 100
 #define OSCILLATOR 1193182
-#define CLOCK_COUNTER (OSCILLATOR / HZ)
-#define JIFFY (1000 / HZ)
+
+// 计数器 0 工作在方式 0，计数到 0 时产生一次中断，每次中断后重新设置计数值
+#define PIT_ONESHOT 0b00110000  // 计数器 0，先低后高字节，方式 0，二进制计数
+#define PIT_READBACK 0b11000010 // 读回命令，同时锁存计数器 0 的状态和计数值
+#define PIT_STATUS_NULL 0x40    // 计数值还没有装入计数器
+
+#define PIT_COUNT_MAX 0xffff // 最长约 54.9 毫秒
+#define PIT_COUNT_MIN 12     // 最短约 10 微秒，避免中断过于频繁
+
+// 计数值和纳秒的换算使用定点数，避免 64 位除法
+#define PIT_NS_PER_COUNT 54925401 // 每个计数的纳秒数，左移 16 位
+#define PIT_COUNT_PER_NS 5124678  // 每纳秒的计数，左移 32 位
+#define PIT_MAX_NS 54924563       // PIT_COUNT_MAX 对应的纳秒数
+
+// 时钟源是时间戳计数器，开机时用计数器 0 校准频率
+#define TSC_CALIBRATE_COUNT (OSCILLATOR / 25) // 校准时长 40 毫秒
 
 #define SPEAKER_REG 0x61
 #define BEEP_HZ 440
@@ -22,6 +45,12 @@
 u32 volatile jiffies = 0;
 u32 jiffy = JIFFY;
 
+static vtime_t *vtime;      // 时间页，同时记录时钟源的校准结果
+static u64 clock_event;     // 下一次时钟中断的纳秒数
+static u64 next_tick;       // 下一个时间片开始的纳秒数
+static bool tick_stopped;   // 空闲时停止周期时钟
+static list_t hrtimer_list; // 高精度定时器链表，按照超时时间排序
+
 bool volatile beeping = 0;
 
 void start_beep()
@@ -38,40 +67,252 @@ void start_beep()
     }
 }
 
+static _inline u64 count_to_ns(u32 count)
+{
+    return ((u64)count * PIT_NS_PER_COUNT) >> 16;
+}
+
+// 读取计数器 0 的当前计数值，计数值还没有装入时返回最大值
+static u16 pit_read()
+{
+    outb(PIT_CTRL_REG, PIT_READBACK);
+    u8 status = inb(PIT_CHAN0_REG);
+    u16 count = inb(PIT_CHAN0_REG);
+    count |= inb(PIT_CHAN0_REG) << 8;
+
+    if (status & PIT_STATUS_NULL)
+        return PIT_COUNT_MAX;
+    return count;
+}
+
+// 开始新的计数周期，count 个计数之后产生中断
+static void pit_oneshot(u32 count)
+{
+    outb(PIT_CTRL_REG, PIT_ONESHOT);
+    outb(PIT_CHAN0_REG, count & 0xff);
+    outb(PIT_CHAN0_REG, (count >> 8) & 0xff);
+}
+
+// 用计数器 0 测量时间戳计数器的频率，需要在开启时钟中断之前调用
+static void tsc_calibrate()
+{
+    pit_oneshot(PIT_COUNT_MAX);
+
+    u32 begin = pit_read();
+    u64 start = cpu_rdtsc();
+    while (begin - pit_read() < TSC_CALIBRATE_COUNT)
+        ;
+    u32 end = pit_read();
+    u64 cycles = cpu_rdtsc() - start;
+
+    vtime->tsc_khz = div64(cycles * OSCILLATOR, (begin - end) * 1000, NULL);
+    vtime->tsc_mult = div64((u64)NSEC_PER_MSEC << TSC_SHIFT, vtime->tsc_khz, NULL);
+    vtime->tsc_boot = cpu_rdtsc();
+    LOGK("tsc frequency %d kHz\n", vtime->tsc_khz);
+}
+
+u64 clock_monotonic()
+{
+    return vtime_monotonic(vtime);
+}
+
+void clock_set_startup(time_t time)
+{
+    vtime->startup_time = time;
+}
+
+// 在 expires 纳秒时产生时钟中断，超过计数器范围时先在最长时间产生一次中断
+static void clock_program(u64 expires)
+{
+    u64 now = clock_monotonic();
+
+    u32 count = PIT_COUNT_MIN;
+    if (expires > now)
+    {
+        u64 delta = expires - now;
+        if (delta >= PIT_MAX_NS)
+            count = PIT_COUNT_MAX;
+        else
+        {
+            // 向上取整，保证中断时已经超时
+            count = (((u64)(u32)delta * PIT_COUNT_PER_NS) >> 32) + 1;
+            if (count < PIT_COUNT_MIN)
+                count = PIT_COUNT_MIN;
+            if (count > PIT_COUNT_MAX)
+                count = PIT_COUNT_MAX;
+        }
+    }
+    clock_event = now + count_to_ns(count);
+    pit_oneshot(count);
+}
+
+// 根据周期时钟、时间轮和高精度定时器设置下一次时钟中断
+static void clock_reprogram()
+{
+    u64 expires = next_tick;
+
+    // 停止周期时钟时，直到时间轮中有定时器需要处理才产生中断
+    if (tick_stopped)
+    {
+        int delta = timer_next_jiffies() - jiffies - 1;
+        if (delta > HZ)
+            delta = HZ;
+        if (delta > 0)
+            expires += (u64)delta * NSEC_PER_JIFFY;
+    }
+
+    if (!list_empty(&hrtimer_list))
+    {
+        hrtimer_t *timer = element_entry(hrtimer_t, node, hrtimer_list.head.next);
+        if (timer->expires < expires)
+            expires = timer->expires;
+    }
+    clock_program(expires);
+}
+
+void hrtimer_init(hrtimer_t *timer, void (*handler)(hrtimer_t *), void *arg)
+{
+    timer->node.next = NULL;
+    timer->node.prev = NULL;
+    timer->expires = 0;
+    timer->handler = handler;
+    timer->arg = arg;
+}
+
+bool hrtimer_active(hrtimer_t *timer)
+{
+    return timer->node.next != NULL;
+}
+
+void hrtimer_start(hrtimer_t *timer, u64 expires)
+{
+    bool intr = interrupt_disable();
+
+    if (hrtimer_active(timer))
+        list_remove(&timer->node);
+    timer->expires = expires;
+
+    list_node_t *anchor = &hrtimer_list.tail;
+    for (list_node_t *ptr = hrtimer_list.head.next; ptr != &hrtimer_list.tail; ptr = ptr->next)
+    {
+        hrtimer_t *entry = element_entry(hrtimer_t, node, ptr);
+        if (entry->expires > expires)
+        {
+            anchor = ptr;
+            break;
+        }
+    }
+    list_insert_before(anchor, &timer->node);
+
+    // 比下一次时钟中断更早超时，重新设置时钟
+    if (expires < clock_event)
+        clock_reprogram();
+
+    set_interrupt_state(intr);
+}
+
+bool hrtimer_cancel(hrtimer_t *timer)
+{
+    bool intr = interrupt_disable();
+    bool active = hrtimer_active(timer);
+    if (active)
+        list_remove(&timer->node);
+    set_interrupt_state(intr);
+    return active;
+}
+
+// 处理已经超时的高精度定时器，处理函数中可以重新启动定时器
+static void hrtimer_run(u64 now)
+{
+    while (!list_empty(&hrtimer_list))
+    {
+        hrtimer_t *timer = element_entry(hrtimer_t, node, hrtimer_list.head.next);
+        if (timer->expires > now)
+            break;
+        list_remove(&timer->node);
+        timer->handler(timer);
+    }
+}
+
+void clock_idle_enter()
+{
+    assert(!get_interrupt_state());
+
+    // 其他处理器还在执行任务，需要周期时钟更新时间片
+    if (!smp_idle())
+        return;
+
+    tick_stopped = true;
+    clock_reprogram();
+}
+
+void clock_idle_exit()
+{
+    bool intr = interrupt_disable();
+    if (tick_stopped)
+    {
+        // 已经错过的时间片在马上到来的时钟中断中补上
+        tick_stopped = false;
+        clock_reprogram();
+    }
+    set_interrupt_state(intr);
+}
+
 void clock_handler(int vector)
 {
     assert(vector == 0x20);
     send_eoi(vector); // 发送中断处理结束
 
-    jiffies++;
+    u64 now = clock_monotonic();
+
+    // 停止周期时钟时可能经过了多个时间片
+    bool tick = false;
+    while (now >= next_tick)
+    {
+        jiffies++;
+        next_tick += NSEC_PER_JIFFY;
+        tick = true;
+    }
+    vtime->jiffies = jiffies;
     // DEBUGK("clock jiffies %d ...\n", jiffies);
 
+    hrtimer_run(now);
     timer_wakeup();
+    clock_reprogram();
+
+    // 空闲任务停止周期时钟时不需要时间片，退出空闲状态后自己让出执行权
+    if (!tick || tick_stopped)
+        return;
 
     task_t *task = running_task();
     assert(task->magic == ONIX_MAGIC);
 
     task->jiffies = jiffies;
     task->ticks--;
-    if (!task->ticks)
+    if (task->ticks <= 0)
     {
-        schedule();
+        preempt_schedule();
     }
 }
 
-extern u32 startup_time;
-
 time_t sys_time()
 {
-    return startup_time + (jiffies * JIFFY) / 1000;
+    return vtime->startup_time + div64(clock_monotonic(), NSEC_PER_SEC, NULL);
+}
+
+int sys_clock_gettime(clockid_t clock, timespec_t *tp)
+{
+    if (!memory_access(tp, sizeof(timespec_t), true, running_task()->uid))
+        return -EFAULT;
+    return vtime_gettime(vtime, clock, tp);
 }
 
 void pit_init()
 {
-    // 配置计数器 0 时钟
-    outb(PIT_CTRL_REG, 0b00110100);
-    outb(PIT_CHAN0_REG, CLOCK_COUNTER & 0xff);
-    outb(PIT_CHAN0_REG, (CLOCK_COUNTER >> 8) & 0xff);
+    // 校准时钟源，然后配置计数器 0 时钟，第一次中断在第一个时间片结束时
+    tsc_calibrate();
+    next_tick = NSEC_PER_JIFFY;
+    clock_program(next_tick);
 
     // 配置计数器 2 蜂鸣器
     outb(PIT_CTRL_REG, 0b10110110);
@@ -81,6 +322,13 @@ void pit_init()
 
 void clock_init()
 {
+    // 时间页在创建任务之前映射，所有进程的页目录都会继承
+    vtime = (vtime_t *)alloc_kpage(1);
+    assert(vtime);
+    memset(vtime, 0, PAGE_SIZE);
+    map_user_readonly(USER_VTIME_ADDR, (u32)vtime);
+
+    list_init(&hrtimer_list);
     pit_init();
     set_interrupt_handler(IRQ_CLOCK, clock_handler);
     set_interrupt_mask(IRQ_CLOCK, true);
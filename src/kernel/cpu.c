@@ -45,3 +45,18 @@ void cpu_version(cpu_version_t *item)
           "=d"(*((u32 *)item + 3))
         : "a"(1));
 }
+
+// 得到 cr4 寄存器
+u32 get_cr4()
+{
+    u32 cr4;
+    asm volatile("movl %%cr4, %0\n"
+                 : "=r"(cr4));
+    return cr4;
+}
+
+// 设置 cr4 寄存器
+void set_cr4(u32 cr4)
+{
+    asm volatile("movl %0, %%cr4\n" ::"r"(cr4));
+}
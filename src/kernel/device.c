@@ -3,12 +3,13 @@
 #include <onix/task.h>
 #include <onix/assert.h>
 #include <onix/debug.h>
-#include <onix/arena.h>
+#include <onix/slab.h>
 #include <onix/errno.h>
 
 #define LOGK(fmt, args...) DEBUGK(fmt, ##args)
 
 static device_t devices[DEVICE_NR]; // 设备数组
+static kmem_cache_t *request_cache; // 块设备请求缓存
 
 // 获取空设备
 static device_t *get_null_device()
@@ -90,6 +91,8 @@ void device_init()
         list_init(&device->request_list);
         device->direct = DIRECT_UP;
     }
+
+    request_cache = kmem_cache_create("request", sizeof(request_t), NULL);
 }
 
 device_t *device_find(int subtype, idx_t idx)
@@ -178,7 +181,7 @@ err_t device_request(dev_t dev, void *buf, u8 count, idx_t idx, int flags, u32 t
         device = device_get(device->parent);
     }
 
-    request_t *req = kmalloc(sizeof(request_t));
+    request_t *req = kmem_cache_alloc(request_cache);
     memset(req, 0, sizeof(request_t));
 
     req->dev = device->dev;
@@ -212,7 +215,7 @@ err_t device_request(dev_t dev, void *buf, u8 count, idx_t idx, int flags, u32 t
     request_t *nextreq = request_nextreq(device, req);
 
     list_remove(&req->node);
-    kfree(req);
+    kmem_cache_free(request_cache, req);
 
     if (nextreq)
     {
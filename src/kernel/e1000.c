@@ -7,6 +7,10 @@
 #include <onix/arena.h>
 #include <onix/string.h>
 #include <onix/interrupt.h>
+#include <onix/softirq.h>
+#include <onix/wait.h>
+#include <onix/apic.h>
+#include <onix/smp.h>
 #include <onix/net.h>
 #include <onix/assert.h>
 #include <onix/debug.h>
@@ -234,14 +238,17 @@ typedef struct e1000_t
     rx_desc_t *rx_desc; // 接收描述符
     u16 rx_cur;         // 接收描述符指针
 
-    tx_desc_t *tx_desc; // 传输描述符
-    u16 tx_cur;         // 传输描述符指针
-    task_t *tx_waiter;  // 传输等待进程
+    tx_desc_t *tx_desc;   // 传输描述符
+    u16 tx_cur;           // 传输描述符指针
+    wait_queue_t tx_wait; // 传输等待队列
 
     pbuf_t **rx_pbuf; // 接收高速缓冲数组
     pbuf_t **tx_pbuf; // 传输高速缓冲数组
 
     netif_t *netif; // 虚拟网卡
+
+    tasklet_t tasklet;   // 中断下半部，回收和接收数据包
+    u32 volatile status; // 等待下半部处理的中断状态
 } e1000_t;
 
 static e1000_t obj;
@@ -268,15 +275,18 @@ static void recv_packet(e1000_t *e1000)
         pbuf_t *pbuf = e1000->rx_pbuf[e1000->rx_cur];
         assert(pbuf == element_entry(pbuf_t, payload, rx->addr));
 
-        pbuf->length = rx->length;
-
-        // 将数据包加入缓冲队列
-        netif_input(e1000->netif, pbuf);
+        // 先获取替换的缓冲，内核内存不足时丢弃数据包，原缓冲继续用于接收
+        pbuf_t *next = pbuf_get();
+        if (next)
+        {
+            pbuf->length = rx->length;
 
-        pbuf = pbuf_get();
+            // 将数据包加入缓冲队列
+            netif_input(e1000->netif, pbuf);
 
-        e1000->rx_pbuf[e1000->rx_cur] = pbuf;
-        rx->addr = get_paddr((u32)pbuf->payload);
+            e1000->rx_pbuf[e1000->rx_cur] = next;
+            rx->addr = get_paddr((u32)next->payload);
+        }
         rx->status = 0;
 
         moutl(e1000->membase + E1000_RDT, e1000->rx_cur);
@@ -288,12 +298,11 @@ static void send_packet(netif_t *netif, pbuf_t *pbuf)
 {
     e1000_t *e1000 = netif->nic;
     tx_desc_t *tx = &e1000->tx_desc[e1000->tx_cur];
-    while (tx->status == 0)
-    {
-        assert(e1000->tx_waiter == NULL);
-        e1000->tx_waiter = running_task();
-        assert(task_block(e1000->tx_waiter, NULL, TASK_BLOCKED, TIMELESS) == EOK);
-    }
+
+    // 等待描述符发送完毕
+    int ret;
+    wait_event(ret, &e1000->tx_wait, tx->status != 0, TASK_BLOCKED, TIMELESS);
+    assert(ret == EOK);
 
     assert(pbuf->count <= 2);
 
@@ -341,22 +350,18 @@ static void free_packet(e1000_t *e1000)
         pbuf_put(pbuf);
     }
 
-    if (e1000->tx_waiter)
-    {
-        task_unblock(e1000->tx_waiter, EOK);
-        e1000->tx_waiter = NULL;
-    }
+    wake_up_all(&e1000->tx_wait, EOK);
 }
 
-// 中断处理函数
-static void e1000_handler(int vector)
+// 中断下半部，处理中断处理函数记录的状态
+static void e1000_tasklet(tasklet_t *tasklet)
 {
-    assert(vector == IRQ_NIC + 0x20);
+    e1000_t *e1000 = tasklet->arg;
 
-    e1000_t *e1000 = &obj;
-
-    u32 status = minl(e1000->membase + E1000_ICR);
-    // LOGK("e1000 interrupt fired status %X\n", status);
+    bool intr = interrupt_disable();
+    u32 status = e1000->status;
+    e1000->status = 0;
+    set_interrupt_state(intr);
 
     // 传输描述符写回，表示有一个数据包发送完毕
     if ((status & IM_TXDW))
@@ -395,6 +400,20 @@ static void e1000_handler(int vector)
     {
         recv_packet(e1000);
     }
+}
+
+// 中断处理函数，读取中断状态应答网卡，其他工作在下半部完成
+static void e1000_handler(int vector)
+{
+    assert(vector == IRQ_NIC + 0x20 || vector == INTR_MSI_NIC);
+
+    e1000_t *e1000 = &obj;
+
+    u32 status = minl(e1000->membase + E1000_ICR);
+    // LOGK("e1000 interrupt fired status %X\n", status);
+
+    e1000->status |= status;
+    tasklet_schedule(&e1000->tasklet);
 
     // 去掉已知中断状态，其他的如果发生再说；
     status &= ~IM_TXDW & ~IM_TXQE & ~IM_LSC & ~IM_RXO;
@@ -488,6 +507,7 @@ static void e1000_reset(e1000_t *e1000)
 
     // 接收初始化
     e1000->rx_desc = (rx_desc_t *)alloc_kpage(1); // TODO: free
+    assert(e1000->rx_desc);
     memset(e1000->rx_desc, 0, PAGE_SIZE);
     e1000->rx_cur = 0;
 
@@ -505,6 +525,7 @@ static void e1000_reset(e1000_t *e1000)
     for (size_t i = 0; i < RX_DESC_NR; i++)
     {
         pbuf_t *pbuf = pbuf_get();
+        assert(pbuf);
         e1000->rx_pbuf[i] = pbuf;
         e1000->rx_desc[i].addr = get_paddr((u32)pbuf->payload);
         e1000->rx_desc[i].status = 0;
@@ -520,6 +541,7 @@ static void e1000_reset(e1000_t *e1000)
 
     // 传输初始化
     e1000->tx_desc = (tx_desc_t *)alloc_kpage(1); // TODO:free
+    assert(e1000->tx_desc);
     memset(e1000->tx_desc, 0, PAGE_SIZE);
     e1000->tx_cur = 0;
 
@@ -579,7 +601,9 @@ void e1000_init()
     }
 
     e1000_t *e1000 = &obj;
-    e1000->tx_waiter = NULL;
+    wait_queue_init(&e1000->tx_wait);
+    e1000->status = 0;
+    tasklet_init(&e1000->tasklet, e1000_tasklet, e1000);
 
     strcpy(e1000->name, "e1000");
 
@@ -600,12 +624,22 @@ void e1000_init()
 
     // 映射物理内存区域
     e1000->membase = membar.iobase;
-    map_area(membar.iobase, membar.size);
+    ret = map_area(membar.iobase, membar.size);
+    assert(ret == EOK);
 
     e1000_reset(e1000);
 
     e1000->netif = netif_setup(e1000, e1000->mac, send_packet);
 
+    // 优先使用 MSI，中断直接发送到启动处理器的本地 APIC，不需要共享中断线
+    if (lapic_enabled() &&
+        pci_enable_msi(device, MSI_ADDRESS(cpus[0].apic_id), INTR_MSI_NIC) == EOK)
+    {
+        LOGK("e1000 msi vector 0x%X...\n", INTR_MSI_NIC);
+        set_apic_handler(INTR_MSI_NIC, e1000_handler);
+        return;
+    }
+
     u32 intr = pci_interrupt(device);
 
     LOGK("e1000 irq 0x%X...\n", intr);
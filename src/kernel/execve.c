@@ -223,7 +223,7 @@ static bool elf_validate(Elf32_Ehdr *ehdr)
     return true;
 }
 
-static void load_segment(inode_t *inode, Elf32_Phdr *phdr)
+static err_t load_segment(inode_t *inode, Elf32_Phdr *phdr)
 {
     assert(phdr->p_align == 0x1000);      // 对齐到页
     assert((phdr->p_vaddr & 0xfff) == 0); // 对齐到页
@@ -237,7 +237,8 @@ static void load_segment(inode_t *inode, Elf32_Phdr *phdr)
     {
         u32 addr = vaddr + i * PAGE_SIZE;
         assert(addr >= USER_EXEC_ADDR && addr < USER_MMAP_ADDR);
-        link_page(addr);
+        if (link_page(addr) < EOK)
+            return -ENOMEM;
     }
 
     inode->op->read(inode, (char *)vaddr, phdr->p_filesz, phdr->p_offset);
@@ -270,11 +271,13 @@ static void load_segment(inode_t *inode, Elf32_Phdr *phdr)
     }
 
     task->end = MAX(task->end, (vaddr + count * PAGE_SIZE));
+    return EOK;
 }
 
 static u32 load_elf(inode_t *inode)
 {
-    link_page(USER_EXEC_ADDR);
+    if (link_page(USER_EXEC_ADDR) < EOK)
+        return EOF;
 
     int n = 0;
     // 读取 ELF 文件头
@@ -294,7 +297,8 @@ static u32 load_elf(inode_t *inode)
     {
         if (ptr->p_type != PT_LOAD)
             continue;
-        load_segment(inode, ptr);
+        if (load_segment(inode, ptr) < EOK)
+            return EOF;
         ptr++;
     }
 
@@ -318,8 +322,10 @@ static u32 copy_argv_envp(char *filename, char *argv[], char *envp[])
     int argc = count_argv(argv) + 1;
     int envc = count_argv(envp);
 
-    // 分配内核内存，用于临时存储参数
+    // 分配内核内存，用于临时存储参数，内存不足返回 0
     u32 pages = alloc_kpage(4);
+    if (!pages)
+        return 0;
     u32 pages_end = pages + 4 * PAGE_SIZE;
 
     // 内核临时栈顶地址
@@ -329,6 +335,11 @@ static u32 copy_argv_envp(char *filename, char *argv[], char *envp[])
 
     // 内核参数
     char **argvk = (char **)alloc_kpage(1);
+    if (!argvk)
+    {
+        free_kpage(pages, 4);
+        return 0;
+    }
     // 以 NULL 结尾
     argvk[argc] = NULL;
 
@@ -423,11 +434,22 @@ int sys_execve(char *filename, char *argv[], char *envp[])
         goto rollback;
     }
 
+    // 处理参数和环境变量
+    u32 top = copy_argv_envp(filename, argv, envp);
+    if (!top)
+    {
+        ret = -ENOMEM;
+        goto rollback;
+    }
+
     task_t *task = running_task();
     strncpy(task->name, filename, TASK_NAME_LEN);
 
-    // 处理参数和环境变量
-    u32 top = copy_argv_envp(filename, argv, envp);
+    // 参数已经拷贝到用户栈，spawn 参数不再需要
+    task_spawn_release(task);
+
+    // 解除原程序的文件映射
+    mmap_exit();
 
     // 首先释放原程序的堆内存
     task->end = USER_EXEC_ADDR;
@@ -14,6 +14,7 @@
 #include <onix/device.h>
 #include <onix/isa.h>
 #include <onix/timer.h>
+#include <onix/softirq.h>
 
 #define LOGK(fmt, args...) DEBUGK(fmt, ##args)
 
@@ -93,9 +94,10 @@ typedef struct fdresult_t
 
 typedef struct floppy_t
 {
-    task_t *waiter; // 等待进程
-    timer_t *timer; // 定时器
-    lock_t lock;    // 锁
+    task_t *waiter;    // 等待进程
+    tasklet_t tasklet; // 中断下半部
+    timer_t *timer;    // 定时器
+    lock_t lock;       // 锁
 
     char name[8];
     int type; // 软盘类型
@@ -130,14 +132,10 @@ typedef struct floppy_t
 // 为简单起见，系统暂时只支持一个 1.44M 软盘
 static floppy_t floppy;
 
-// 软盘中断
-static void fd_handler(int vector)
+// 软盘中断下半部，唤醒等待的进程
+static void fd_tasklet(tasklet_t *tasklet)
 {
-    send_eoi(vector); // 发送中断结束信号；
-    LOGK("floppy handler ....\n");
-
-    floppy_t *fd = &floppy;
-
+    floppy_t *fd = tasklet->arg;
     if (fd->waiter)
     {
         task_unblock(fd->waiter, EOK);
@@ -145,6 +143,15 @@ static void fd_handler(int vector)
     }
 }
 
+// 软盘中断
+static void fd_handler(int vector)
+{
+    send_eoi(vector); // 发送中断结束信号；
+    LOGK("floppy handler ....\n");
+
+    tasklet_hi_schedule(&floppy.tasklet);
+}
+
 // 获得软盘驱动器类型
 static u8 fd_type()
 {
@@ -497,6 +504,7 @@ void floppy_init()
     lock_init(&fd->lock);
 
     fd->waiter = NULL;
+    tasklet_init(&fd->tasklet, fd_tasklet, fd);
 
     fd->dor = (DOR_IRQ | DOR_NORMAL);
 
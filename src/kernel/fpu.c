@@ -5,11 +5,10 @@
 #include <onix/arena.h>
 #include <onix/debug.h>
 #include <onix/assert.h>
+#include <onix/smp.h>
 
 #define LOGK(fmt, args...) DEBUGK(fmt, ##args)
 
-task_t *last_fpu_task = NULL;
-
 // 检查机器是否支持 FPU
 bool fpu_check()
 {
@@ -47,25 +46,34 @@ void set_cr0(u32 cr0)
     asm volatile("movl %%eax, %%cr0\n" ::"a"(cr0));
 }
 
+// 保存处理器上的浮点环境到所属的任务，需要 FPU 可用
+static void fpu_save(cpu_t *cpu)
+{
+    task_t *task = cpu->fpu_task;
+    if (task && task->flags & TASK_FPU_ENABLED)
+    {
+        assert(task->fpu);
+        asm volatile("fnsave (%%eax) \n" ::"a"(task->fpu));
+        task->flags &= ~TASK_FPU_ENABLED;
+    }
+    cpu->fpu_task = NULL;
+}
+
 // 激活 fpu
 void fpu_enable(task_t *task)
 {
     // LOGK("fpu enable...\n");
+    cpu_t *cpu = cpu_current();
 
     set_cr0(get_cr0() & ~(CR0_EM | CR0_TS));
     // 如果使用的任务没有变化，则无需恢复浮点环境
-    if (last_fpu_task == task)
+    if (cpu->fpu_task == task)
         return;
 
     // 如果存在使用过浮点处理单元的进程，则保存浮点环境
-    if (last_fpu_task && last_fpu_task->flags & TASK_FPU_ENABLED)
-    {
-        assert(last_fpu_task->fpu);
-        asm volatile("fnsave (%%eax) \n" ::"a"(last_fpu_task->fpu));
-        last_fpu_task->flags &= ~TASK_FPU_ENABLED;
-    }
+    fpu_save(cpu);
 
-    last_fpu_task = task;
+    cpu->fpu_task = task;
 
     // 如果 fpu 不为空，则恢复浮点环境
     if (task->fpu)
@@ -88,6 +96,11 @@ void fpu_enable(task_t *task)
 // 禁用 fpu
 void fpu_disable(task_t *task)
 {
+    // 多处理器时任务可能在其他处理器上继续执行，切换时马上保存浮点环境
+    cpu_t *cpu = cpu_current();
+    if (cpu_count > 1 && cpu->fpu_task == task)
+        fpu_save(cpu);
+
     set_cr0(get_cr0() | (CR0_EM | CR0_TS));
 }
 
@@ -107,7 +120,7 @@ void fpu_init()
     LOGK("fpu init...\n");
 
     bool exist = fpu_check();
-    last_fpu_task = NULL;
+    cpu_current()->fpu_task = NULL;
     assert(exist);
 
     if (exist)
@@ -51,6 +51,8 @@ extern int sys_link();
 extern int sys_unlink();
 
 extern time_t sys_time();
+extern int sys_clock_gettime();
+extern int sys_nanosleep();
 extern mode_t sys_umask();
 
 extern int sys_stat();
@@ -61,9 +63,18 @@ extern int sys_mknod();
 extern int sys_mount();
 extern int sys_umount();
 
+extern int sys_swapon();
+
 extern int sys_brk();
 extern int sys_mmap();
 extern int sys_munmap();
+extern int sys_msync();
+extern int sys_mprotect();
+
+extern int sys_shmget();
+extern int sys_shmctl();
+extern int sys_shmat();
+extern int sys_shmdt();
 
 extern int sys_setpgid();
 extern int sys_setsid();
@@ -102,6 +113,8 @@ extern int sys_sendmsg();
 
 extern int sys_resolv();
 
+extern int task_spawn();
+
 extern int sys_uname();
 
 void syscall_init()
@@ -121,6 +134,7 @@ void syscall_init()
     syscall_table[SYS_NR_EXECVE] = sys_execve;
 
     syscall_table[SYS_NR_SLEEP] = task_sleep;
+    syscall_table[SYS_NR_NANOSLEEP] = sys_nanosleep;
     syscall_table[SYS_NR_YIELD] = task_yield;
 
     syscall_table[SYS_NR_GETPID] = sys_getpid;
@@ -136,6 +150,13 @@ void syscall_init()
     syscall_table[SYS_NR_BRK] = sys_brk;
     syscall_table[SYS_NR_MMAP] = sys_mmap;
     syscall_table[SYS_NR_MUNMAP] = sys_munmap;
+    syscall_table[SYS_NR_MSYNC] = sys_msync;
+    syscall_table[SYS_NR_MPROTECT] = sys_mprotect;
+
+    syscall_table[SYS_NR_SHMGET] = sys_shmget;
+    syscall_table[SYS_NR_SHMCTL] = sys_shmctl;
+    syscall_table[SYS_NR_SHMAT] = sys_shmat;
+    syscall_table[SYS_NR_SHMDT] = sys_shmdt;
 
     syscall_table[SYS_NR_DUP] = sys_dup;
     syscall_table[SYS_NR_DUP2] = sys_dup2;
@@ -158,6 +179,7 @@ void syscall_init()
     syscall_table[SYS_NR_UNLINK] = sys_unlink;
 
     syscall_table[SYS_NR_TIME] = sys_time;
+    syscall_table[SYS_NR_CLOCK_GETTIME] = sys_clock_gettime;
 
     syscall_table[SYS_NR_UMASK] = sys_umask;
 
@@ -173,6 +195,8 @@ void syscall_init()
     syscall_table[SYS_NR_MOUNT] = sys_mount;
     syscall_table[SYS_NR_UMOUNT] = sys_umount;
 
+    syscall_table[SYS_NR_SWAPON] = sys_swapon;
+
     syscall_table[SYS_NR_MKFS] = sys_mkfs;
 
     syscall_table[SYS_NR_SIGNAL] = sys_signal;
@@ -198,5 +222,7 @@ void syscall_init()
 
     syscall_table[SYS_NR_RESOLV] = sys_resolv;
 
+    syscall_table[SYS_NR_SPAWN] = task_spawn;
+
     syscall_table[SYS_NR_UNAME] = sys_uname;
 }
@@ -1,10 +1,10 @@
 #include <onix/global.h>
 #include <onix/string.h>
 #include <onix/debug.h>
+#include <onix/smp.h>
 
 descriptor_t gdt[GDT_SIZE]; // 内核全局描述符表
 pointer_t gdt_ptr;          // 内核全局描述符表指针
-tss_t tss;                  // 任务状态段
 
 void descriptor_init(descriptor_t *desc, u32 base, u32 limit)
 {
@@ -66,15 +66,18 @@ void gdt_init()
     gdt_ptr.limit = sizeof(gdt) - 1;
 }
 
-void tss_init()
+// 每个处理器有自己的任务状态段，启动处理器使用 KERNEL_TSS_IDX
+void tss_init(cpu_t *cpu)
 {
-    memset(&tss, 0, sizeof(tss));
+    tss_t *tss = &cpu->tss;
+    memset(tss, 0, sizeof(tss_t));
 
-    tss.ss0 = KERNEL_DATA_SELECTOR;
-    tss.iobase = sizeof(tss);
+    tss->ss0 = KERNEL_DATA_SELECTOR;
+    tss->iobase = sizeof(tss_t);
 
-    descriptor_t *desc = gdt + KERNEL_TSS_IDX;
-    descriptor_init(desc, (u32)&tss, sizeof(tss) - 1);
+    u32 idx = cpu->id ? CPU_TSS_IDX + cpu->id - 1 : KERNEL_TSS_IDX;
+    descriptor_t *desc = gdt + idx;
+    descriptor_init(desc, (u32)tss, sizeof(tss_t) - 1);
     desc->segment = 0;     // 系统段
     desc->granularity = 0; // 字节
     desc->big = 0;         // 固定为 0
@@ -85,5 +88,5 @@ void tss_init()
 
     // BMB;
     asm volatile(
-        "ltr %%ax\n" ::"a"(KERNEL_TSS_SELECTOR));
+        "ltr %%ax\n" ::"a"(idx << 3));
 }
@@ -3,6 +3,9 @@
 
 extern handler_table
 extern task_signal
+extern softirq_run
+extern kernel_lock
+extern kernel_unlock
 
 section .text
 
@@ -25,6 +28,9 @@ interrupt_entry:
     push gs
     pusha
 
+    ; 进入内核，获取大内核锁
+    call kernel_lock
+
     ; 找到前面 push %1 压入的 中断向量
     mov eax, [esp + 12 * 4]
 
@@ -40,9 +46,21 @@ interrupt_exit:
     ; 对应 push eax，调用结束恢复栈
     add esp, 4
 
+    ; 被中断的代码打开了中断时执行软中断，栈中 eflags 的 IF 位为 1
+    test dword [esp + 16 * 4], 0x200
+    jz .signal
+    call softirq_run
+
+.signal:
     ; 调用信号处理函数
     call task_signal
 
+    ; 返回用户态时释放大内核锁，栈中 cs 的特权级不为 0
+    test dword [esp + 15 * 4], 0b11
+    jz .restore
+    call kernel_unlock
+
+.restore:
     ; 恢复下文寄存器信息
     popa
     pop gs
@@ -112,6 +130,23 @@ INTERRUPT_HANDLER 0x2d, 0
 INTERRUPT_HANDLER 0x2e, 0; harddisk1 硬盘主通道
 INTERRUPT_HANDLER 0x2f, 0; harddisk2 硬盘从通道
 
+INTERRUPT_HANDLER 0x30, 0; 本地 APIC 定时器
+INTERRUPT_HANDLER 0x31, 0; 重新调度处理器间中断
+INTERRUPT_HANDLER 0x32, 0
+INTERRUPT_HANDLER 0x33, 0
+INTERRUPT_HANDLER 0x34, 0
+INTERRUPT_HANDLER 0x35, 0
+INTERRUPT_HANDLER 0x36, 0
+INTERRUPT_HANDLER 0x37, 0
+INTERRUPT_HANDLER 0x38, 0
+INTERRUPT_HANDLER 0x39, 0
+INTERRUPT_HANDLER 0x3a, 0
+INTERRUPT_HANDLER 0x3b, 0
+INTERRUPT_HANDLER 0x3c, 0
+INTERRUPT_HANDLER 0x3d, 0
+INTERRUPT_HANDLER 0x3e, 0
+INTERRUPT_HANDLER 0x3f, 0; 本地 APIC 伪中断
+
 ; 下面的数组记录了每个中断入口函数的指针
 section .data
 global handler_entry_table
@@ -164,6 +199,22 @@ handler_entry_table:
     dd interrupt_handler_0x2d
     dd interrupt_handler_0x2e
     dd interrupt_handler_0x2f
+    dd interrupt_handler_0x30
+    dd interrupt_handler_0x31
+    dd interrupt_handler_0x32
+    dd interrupt_handler_0x33
+    dd interrupt_handler_0x34
+    dd interrupt_handler_0x35
+    dd interrupt_handler_0x36
+    dd interrupt_handler_0x37
+    dd interrupt_handler_0x38
+    dd interrupt_handler_0x39
+    dd interrupt_handler_0x3a
+    dd interrupt_handler_0x3b
+    dd interrupt_handler_0x3c
+    dd interrupt_handler_0x3d
+    dd interrupt_handler_0x3e
+    dd interrupt_handler_0x3f
 
 section .text
 
@@ -189,6 +240,12 @@ syscall_handler:
     push gs
     pusha
 
+    ; 进入内核，获取大内核锁，调用会修改 eax ecx edx，从栈中恢复参数
+    call kernel_lock
+    mov eax, [esp + 7 * 4]
+    mov ecx, [esp + 6 * 4]
+    mov edx, [esp + 5 * 4]
+
     push 0x80; 向中断处理函数传递参数中断向量 vector
     ; xchg bx, bx
 
@@ -166,6 +166,18 @@ ide_ctrl_t controllers[IDE_CTRL_NR];
 
 static int ide_reset_controller(ide_ctrl_t *ctrl);
 
+// 硬盘中断下半部
+static void ide_tasklet(tasklet_t *tasklet)
+{
+    ide_ctrl_t *ctrl = tasklet->arg;
+    if (ctrl->waiter)
+    {
+        // 如果有进程阻塞，则取消阻塞
+        task_unblock(ctrl->waiter, EOK);
+        ctrl->waiter = NULL;
+    }
+}
+
 // 硬盘中断处理函数
 static void ide_handler(int vector)
 {
@@ -177,12 +189,7 @@ static void ide_handler(int vector)
     // 读取常规状态寄存器，表示中断处理结束
     u8 state = inb(ctrl->iobase + IDE_STATUS);
     LOGK("harddisk interrupt vector %d state 0x%x\n", vector, state);
-    if (ctrl->waiter)
-    {
-        // 如果有进程阻塞，则取消阻塞
-        task_unblock(ctrl->waiter, EOK);
-        ctrl->waiter = NULL;
-    }
+    tasklet_hi_schedule(&ctrl->tasklet);
 }
 
 static void ide_error(ide_ctrl_t *ctrl)
@@ -912,6 +919,7 @@ static void ide_ctrl_init()
     }
 
     u16 *buf = (u16 *)alloc_kpage(1);
+    assert(buf);
     for (size_t cidx = 0; cidx < IDE_CTRL_NR; cidx++)
     {
         ide_ctrl_t *ctrl = &controllers[cidx];
@@ -919,6 +927,7 @@ static void ide_ctrl_init()
         lock_init(&ctrl->lock);
         ctrl->active = NULL;
         ctrl->waiter = NULL;
+        tasklet_init(&ctrl->tasklet, ide_tasklet, ctrl);
         ctrl->iotype = iotype;
         ctrl->bmbase = bmbase + cidx * 8;
 
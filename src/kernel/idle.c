@@ -1,6 +1,9 @@
 #include <onix/interrupt.h>
 #include <onix/syscall.h>
 #include <onix/debug.h>
+#include <onix/memory.h>
+#include <onix/clock.h>
+#include <onix/smp.h>
 
 // #include <asm/unistd_32.h>
 
@@ -14,10 +17,29 @@ void idle_thread()
     {
         // LOGK("idle task.... %d\n", counter++);
         // BMB;
+
+        // 空闲时预先清零物理页，每清零一页就让出执行权
+        if (zero_pool_fill())
+        {
+            yield();
+            continue;
+        }
+
+        // 停止周期时钟，直到下一个定时器超时或者外中断到来
+        // 只有启动处理器接收时钟中断
+        interrupt_disable();
+        bool bsp = cpu_current()->id == 0;
+        if (bsp)
+            clock_idle_enter();
+
+        // 暂停期间释放大内核锁，中断到来时重新获取
+        kernel_unlock();
         asm volatile(
             "sti\n" // 开中断
             "hlt\n" // 关闭 CPU，进入暂停状态，等待外中断的到来
         );
+        if (bsp)
+            clock_idle_exit();
         yield(); // 放弃执行权，调度执行其他任务
     }
 }
@@ -1,4 +1,5 @@
 #include <onix/interrupt.h>
+#include <onix/apic.h>
 #include <onix/global.h>
 #include <onix/debug.h>
 #include <onix/printk.h>
@@ -9,7 +10,7 @@
 #define LOGK(fmt, args...) DEBUGK(fmt, ##args)
 // #define LOGK(fmt, args...)
 
-#define ENTRY_SIZE 0x30
+#define ENTRY_SIZE 0x40
 
 #define PIC_M_CTRL 0x20 // 主片的控制端口
 #define PIC_M_DATA 0x21 // 主片的数据端口
@@ -17,10 +18,15 @@
 #define PIC_S_DATA 0xa1 // 从片的数据端口
 #define PIC_EOI 0x20    // 通知中断控制器中断结束
 
+#define IMCR_ADDR 0x22 // 中断模式控制寄存器选择端口
+#define IMCR_DATA 0x23 // 中断模式控制寄存器数据端口
+
 gate_t idt[IDT_SIZE];
 pointer_t idt_ptr;
 
 handler_t handler_table[IDT_SIZE];
+
+static bool ioapic_mode; // 外部中断由 IOAPIC 传递
 extern handler_t handler_entry_table[ENTRY_SIZE];
 extern void syscall_handler();
 extern void page_fault();
@@ -51,8 +57,14 @@ static char *messages[] = {
 };
 
 // 通知中断控制器，中断处理结束
+// 本地 APIC 只需要写一次寄存器，8259 需要一到两次端口输出
 void send_eoi(int vector)
 {
+    if (vector >= INTR_APIC_TIMER || (ioapic_mode && vector >= IRQ_MASTER_NR))
+    {
+        lapic_eoi();
+        return;
+    }
     if (vector >= 0x20 && vector < 0x28)
     {
         outb(PIC_M_CTRL, PIC_EOI);
@@ -78,9 +90,23 @@ void set_interrupt_handler(u32 irq, handler_t handler)
     handler_table[IRQ_MASTER_NR + irq] = handler;
 }
 
+void set_apic_handler(u32 vector, handler_t handler)
+{
+    assert(vector >= INTR_APIC_TIMER && vector < ENTRY_SIZE);
+    handler_table[vector] = handler;
+}
+
 void set_interrupt_mask(u32 irq, bool enable)
 {
     assert(irq >= 0 && irq < 16);
+    if (ioapic_mode)
+    {
+        // IOAPIC 没有级联，2 号引脚一般连接时钟
+        if (irq != IRQ_CASCADE)
+            ioapic_mask(irq, enable);
+        return;
+    }
+
     u16 port;
     if (irq < 8)
     {
@@ -192,6 +218,23 @@ void pic_init()
     outb(PIC_S_DATA, 0b11111111); // 关闭所有中断
 }
 
+// 外部中断改由 IOAPIC 传递，需要在打开任何中断之前调用
+// imcr 表示主板有中断模式控制寄存器，需要切换才能让中断到达 IOAPIC
+void ioapic_enable(bool imcr)
+{
+    assert(!get_interrupt_state());
+
+    outb(PIC_M_DATA, 0b11111111); // 关闭所有中断
+    outb(PIC_S_DATA, 0b11111111); // 关闭所有中断
+
+    if (imcr)
+    {
+        outb(IMCR_ADDR, 0x70);
+        outb(IMCR_DATA, 0x01);
+    }
+    ioapic_mode = true;
+}
+
 // 初始化中断描述符，和中断处理函数数组
 void idt_init()
 {
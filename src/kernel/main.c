@@ -1,15 +1,19 @@
 #include <onix/interrupt.h>
 
-extern void tss_init();
+extern void cpu_setup();
 extern void memory_map_init();
 extern void mapping_init();
+extern void buddy_init();
 extern void arena_init();
 
 extern void interrupt_init();
+extern void mp_init();
 extern void clock_init();
 extern void timer_init();
 extern void syscall_init();
 extern void task_init();
+extern void smp_init();
+extern void softirq_init();
 extern void fpu_init();
 extern void pci_init();
 
@@ -31,12 +35,14 @@ extern void raw_init();
 
 void kernel_init()
 {
-    tss_init();        // 初始化任务状态段
+    cpu_setup();       // 初始化启动处理器和任务状态段
     memory_map_init(); // 初始化物理内存数组
     mapping_init();    // 初始化内存映射
+    buddy_init();      // 初始化物理页伙伴系统
     arena_init();      // 初始化内核堆内存
 
     interrupt_init(); // 初始化中断
+    mp_init();        // 初始化 APIC 中断控制器
     timer_init();     // 初始化定时器
     clock_init();     // 初始化时钟
     fpu_init();       // 初始化 FPU 浮点运算单元
@@ -44,6 +50,8 @@ void kernel_init()
 
     syscall_init(); // 初始化系统调用
     task_init();    // 初始化任务
+    smp_init();     // 启动其他处理器
+    softirq_init(); // 初始化软中断
 
     pbuf_init();   // 初始化 pbuf
     netif_init();  // 初始化 netif
@@ -5,11 +5,17 @@
 #include <onix/stdlib.h>
 #include <onix/string.h>
 #include <onix/bitmap.h>
+#include <onix/list.h>
 #include <onix/multiboot2.h>
 #include <onix/task.h>
 #include <onix/syscall.h>
 #include <onix/fs.h>
 #include <onix/printk.h>
+#include <onix/arena.h>
+#include <onix/cpu.h>
+#include <onix/interrupt.h>
+#include <onix/swap.h>
+#include <onix/shm.h>
 
 #define LOGK(fmt, args...) DEBUGK(fmt, ##args)
 // #define LOGK(fmt, args...)
@@ -136,19 +142,32 @@ static u32 start_page = 0;   // 可分配物理内存起始位置
 static u8 *memory_map;       // 物理内存数组
 static u32 memory_map_pages; // 物理内存数组占用的页数
 
+#define BUDDY_ORDER_NR 11 // 伙伴系统阶数，最大的块为 2^10 页，即 4M
+#define BUDDY_NONE 0xff   // 该页不是空闲块的首页
+
+static list_t free_area[BUDDY_ORDER_NR]; // 每一阶的空闲块链表
+static u8 *page_order;                   // 空闲块首页记录块的阶
+static list_node_t *page_nodes;          // 每一页对应的链表结点
+
 void memory_map_init()
 {
     // 初始化物理内存数组
     memory_map = (u8 *)memory_base;
 
+    // 伙伴系统的阶数组和链表结点数组紧随物理内存数组之后
+    page_order = memory_map + total_pages;
+    page_nodes = (list_node_t *)(((u32)page_order + total_pages + 3) & ~3);
+
     // 计算物理内存数组占用的页数
-    memory_map_pages = div_round_up(total_pages, PAGE_SIZE);
+    u32 size = (u32)(page_nodes + total_pages) - (u32)memory_map;
+    memory_map_pages = div_round_up(size, PAGE_SIZE);
     LOGK("Memory map page count %d\n", memory_map_pages);
 
     free_pages -= memory_map_pages;
 
     // 清空物理内存数组
     memset((void *)memory_map, 0, memory_map_pages * PAGE_SIZE);
+    memset((void *)page_order, BUDDY_NONE, total_pages);
 
     // 前 1M 的内存位置 以及 物理内存数组已占用的页，已被占用
     start_page = IDX(MEMORY_BASE) + memory_map_pages;
@@ -165,23 +184,146 @@ void memory_map_init()
     bitmap_scan(&kernel_map, memory_map_pages);
 }
 
-// 分配一页物理内存
+// 将 idx 开始的 2^order 页放回伙伴系统，并尽可能与伙伴合并
+static void buddy_free(u32 idx, u32 order)
+{
+    assert(page_order[idx] == BUDDY_NONE);
+
+    while (order < BUDDY_ORDER_NR - 1)
+    {
+        u32 buddy = idx ^ (1 << order);
+
+        // 伙伴不存在，或者伙伴不是同阶的空闲块，则不能合并
+        if (buddy >= total_pages || page_order[buddy] != order)
+            break;
+
+        list_remove(&page_nodes[buddy]);
+        page_order[buddy] = BUDDY_NONE;
+
+        idx &= ~(1 << order);
+        order++;
+    }
+
+    page_order[idx] = order;
+    // 直接插入链表头，避免 list_push 的查重遍历
+    list_insert_after(&free_area[order].head, &page_nodes[idx]);
+}
+
+// 从伙伴系统中分配 2^order 个连续页，返回首页索引
+static int32 buddy_alloc(u32 order)
+{
+    assert(order < BUDDY_ORDER_NR);
+
+    u32 current = order;
+    while (current < BUDDY_ORDER_NR && list_empty(&free_area[current]))
+    {
+        current++;
+    }
+
+    if (current == BUDDY_ORDER_NR)
+        return EOF;
+
+    list_node_t *node = list_pop(&free_area[current]);
+    u32 idx = node - page_nodes;
+    assert(page_order[idx] == current);
+    page_order[idx] = BUDDY_NONE;
+
+    // 将多余的部分拆分成伙伴，放回低阶链表
+    while (current > order)
+    {
+        current--;
+        u32 buddy = idx + (1 << current);
+        page_order[buddy] = current;
+        list_insert_after(&free_area[current].head, &page_nodes[buddy]);
+    }
+    return idx;
+}
+
+// 得到 count 页所需的阶
+static u32 buddy_order(u32 count)
+{
+    u32 order = 0;
+    while ((1 << order) < count)
+    {
+        order++;
+    }
+    return order;
+}
+
+#define ZERO_POOL_SIZE 64 // 预先清零的物理页数量
+
+static u32 zero_pool[ZERO_POOL_SIZE]; // 预先清零的物理页索引，引用为 0，不在伙伴系统中
+static u32 zero_count = 0;            // 池中页数
+static u32 zero_hits = 0;             // 从池中取到页的次数
+static u32 zero_misses = 0;           // 池为空，同步清零的次数
+
+static u32 zero_pool_shrink(u32 count);
+
+static lock_t swap_lock;
+static u32 swap_shrink(u32 count);
+
+#define SHRINKER_NR 8 // 内存回收函数数量
+
+static shrinker_t shrinkers[ZONE_NR][SHRINKER_NR];
+static u32 shrinker_count[ZONE_NR];
+static bool reclaiming = false;
+
+// 注册内存回收函数，只使用静态数组，可以在内存初始化之前调用
+void shrinker_register(zone_t zone, shrinker_t shrinker)
+{
+    assert(zone < ZONE_NR);
+    assert(shrinker_count[zone] < SHRINKER_NR);
+    shrinkers[zone][shrinker_count[zone]++] = shrinker;
+}
+
+u32 memory_reclaim(zone_t zone, u32 count)
+{
+    assert(zone < ZONE_NR);
+
+    // 内核区域的回收函数不会阻塞，回收中释放内存不应该再次触发回收
+    // 用户区域的回收函数可能等待磁盘，由回收函数自己加锁
+    if (zone == ZONE_KERNEL && reclaiming)
+        return 0;
+    if (zone == ZONE_KERNEL)
+        reclaiming = true;
+
+    u32 freed = 0;
+    for (size_t i = 0; i < shrinker_count[zone] && freed < count; i++)
+    {
+        freed += shrinkers[zone][i](count - freed);
+    }
+
+    if (zone == ZONE_KERNEL)
+        reclaiming = false;
+    LOGK("reclaim zone %d %d pages, freed %d pages\n", zone, count, freed);
+    return freed;
+}
+
+// 分配一页物理内存，内存不足时返回 0
 static u32 get_page()
 {
-    for (size_t i = start_page; i < total_pages; i++)
+    int32 idx = buddy_alloc(0);
+
+    // 回收用户内存，再试一次
+    if (idx == EOF && memory_reclaim(ZONE_USER, 1))
     {
-        // 如果物理内存没有占用
-        if (!memory_map[i])
-        {
-            memory_map[i] = 1;
-            assert(free_pages > 0);
-            free_pages--;
-            u32 page = PAGE(i);
-            LOGK("GET page 0x%p\n", page);
-            return page;
-        }
+        idx = buddy_alloc(0);
+    }
+
+    if (idx == EOF)
+    {
+        LOGK("Out of Memory!!!\n");
+        return 0;
     }
-    panic("Out of Memory!!!");
+
+    assert(!memory_map[idx]);
+    memory_map[idx] = 1;
+    assert(free_pages > 0);
+    free_pages--;
+
+    u32 page = PAGE(idx);
+    LOGK("GET page 0x%p\n", page);
+    return page;
 }
 
 // 释放一页物理内存
@@ -200,16 +342,160 @@ static void put_page(u32 addr)
     // 物理引用减一
     memory_map[idx]--;
 
-    // 若为 0，则空闲页加一
+    // 若为 0，则空闲页加一，并放回伙伴系统
     if (!memory_map[idx])
     {
         free_pages++;
+        buddy_free(idx, 0);
     }
 
     assert(free_pages > 0 && free_pages < total_pages);
     LOGK("PUT page 0x%p\n", addr);
 }
 
+// 分配 count 个连续的物理页，用于 DMA 缓冲等，返回物理地址
+u32 alloc_frames(u32 count)
+{
+    assert(count > 0);
+    u32 order = buddy_order(count);
+
+    int32 idx = buddy_alloc(order);
+    if (idx == EOF && memory_reclaim(ZONE_USER, 1 << order))
+    {
+        idx = buddy_alloc(order);
+    }
+
+    if (idx == EOF)
+    {
+        LOGK("Out of Memory!!!\n");
+        return 0;
+    }
+
+    // 按块分配，块中所有页都标记为占用
+    for (size_t i = 0; i < (1 << order); i++)
+    {
+        assert(!memory_map[idx + i]);
+        memory_map[idx + i] = 1;
+    }
+
+    assert(free_pages >= (1 << order));
+    free_pages -= (1 << order);
+
+    u32 paddr = PAGE(idx);
+    LOGK("ALLOC frames 0x%p count %d\n", paddr, count);
+    return paddr;
+}
+
+// 释放 alloc_frames 分配的 count 个连续物理页
+void free_frames(u32 paddr, u32 count)
+{
+    ASSERT_PAGE(paddr);
+    assert(count > 0);
+
+    u32 order = buddy_order(count);
+    u32 idx = IDX(paddr);
+    assert((idx & ((1 << order) - 1)) == 0);
+    assert(idx >= start_page && idx + (1 << order) <= total_pages);
+
+    // 引用全部归零，才将整块放回伙伴系统，否则逐页释放
+    bool whole = true;
+    for (size_t i = 0; i < (1 << order); i++)
+    {
+        assert(memory_map[idx + i] >= 1);
+        if (memory_map[idx + i] != 1)
+            whole = false;
+    }
+
+    if (!whole)
+    {
+        for (size_t i = 0; i < (1 << order); i++)
+        {
+            put_page(PAGE(idx + i));
+        }
+        return;
+    }
+
+    for (size_t i = 0; i < (1 << order); i++)
+    {
+        memory_map[idx + i] = 0;
+    }
+    free_pages += (1 << order);
+    buddy_free(idx, order);
+    LOGK("FREE  frames 0x%p count %d\n", paddr, count);
+}
+
+#ifdef ONIX_DEBUG
+// 伙伴系统自检，分配不同大小的块，检查对齐和重叠，释放后空闲页数应当复原
+static void buddy_test()
+{
+    u32 pages[BUDDY_ORDER_NR];
+    u32 free = free_pages;
+
+    // 可用内存太少，不足以完成测试
+    if (free < (1 << BUDDY_ORDER_NR))
+        return;
+
+    u32 blocks = list_size(&free_area[BUDDY_ORDER_NR - 1]);
+
+    for (size_t i = 0; i < BUDDY_ORDER_NR - 1; i++)
+    {
+        u32 count = 1 << i;
+        pages[i] = alloc_frames(count);
+        assert((IDX(pages[i]) & (count - 1)) == 0);
+        for (size_t j = 0; j < i; j++)
+        {
+            u32 start = IDX(pages[j]);
+            u32 end = start + (1 << j);
+            assert(IDX(pages[i]) + count <= start || IDX(pages[i]) >= end);
+        }
+    }
+
+    u32 single = get_page();
+    assert(memory_map[IDX(single)] == 1);
+    put_page(single);
+
+    for (int i = BUDDY_ORDER_NR - 2; i >= 0; i--)
+    {
+        free_frames(pages[i], 1 << i);
+    }
+
+    assert(free_pages == free);
+    assert(list_size(&free_area[BUDDY_ORDER_NR - 1]) == blocks);
+    LOGK("Buddy self test passed\n");
+}
+#endif
+
+// 初始化伙伴系统，将所有空闲的物理页加入空闲链表
+void buddy_init()
+{
+    for (size_t i = 0; i < BUDDY_ORDER_NR; i++)
+    {
+        list_init(&free_area[i]);
+    }
+
+    for (size_t i = start_page; i < total_pages; i++)
+    {
+        if (!memory_map[i])
+            buddy_free(i, 0);
+    }
+
+    for (size_t i = 0; i < BUDDY_ORDER_NR; i++)
+    {
+        LOGK("Buddy order %d free blocks %d\n", i, list_size(&free_area[i]));
+    }
+
+#ifdef ONIX_DEBUG
+    buddy_test();
+#endif
+
+    // 先还回清零的页，再丢弃没有映射的页缓存，最后换出进程的页
+    shrinker_register(ZONE_USER, zero_pool_shrink);
+    shrinker_register(ZONE_USER, inode_page_shrink);
+
+    lock_init(&swap_lock);
+    shrinker_register(ZONE_USER, swap_shrink);
+}
+
 // 得到 cr2 寄存器
 u32 get_cr2()
 {
@@ -232,13 +518,14 @@ void set_cr3(u32 pde)
 }
 
 // 将 cr0 寄存器最高位 PG 置为 1，启用分页
+// 同时置位 WP，内核写只读的用户页也会缺页，read 等系统调用写入私有映射时同样写时拷贝
 static _inline void enable_page()
 {
-    // 0b1000_0000_0000_0000_0000_0000_0000_0000
-    // 0x80000000
+    // 0b1000_0000_0000_0001_0000_0000_0000_0000
+    // 0x80010000
     asm volatile(
         "movl %cr0, %eax\n"
-        "orl $0x80000000, %eax\n"
+        "orl $0x80010000, %eax\n"
         "movl %eax, %cr0\n");
 }
 
@@ -253,21 +540,44 @@ static void entry_init(page_entry_t *entry, u32 index)
 }
 
 // 初始化内存映射
+// 支持 PSE 时，除了第一个页表，内核内存使用 4M 大页映射
+// 支持 PGE 时，内核映射标记为全局，切换进程页目录时不会刷新内核的快表
 void mapping_init()
 {
     page_entry_t *pde = (page_entry_t *)KERNEL_PAGE_DIR;
     memset(pde, 0, PAGE_SIZE);
 
+    cpu_version_t ver;
+    cpu_version(&ver);
+
+    u32 cr4 = get_cr4();
+    if (ver.PSE)
+        cr4 |= CR4_PSE;
+    if (ver.PGE)
+        cr4 |= CR4_PGE;
+    set_cr4(cr4);
+
     idx_t index = 0;
 
     for (idx_t didx = 0; didx < (sizeof(KERNEL_PAGE_TABLE) / 4); didx++)
     {
         page_entry_t *pte = (page_entry_t *)KERNEL_PAGE_TABLE[didx];
-        memset(pte, 0, PAGE_SIZE);
-
         page_entry_t *dentry = &pde[didx];
-        entry_init(dentry, IDX((u32)pte));
-        dentry->user = USER_MEMORY; // 只能被内核访问
+
+        // 第一个页表中有不映射的第 0 页，还用于 copy_page 的临时映射，不能使用大页
+        if (didx && ver.PSE)
+        {
+            entry_init(dentry, index);
+            dentry->user = USER_MEMORY; // 只能被内核访问
+            dentry->pat = true;         // 4M 页
+            dentry->global = ver.PGE;
+        }
+        else
+        {
+            memset(pte, 0, PAGE_SIZE);
+            entry_init(dentry, IDX((u32)pte));
+            dentry->user = USER_MEMORY; // 只能被内核访问
+        }
 
         for (idx_t tidx = 0; tidx < 1024; tidx++, index++)
         {
@@ -275,9 +585,14 @@ void mapping_init()
             if (index == 0)
                 continue;
 
-            page_entry_t *tentry = &pte[tidx];
-            entry_init(tentry, index);
-            tentry->user = USER_MEMORY; // 只能被内核访问
+            if (!dentry->pat)
+            {
+                page_entry_t *tentry = &pte[tidx];
+                entry_init(tentry, index);
+                tentry->user = USER_MEMORY; // 只能被内核访问
+                tentry->global = ver.PGE;
+            }
+
             if (memory_map[index] == 0)
                 free_pages--;
             memory_map[index] = 1; // 设置物理内存数组，该页被占用
@@ -309,23 +624,28 @@ static page_entry_t *get_pte(u32 vaddr, bool create)
     page_entry_t *entry = &pde[idx];
 
     assert(create || (!create && entry->present));
+    assert(!entry->pat); // 4M 页没有页表
 
     page_entry_t *table = (page_entry_t *)(PDE_MASK | (idx << 12));
 
     if (!entry->present)
     {
         LOGK("Get and create page table entry for 0x%p\n", vaddr);
-        u32 page = get_page();
+        u32 page = get_zero_page();
+        if (!page)
+            return NULL;
         entry_init(entry, IDX(page));
-        memset(table, 0, PAGE_SIZE);
     }
 
     return table;
 }
 
+// 得到 vaddr 对应的页表项，创建页表时内存不足返回 NULL
 page_entry_t *get_entry(u32 vaddr, bool create)
 {
     page_entry_t *pte = get_pte(vaddr, create);
+    if (!pte)
+        return NULL;
     return &pte[TIDX(vaddr)];
 }
 
@@ -337,6 +657,10 @@ u32 get_paddr(u32 vaddr)
     if (!entry->present)
         return 0;
 
+    // 内核 4M 页
+    if (entry->pat)
+        return PAGE(entry->index) | (vaddr & 0x3fffff);
+
     entry = get_entry(vaddr, false);
     if (!entry->present)
         return 0;
@@ -351,7 +675,7 @@ void flush_tlb(u32 vaddr)
                  : "memory");
 }
 
-// 从位图中扫描 count 个连续的页
+// 从位图中扫描 count 个连续的页，失败返回 0
 static u32 scan_page(bitmap_t *map, u32 count)
 {
     assert(count > 0);
@@ -359,7 +683,8 @@ static u32 scan_page(bitmap_t *map, u32 count)
 
     if (index == EOF)
     {
-        panic("Scan page fail!!!");
+        LOGK("Scan page fail!!!\n");
+        return 0;
     }
 
     u32 addr = PAGE(index);
@@ -386,6 +711,19 @@ u32 alloc_kpage(u32 count)
 {
     assert(count > 0);
     u32 vaddr = scan_page(&kernel_map, count);
+
+    // 回收各个子系统缓存的内核页，再试一次
+    if (!vaddr && memory_reclaim(ZONE_KERNEL, count))
+    {
+        vaddr = scan_page(&kernel_map, count);
+    }
+
+    // 内核内存耗尽，由调用者处理
+    if (!vaddr)
+    {
+        LOGK("Out of kernel memory count %d\n", count);
+        return 0;
+    }
     LOGK("ALLOC kernel pages 0x%p count %d\n", vaddr, count);
     return vaddr;
 }
@@ -399,10 +737,9 @@ void free_kpage(u32 vaddr, u32 count)
     LOGK("FREE  kernel pages 0x%p count %d\n", vaddr, count);
 }
 
-// 拷贝一页，返回拷贝后的物理地址
-static u32 copy_page(void *page)
+// 将 page 的内容拷贝到物理页 paddr
+static void copy_to_page(u32 paddr, void *page)
 {
-    u32 paddr = get_page();
     u32 vaddr = 0;
 
     page_entry_t *entry = get_pte(vaddr, false);
@@ -413,27 +750,213 @@ static u32 copy_page(void *page)
 
     entry->present = false;
     flush_tlb(vaddr);
+}
+
+// 拷贝一页，返回拷贝后的物理地址，内存不足返回 0
+static u32 copy_page(void *page)
+{
+    u32 paddr = get_page();
+    if (paddr)
+        copy_to_page(paddr, page);
+    return paddr;
+}
 
+// 拆分 fork 时共享的页表，table 为页表的虚拟地址
+// 共享期间页框引用只记在页表上，拆分时才把页框引用转移到两份页表中
+static u32 copy_table(page_entry_t *table)
+{
+    // 先申请页，失败时页表保持原样
+    u32 paddr = get_page();
+    if (!paddr)
+        return 0;
+
+    for (size_t tidx = 0; tidx < 1024; tidx++)
+    {
+        page_entry_t *entry = &table[tidx];
+
+        // 换出的页，两份页表引用同一个槽位
+        swap_entry_t *sentry = (swap_entry_t *)entry;
+        if (!sentry->present && sentry->swapped)
+            swap_dup(sentry->slot);
+
+        if (!entry->present)
+            continue;
+
+        // 对应物理内存引用大于 0
+        assert(memory_map[entry->index] > 0);
+
+        // 若不是共享内存，则置为只读，两份页表都由写时拷贝处理
+        if (!entry->shared)
+        {
+            entry->write = false;
+        }
+        // 对应物理页引用加 1
+        memory_map[entry->index]++;
+
+        assert(memory_map[entry->index] < 255);
+    }
+    copy_to_page(paddr, table);
     return paddr;
 }
 
+// 将物理页清零
+static void zero_page(u32 paddr)
+{
+    // 低端内存是一一映射的
+    if (paddr < KERNEL_MEMORY_SIZE)
+    {
+        memset((void *)paddr, 0, PAGE_SIZE);
+        return;
+    }
+
+    // 与 copy_page 相同，临时映射到第 0 页，期间不能被打断
+    bool intr = interrupt_disable();
+
+    u32 vaddr = 0;
+    page_entry_t *entry = get_pte(vaddr, false);
+    entry_init(entry, IDX(paddr));
+    flush_tlb(vaddr);
+
+    memset((void *)vaddr, 0, PAGE_SIZE);
+
+    entry->present = false;
+    flush_tlb(vaddr);
+
+    set_interrupt_state(intr);
+}
+
+// 与 zero_page 相同，临时映射物理页 paddr，拷贝 [offset, offset + len) 的内容
+// buf 必须是内核内存，拷贝期间不能缺页
+static void frame_copy(u32 paddr, u32 offset, void *buf, u32 len, bool write)
+{
+    assert(offset + len <= PAGE_SIZE);
+    if (paddr < KERNEL_MEMORY_SIZE)
+    {
+        if (write)
+            memcpy((void *)(paddr + offset), buf, len);
+        else
+            memcpy(buf, (void *)(paddr + offset), len);
+        return;
+    }
+
+    bool intr = interrupt_disable();
+
+    u32 vaddr = 0;
+    page_entry_t *entry = get_pte(vaddr, false);
+    entry_init(entry, IDX(paddr));
+    flush_tlb(vaddr);
+
+    if (write)
+        memcpy((void *)(vaddr + offset), buf, len);
+    else
+        memcpy(buf, (void *)(vaddr + offset), len);
+
+    entry->present = false;
+    flush_tlb(vaddr);
+
+    set_interrupt_state(intr);
+}
+
+void frame_write(u32 paddr, u32 offset, void *buf, u32 len)
+{
+    frame_copy(paddr, offset, buf, len, true);
+}
+
+void frame_read(u32 paddr, u32 offset, void *buf, u32 len)
+{
+    frame_copy(paddr, offset, buf, len, false);
+}
+
+u32 frame_count(u32 paddr)
+{
+    return memory_map[IDX(paddr)];
+}
+
+// 分配一页清零的物理内存，优先从预先清零的页池中取
+u32 get_zero_page()
+{
+    if (!zero_count)
+    {
+        zero_misses++;
+        u32 page = get_page();
+        if (page)
+            zero_page(page);
+        return page;
+    }
+
+    zero_hits++;
+    u32 idx = zero_pool[--zero_count];
+
+    assert(!memory_map[idx]);
+    memory_map[idx] = 1;
+    assert(free_pages > 0);
+    free_pages--;
+
+    return PAGE(idx);
+}
+
+bool zero_pool_fill()
+{
+    if (zero_count == ZERO_POOL_SIZE)
+        return false;
+
+    // 空闲进程开中断运行，访问伙伴系统和页池时需要关中断
+    bool intr = interrupt_disable();
+    int32 idx = buddy_alloc(0);
+    set_interrupt_state(intr);
+
+    if (idx == EOF)
+        return false;
+
+    zero_page(PAGE(idx));
+
+    intr = interrupt_disable();
+    assert(zero_count < ZERO_POOL_SIZE);
+    zero_pool[zero_count++] = idx;
+    set_interrupt_state(intr);
+    return true;
+}
+
+// 内存回收，将预先清零的页还给伙伴系统
+static u32 zero_pool_shrink(u32 count)
+{
+    u32 freed = 0;
+    while (zero_count && freed < count)
+    {
+        buddy_free(zero_pool[--zero_count], 0);
+        freed++;
+    }
+    return freed;
+}
+
+void zero_pool_stat(zero_pool_stat_t *stat)
+{
+    stat->count = zero_count;
+    stat->size = ZERO_POOL_SIZE;
+    stat->hits = zero_hits;
+    stat->misses = zero_misses;
+}
+
 // 页表写时拷贝
 // vaddr 表示虚拟地址
 // level 表示层级，页目录，页表，页框
-void copy_on_write(u32 vaddr, int level)
+// 内存不足时返回 -ENOMEM
+static err_t copy_on_write(u32 vaddr, int level)
 {
     // 递归返回
     if (level == 0)
-        return;
+        return EOK;
 
     // 获得当前虚拟地址对应的入口
     page_entry_t *entry = get_entry(vaddr, false);
     // 对该入口进行写时拷贝，于是页目录和页表拷贝完毕
-    copy_on_write((u32)entry, level - 1);
+    err_t ret = copy_on_write((u32)entry, level - 1);
+    if (ret < EOK)
+        return ret;
 
     // 如果该地址已经可写，则返回
     if (entry->write)
-        return;
+        return EOK;
 
     // 物理内存引用大于 0
     assert(memory_map[entry->index] > 0);
@@ -446,8 +969,15 @@ void copy_on_write(u32 vaddr, int level)
     }
     else
     {
-        // 否则，拷贝该页
-        u32 paddr = copy_page((void *)PAGE(IDX(vaddr)));
+        // 否则，拷贝该页，层级 2 时拷贝的是页表
+        u32 paddr;
+        if (level == 2)
+            paddr = copy_table((page_entry_t *)PAGE(IDX(vaddr)));
+        else
+            paddr = copy_page((void *)PAGE(IDX(vaddr)));
+
+        if (!paddr)
+            return -ENOMEM;
 
         // 物理内存引用减一
         memory_map[entry->index]--;
@@ -461,30 +991,39 @@ void copy_on_write(u32 vaddr, int level)
     // 刷新快表，很多错误发生在快表没有及时刷新 😔
     assert(memory_map[entry->index] > 0);
     flush_tlb(vaddr);
+    return EOK;
 }
 
-// 将 vaddr 映射物理内存
-void link_page(u32 vaddr)
+// 将 vaddr 映射物理内存，内存不足时返回 -ENOMEM
+err_t link_page(u32 vaddr)
 {
     ASSERT_PAGE(vaddr);
 
     page_entry_t *entry = get_entry(vaddr, true);
-
-    u32 index = IDX(vaddr);
+    if (!entry)
+        return -ENOMEM;
 
     // 如果页面已存在，则直接返回
     if (entry->present)
     {
-        return;
+        return EOK;
     }
 
-    copy_on_write((u32)entry, 2);
+    if (copy_on_write((u32)entry, 2) < EOK)
+        return -ENOMEM;
+
+    // 匿名内存需要清零，不能把其他进程的数据暴露出来
+    u32 paddr = get_zero_page();
+    if (!paddr)
+        return -ENOMEM;
 
-    u32 paddr = get_page();
     entry_init(entry, IDX(paddr));
+    // 新页视为刚刚访问过，避免还没有使用就被换出
+    entry->accessed = true;
     flush_tlb(vaddr);
 
     LOGK("LINK from 0x%p to 0x%p\n", vaddr, paddr);
+    return EOK;
 }
 
 // 去掉 vaddr 对应的物理内存映射
@@ -498,16 +1037,26 @@ void unlink_page(u32 vaddr)
         return;
 
     entry = get_entry(vaddr, false);
-    if (!entry->present)
+    swap_entry_t *sentry = (swap_entry_t *)entry;
+    if (!entry->present && !sentry->swapped)
     {
         return;
     }
 
-    copy_on_write((u32)entry, 2);
+    // 拆分共享页表失败时保留映射，进程退出时随页表一起释放
+    if (copy_on_write((u32)entry, 2) < EOK)
+        return;
 
-    entry->present = false;
+    // 换出的页，释放交换槽位
+    if (sentry->swapped)
+    {
+        swap_free(sentry->slot);
+        *(u32 *)entry = 0;
+        return;
+    }
 
     u32 paddr = PAGE(entry->index);
+    *(u32 *)entry = 0;
 
     DEBUGK("UNLINK from 0x%p to 0x%p\n", vaddr, paddr);
     put_page(paddr);
@@ -515,16 +1064,41 @@ void unlink_page(u32 vaddr)
     flush_tlb(vaddr);
 }
 
-void map_page(u32 vaddr, u32 paddr)
+// 去掉 vaddr 开始的整个页表，只处理页表还被共享的情况
+// 返回 false 表示页表是私有的，需要逐页解除映射
+static bool unlink_table(u32 vaddr)
+{
+    assert((vaddr & 0x3fffff) == 0);
+
+    page_entry_t *entry = &get_pde()[DIDX(vaddr)];
+    if (!entry->present)
+        return true;
+
+    assert(memory_map[entry->index] > 0);
+    if (memory_map[entry->index] == 1)
+        return false;
+
+    // 页框引用由共享的页表持有，释放页表引用即可
+    entry->present = false;
+    put_page(PAGE(entry->index));
+
+    set_cr3(running_task()->pde);
+    LOGK("UNLINK shared table 0x%p\n", vaddr);
+    return true;
+}
+
+err_t map_page(u32 vaddr, u32 paddr)
 {
     ASSERT_PAGE(vaddr);
     ASSERT_PAGE(paddr);
 
     page_entry_t *entry = get_entry(vaddr, true);
+    if (!entry)
+        return -ENOMEM;
 
     if (entry->present)
     {
-        return;
+        return EOK;
     }
 
     if (!paddr)
@@ -532,67 +1106,102 @@ void map_page(u32 vaddr, u32 paddr)
         paddr = get_page();
     }
 
+    if (!paddr)
+        return -ENOMEM;
+
     entry_init(entry, IDX(paddr));
     flush_tlb(vaddr);
+    return EOK;
 }
 
-void map_area(u32 paddr, u32 size)
+// 将内核页 paddr 只读映射到所有进程的 vaddr，vaddr 在进程的用户空间之外
+// 页表放在内核页目录中，之后创建的页目录都拷贝这个页表项，拷贝和释放页目录时不处理
+void map_user_readonly(u32 vaddr, u32 paddr)
+{
+    ASSERT_PAGE(vaddr);
+    ASSERT_PAGE(paddr);
+    assert(vaddr >= USER_STACK_TOP && vaddr < PDE_MASK);
+
+    page_entry_t *pde = (page_entry_t *)KERNEL_PAGE_DIR;
+    page_entry_t *dentry = &pde[DIDX(vaddr)];
+    if (!dentry->present)
+    {
+        u32 table = alloc_kpage(1);
+        if (!table)
+            panic("Out of kernel memory!!!");
+        memset((void *)table, 0, PAGE_SIZE);
+        entry_init(dentry, IDX(table));
+    }
+
+    page_entry_t *entry = &((page_entry_t *)PAGE(dentry->index))[TIDX(vaddr)];
+    entry_init(entry, IDX(paddr));
+    entry->write = false;
+    flush_tlb(vaddr);
+}
+
+err_t map_area(u32 paddr, u32 size)
 {
     ASSERT_PAGE(paddr);
     u32 page_count = div_round_up(size, PAGE_SIZE);
     for (size_t i = 0; i < page_count; i++)
     {
-        map_page(paddr + i * PAGE_SIZE, paddr + i * PAGE_SIZE);
+        err_t ret = map_page(paddr + i * PAGE_SIZE, paddr + i * PAGE_SIZE);
+        if (ret < EOK)
+            return ret;
     }
     LOGK("MAP memory 0x%p size 0x%X\n", paddr, size);
+    return EOK;
+}
+
+void map_mmio(u32 paddr, u32 size)
+{
+    ASSERT_PAGE(paddr);
+    u32 page_count = div_round_up(size, PAGE_SIZE);
+    for (size_t i = 0; i < page_count; i++)
+    {
+        u32 addr = paddr + i * PAGE_SIZE;
+        page_entry_t *entry = get_entry(addr, true);
+        if (!entry)
+            panic("Out of Memory!!!");
+
+        entry_init(entry, IDX(addr));
+        entry->user = false;
+        entry->pcd = true;
+        entry->pwt = true;
+        flush_tlb(addr);
+    }
+    LOGK("MAP mmio 0x%p size 0x%X\n", paddr, size);
 }
 
 // 拷贝当前页目录
+// 页表只在页目录一级共享，直到某一方第一次通过页表写入时才拆分，见 copy_table
 page_entry_t *copy_pde()
 {
     task_t *task = running_task();
 
-    page_entry_t *pde = (page_entry_t *)task->pde;
+    // 先分配页目录，失败时还没有修改当前进程的页表
+    page_entry_t *pde = (page_entry_t *)alloc_kpage(1);
+    if (!pde)
+        return NULL;
+
+    page_entry_t *parent = (page_entry_t *)task->pde;
     page_entry_t *dentry = NULL;
     page_entry_t *entry = NULL;
 
     for (size_t didx = (sizeof(KERNEL_PAGE_TABLE) / 4); didx < USER_STACK_TOP >> 22; didx++)
     {
-        dentry = &pde[didx];
+        dentry = &parent[didx];
         if (!dentry->present)
             continue;
 
-        // 将所有页表也置为只读
+        // 将所有页表置为只读，页表中的页框也就都不可写
         assert(memory_map[dentry->index] > 0);
         dentry->write = false;
         memory_map[dentry->index]++;
         assert(memory_map[dentry->index] < 255);
-
-        page_entry_t *pte = (page_entry_t *)(PDE_MASK | (didx << 12));
-
-        for (size_t tidx = 0; tidx < 1024; tidx++)
-        {
-            entry = &pte[tidx];
-            if (!entry->present)
-                continue;
-
-            // 对应物理内存引用大于 0
-            assert(memory_map[entry->index] > 0);
-
-            // 若不是共享内存，则置为只读
-            if (!entry->shared)
-            {
-                entry->write = false;
-            }
-            // 对应物理页引用加 1
-            memory_map[entry->index]++;
-
-            assert(memory_map[entry->index] < 255);
-        }
     }
 
-    pde = (page_entry_t *)alloc_kpage(1);
-    memcpy(pde, (void *)task->pde, PAGE_SIZE);
+    memcpy(pde, parent, PAGE_SIZE);
 
     // 将最后一个页表指向页目录自己，方便修改
     entry = &pde[1023];
@@ -603,6 +1212,25 @@ page_entry_t *copy_pde()
     return pde;
 }
 
+// 创建新的页目录，只保留内核映射，用于 spawn
+page_entry_t *create_pde()
+{
+    task_t *task = running_task();
+
+    page_entry_t *pde = (page_entry_t *)alloc_kpage(1);
+    if (!pde)
+        return NULL;
+    memcpy(pde, (void *)task->pde, PAGE_SIZE);
+
+    // 去掉用户空间的页表
+    u32 start = sizeof(KERNEL_PAGE_TABLE) / 4;
+    memset(&pde[start], 0, ((USER_STACK_TOP >> 22) - start) * sizeof(page_entry_t));
+
+    // 将最后一个页表指向页目录自己，方便修改
+    entry_init(&pde[1023], IDX(pde));
+    return pde;
+}
+
 // 释放当前页目录
 void free_pde()
 {
@@ -619,11 +1247,27 @@ void free_pde()
             continue;
         }
 
+        // 页表还与其他进程共享，页框引用由页表持有，只释放页表引用
+        assert(memory_map[dentry->index] > 0);
+        if (memory_map[dentry->index] > 1)
+        {
+            put_page(PAGE(dentry->index));
+            continue;
+        }
+
         page_entry_t *pte = (page_entry_t *)(PDE_MASK | (didx << 12));
 
         for (size_t tidx = 0; tidx < 1024; tidx++)
         {
             page_entry_t *entry = &pte[tidx];
+
+            swap_entry_t *sentry = (swap_entry_t *)entry;
+            if (!sentry->present && sentry->swapped)
+            {
+                swap_free(sentry->slot);
+                continue;
+            }
+
             if (!entry->present)
             {
                 continue;
@@ -659,10 +1303,16 @@ int32 sys_brk(void *addr)
     {
         for (u32 page = brk; page < old_brk; page += PAGE_SIZE)
         {
+            // fork 后直接 execve 时，整个页表还是共享的，不必拆分页表
+            if (!(page & 0x3fffff) && page + 0x400000 <= old_brk && unlink_table(page))
+            {
+                page += 0x400000 - PAGE_SIZE;
+                continue;
+            }
             unlink_page(page);
         }
     }
-    else if (IDX(brk - old_brk) > free_pages)
+    else if (IDX(brk - old_brk) > free_pages + swap_avail())
     {
         // out of memory
         return -1;
@@ -672,75 +1322,854 @@ int32 sys_brk(void *addr)
     return 0;
 }
 
-void *sys_mmap(void *addr, size_t length, int prot, int flags, int fd, off_t offset)
+// 查找包含 vaddr 的映射区域，区域按开始地址有序排列
+static vm_area_t *vma_find(task_t *task, u32 vaddr)
 {
-    ASSERT_PAGE((u32)addr);
+    list_t *list = &task->vma_list;
+    for (list_node_t *node = list->head.next; node != &list->tail; node = node->next)
+    {
+        vm_area_t *vma = element_entry(vm_area_t, node, node);
+        if (vma->start > vaddr)
+            break;
+        if (vaddr < vma->end)
+            return vma;
+    }
+    return NULL;
+}
 
-    u32 count = div_round_up(length, PAGE_SIZE);
-    u32 vaddr = (u32)addr;
+// 按开始地址有序插入区域，区域之间不能重叠
+static void vma_insert(task_t *task, vm_area_t *vma)
+{
+    list_t *list = &task->vma_list;
+    list_node_t *node = list->head.next;
+    for (; node != &list->tail; node = node->next)
+    {
+        vm_area_t *ptr = element_entry(vm_area_t, node, node);
+        if (ptr->start >= vma->end)
+            break;
+        assert(ptr->end <= vma->start);
+    }
+    list_insert_before(node, &vma->node);
+}
 
-    task_t *task = running_task();
-    if (!vaddr)
+// 释放区域描述符
+static void vma_free(vm_area_t *vma)
+{
+    list_remove(&vma->node);
+    if (vma->inode)
+        iput(vma->inode);
+    if (vma->shm)
+        shm_detach(vma->shm);
+    kfree(vma);
+}
+
+// 在 addr 处拆分区域，之后 addr 不会落在某个区域的中间
+static void vma_split(task_t *task, u32 addr)
+{
+    vm_area_t *vma = vma_find(task, addr);
+    if (!vma || vma->start == addr)
+        return;
+
+    vm_area_t *tail = (vm_area_t *)kmalloc(sizeof(vm_area_t));
+    memcpy(tail, vma, sizeof(vm_area_t));
+    tail->start = addr;
+    tail->offset += addr - vma->start;
+    if (tail->inode)
+        tail->inode->count++;
+    if (tail->shm)
+        shm_attach(tail->shm);
+    vma->end = addr;
+    list_insert_after(&vma->node, &tail->node);
+}
+
+// [start, end) 是否与已有区域重叠
+static bool vma_overlap(task_t *task, u32 start, u32 end)
+{
+    list_t *list = &task->vma_list;
+    for (list_node_t *node = list->head.next; node != &list->tail; node = node->next)
+    {
+        vm_area_t *vma = element_entry(vm_area_t, node, node);
+        if (vma->start >= end)
+            break;
+        if (vma->end > start)
+            return true;
+    }
+    return false;
+}
+
+// [start, end) 是否完全被区域覆盖，中间没有空洞
+static bool vma_covered(task_t *task, u32 start, u32 end)
+{
+    list_t *list = &task->vma_list;
+    for (list_node_t *node = list->head.next; node != &list->tail; node = node->next)
+    {
+        vm_area_t *vma = element_entry(vm_area_t, node, node);
+        if (vma->end <= start)
+            continue;
+        if (vma->start > start)
+            return false;
+        start = vma->end;
+        if (start >= end)
+            return true;
+    }
+    return false;
+}
+
+// 首次适应查找 count 页的空闲地址，失败返回 0
+static u32 vma_unmapped(task_t *task, u32 count)
+{
+    u32 size = count * PAGE_SIZE;
+    u32 addr = USER_MMAP_ADDR;
+
+    list_t *list = &task->vma_list;
+    for (list_node_t *node = list->head.next; node != &list->tail; node = node->next)
     {
-        vaddr = scan_page(task->vmap, count);
+        vm_area_t *vma = element_entry(vm_area_t, node, node);
+        if (vma->start - addr >= size)
+            break;
+        addr = vma->end;
     }
 
-    assert(vaddr >= USER_MMAP_ADDR && vaddr < USER_STACK_BOTTOM);
+    if (addr + size < addr || addr + size > USER_STACK_BOTTOM)
+        return 0;
+    return addr;
+}
 
-    for (size_t i = 0; i < count; i++)
+// 页在文件中的索引
+static _inline idx_t vma_index(vm_area_t *vma, u32 vaddr)
+{
+    return IDX(vaddr - vma->start) + IDX(vma->offset);
+}
+
+// 匿名映射的页，第一次访问时分配清零的页
+static err_t vma_anon_fault(vm_area_t *vma, u32 vaddr)
+{
+    err_t ret = link_page(vaddr);
+    if (ret < EOK)
+        return ret;
+
+    page_entry_t *entry = get_entry(vaddr, false);
+    entry->user = vma->prot != PROT_NONE;
+    entry->readonly = !(vma->prot & PROT_WRITE);
+    entry->write = !entry->readonly;
+    entry->shared = (vma->flags & MAP_SHARED) != 0;
+    entry->privat = (vma->flags & MAP_PRIVATE) != 0;
+    flush_tlb(vaddr);
+
+    LOGK("MMAP anonymous fault 0x%p\n", vaddr);
+    return EOK;
+}
+
+// 共享内存段的页，映射段中对应的页框
+static err_t vma_shm_fault(vm_area_t *vma, u32 vaddr)
+{
+    // 段中的页可能需要分配，在修改页表之前
+    u32 paddr = shm_page_get(vma->shm, vma_index(vma, vaddr));
+    if (!paddr)
+        return -ENOMEM;
+
+    page_entry_t *entry = get_entry(vaddr, true);
+    if (!entry || copy_on_write((u32)entry, 2) < EOK)
+        return -ENOMEM;
+    assert(!entry->present);
+
+    // 段本身持有一个引用
+    assert(memory_map[IDX(paddr)] > 0);
+    memory_map[IDX(paddr)]++;
+    assert(memory_map[IDX(paddr)] < 255);
+
+    entry_init(entry, IDX(paddr));
+    entry->user = vma->prot != PROT_NONE;
+    entry->readonly = !(vma->prot & PROT_WRITE);
+    entry->write = !entry->readonly;
+    entry->shared = true;
+    flush_tlb(vaddr);
+
+    LOGK("SHM fault 0x%p index %d\n", vaddr, vma_index(vma, vaddr));
+    return EOK;
+}
+
+// 映射区域缺页，匿名映射分配新页，文件映射从页缓存中映射对应的页
+static err_t vma_fault(vm_area_t *vma, u32 vaddr)
+{
+    if (vma->shm)
+        return vma_shm_fault(vma, vaddr);
+    if (!vma->inode)
+        return vma_anon_fault(vma, vaddr);
+
+    page_entry_t *entry = get_entry(vaddr, true);
+    if (!entry || copy_on_write((u32)entry, 2) < EOK)
+        return -ENOMEM;
+    assert(!entry->present);
+
+    u32 paddr = 0;
+    err_t ret = inode_page_get(vma->inode, vma_index(vma, vaddr), &paddr);
+    if (ret < EOK)
+        return ret;
+    if (!paddr)
+        return -ENOMEM;
+
+    // 页缓存本身持有一个引用
+    assert(memory_map[IDX(paddr)] > 0);
+    memory_map[IDX(paddr)]++;
+    assert(memory_map[IDX(paddr)] < 255);
+
+    entry_init(entry, IDX(paddr));
+    entry->user = vma->prot != PROT_NONE;
+    entry->readonly = !(vma->prot & PROT_WRITE);
+
+    if (vma->flags & MAP_SHARED)
     {
-        u32 page = vaddr + PAGE_SIZE * i;
-        link_page(page);
-        bitmap_set(task->vmap, IDX(page), true);
+        // 共享映射直接写页缓存
+        entry->shared = true;
+        entry->write = !entry->readonly;
+    }
+    else
+    {
+        // 私有映射写时拷贝
+        entry->privat = true;
+        entry->write = false;
+    }
+
+    flush_tlb(vaddr);
+    LOGK("MMAP fault 0x%p index %d\n", vaddr, vma_index(vma, vaddr));
+    return EOK;
+}
+
+// 写回 [start, end) 中被修改过的共享文件映射页
+static void vma_sync(vm_area_t *vma, u32 start, u32 end)
+{
+    if (!vma->inode || !(vma->flags & MAP_SHARED))
+        return;
+
+    for (u32 page = MAX(start, vma->start); page < MIN(end, vma->end); page += PAGE_SIZE)
+    {
+        if (!get_paddr(page))
+            continue;
 
         page_entry_t *entry = get_entry(page, false);
-        entry->user = true;
-        entry->write = false;
-        entry->readonly = true;
+        if (!entry->dirty)
+            continue;
 
-        if (prot & PROT_WRITE)
-        {
-            entry->readonly = false;
-            entry->write = true;
-        }
-        if (flags & MAP_SHARED)
+        inode_page_sync(vma->inode, vma_index(vma, page));
+        entry->dirty = false;
+        flush_tlb(page);
+    }
+}
+
+// 修改 [start, end) 中已经映射的页的权限，包括换出的页
+static err_t vma_protect(vm_area_t *vma, u32 start, u32 end)
+{
+    page_entry_t *pde = get_pde();
+    for (u32 page = start; page < end; page += PAGE_SIZE)
+    {
+        if (!pde[DIDX(page)].present)
         {
-            entry->shared = true;
+            page = (page & ~0x3fffff) + 0x400000 - PAGE_SIZE;
+            continue;
         }
-        if (flags & MAP_PRIVATE)
+
+        // 交换项保留了权限位，位置与页表项相同
+        page_entry_t *entry = get_entry(page, false);
+        if (!entry->present && !((swap_entry_t *)entry)->swapped)
+            continue;
+
+        // 页表还与其他进程共享时先拆分
+        if (copy_on_write((u32)entry, 2) < EOK)
+            return -ENOMEM;
+
+        entry->user = vma->prot != PROT_NONE;
+        entry->readonly = !(vma->prot & PROT_WRITE);
+        if (entry->readonly)
+            entry->write = false;
+        else if (entry->shared)
+            entry->write = true;
+        // 私有页保持只读，第一次写入时由写时拷贝置为可写
+
+        flush_tlb(page);
+    }
+    return EOK;
+}
+
+// 解除 [start, end) 的映射，并去掉对应的区域，共享文件映射先写回脏页
+static void vma_unmap(task_t *task, u32 start, u32 end)
+{
+    vma_split(task, start);
+    vma_split(task, end);
+
+    list_t *list = &task->vma_list;
+    for (list_node_t *node = list->head.next; node != &list->tail;)
+    {
+        vm_area_t *vma = element_entry(vm_area_t, node, node);
+        node = node->next;
+
+        if (vma->end <= start)
+            continue;
+        if (vma->start >= end)
+            break;
+
+        vma_sync(vma, vma->start, vma->end);
+
+        // 只有区域内才会有页，页解除映射之后才可以释放文件的页缓存
+        for (u32 page = vma->start; page < vma->end; page += PAGE_SIZE)
         {
-            entry->privat = true;
+            unlink_page(page);
         }
-        flush_tlb(page);
+        vma_free(vma);
     }
+}
+
+void *sys_mmap(void *addr, size_t length, int prot, int flags, int fd, off_t offset)
+{
+    u32 count = div_round_up(length, PAGE_SIZE);
+    u32 vaddr = (u32)addr;
+
+    if (!count || (vaddr & 0xfff))
+        return (void *)-EINVAL;
+
+    task_t *task = running_task();
+    inode_t *inode = NULL;
+    int maxprot = PROT_READ | PROT_WRITE | PROT_EXEC;
 
     if (fd != EOF)
     {
-        lseek(fd, offset, SEEK_SET);
-        read(fd, (char *)vaddr, length);
+        file_t *file;
+        if (fd_check(fd, &file) < EOK)
+            return (void *)-EBADF;
+
+        inode = file->inode;
+        if (!ISFILE(inode->mode) || (offset & 0xfff))
+            return (void *)-EINVAL;
+
+        // 只读打开的文件，共享映射不能写
+        if ((flags & MAP_SHARED) && (file->flags & O_ACCMODE) == O_RDONLY)
+            maxprot &= ~PROT_WRITE;
+
+        if (prot & ~maxprot)
+            return (void *)-EACCES;
+    }
+
+    if (vaddr)
+    {
+        u32 end = vaddr + count * PAGE_SIZE;
+        if (vaddr < USER_MMAP_ADDR || end > USER_STACK_BOTTOM || end < vaddr)
+            return (void *)-EINVAL;
+
+        // 固定地址直接替换原有的映射，否则地址只作为参考
+        if (flags & MAP_FIXED)
+            vma_unmap(task, vaddr, end);
+        else if (vma_overlap(task, vaddr, end))
+            vaddr = 0;
+    }
+
+    if (!vaddr)
+    {
+        vaddr = vma_unmapped(task, count);
+        if (!vaddr)
+            return (void *)-ENOMEM;
+    }
+
+    vm_area_t *vma = (vm_area_t *)kmalloc(sizeof(vm_area_t));
+    vma->start = vaddr;
+    vma->end = vaddr + count * PAGE_SIZE;
+    vma->prot = prot;
+    vma->maxprot = maxprot;
+    vma->flags = flags;
+    vma->inode = inode;
+    vma->shm = NULL;
+    vma->offset = inode ? offset : 0;
+    if (inode)
+        inode->count++;
+    vma_insert(task, vma);
+
+    // 私有映射只记录区域，在缺页时分配或从页缓存中映射
+    // 匿名共享映射需要 fork 之后父子进程看到同一个页，只能立即分配
+    if (inode || !(flags & MAP_SHARED))
+    {
+        LOGK("MMAP 0x%p count %d offset %d\n", vaddr, count, offset);
+        return (void *)vaddr;
+    }
+
+    for (u32 page = vma->start; page < vma->end; page += PAGE_SIZE)
+    {
+        if (vma_anon_fault(vma, page) < EOK)
+        {
+            // 内存不足，撤销整个映射
+            vma_unmap(task, vma->start, vma->end);
+            return (void *)-ENOMEM;
+        }
     }
 
     return (void *)vaddr;
 }
 
+int sys_msync(void *addr, size_t length, int flags)
+{
+    task_t *task = running_task();
+    u32 vaddr = (u32)addr;
+    if (vaddr & 0xfff)
+        return -EINVAL;
+
+    u32 end = vaddr + div_round_up(length, PAGE_SIZE) * PAGE_SIZE;
+
+    list_t *list = &task->vma_list;
+    for (list_node_t *node = list->head.next; node != &list->tail; node = node->next)
+    {
+        vm_area_t *vma = element_entry(vm_area_t, node, node);
+        if (vma->start >= end)
+            break;
+        if (vma->end <= vaddr)
+            continue;
+        vma_sync(vma, vaddr, end);
+    }
+    return EOK;
+}
+
+int sys_mprotect(void *addr, size_t length, int prot)
+{
+    task_t *task = running_task();
+    u32 start = (u32)addr;
+    u32 end = start + div_round_up(length, PAGE_SIZE) * PAGE_SIZE;
+
+    if ((start & 0xfff) || start < USER_MMAP_ADDR || end > USER_STACK_BOTTOM || end < start)
+        return -EINVAL;
+    if (start == end)
+        return EOK;
+
+    // 范围内不能有未映射的地址
+    if (!vma_covered(task, start, end))
+        return -ENOMEM;
+
+    list_t *list = &task->vma_list;
+    for (list_node_t *node = list->head.next; node != &list->tail; node = node->next)
+    {
+        vm_area_t *vma = element_entry(vm_area_t, node, node);
+        if (vma->start >= end)
+            break;
+        if (vma->end > start && (prot & ~vma->maxprot))
+            return -EACCES;
+    }
+
+    vma_split(task, start);
+    vma_split(task, end);
+
+    for (list_node_t *node = list->head.next; node != &list->tail; node = node->next)
+    {
+        vm_area_t *vma = element_entry(vm_area_t, node, node);
+        if (vma->start >= end)
+            break;
+        if (vma->end <= start)
+            continue;
+
+        vma->prot = prot;
+        err_t ret = vma_protect(vma, vma->start, vma->end);
+        if (ret < EOK)
+            return ret;
+    }
+    LOGK("MPROTECT 0x%p - 0x%p prot %d\n", start, end, prot);
+    return EOK;
+}
+
 int sys_munmap(void *addr, size_t length)
 {
+    task_t *task = running_task();
+    u32 start = (u32)addr;
+    u32 end = start + div_round_up(length, PAGE_SIZE) * PAGE_SIZE;
+
+    if ((start & 0xfff) || start < USER_MMAP_ADDR || end > USER_STACK_BOTTOM || end < start)
+        return -EINVAL;
+
+    vma_unmap(task, start, end);
+    return EOK;
+}
+
+void *sys_shmat(int shmid, const void *addr, int flags)
+{
+    shm_t *shm = shm_get(shmid);
+    if (!shm)
+        return (void *)-EINVAL;
+
     task_t *task = running_task();
     u32 vaddr = (u32)addr;
-    assert(vaddr >= USER_MMAP_ADDR && vaddr < USER_STACK_BOTTOM);
+    u32 size = shm->pages * PAGE_SIZE;
 
-    ASSERT_PAGE(vaddr);
-    u32 count = div_round_up(length, PAGE_SIZE);
+    if (vaddr)
+    {
+        u32 end = vaddr + size;
+        if ((vaddr & 0xfff) || vaddr < USER_MMAP_ADDR || end > USER_STACK_BOTTOM || end < vaddr)
+            return (void *)-EINVAL;
+        if (vma_overlap(task, vaddr, end))
+            return (void *)-EINVAL;
+    }
+    else
+    {
+        vaddr = vma_unmapped(task, shm->pages);
+        if (!vaddr)
+            return (void *)-ENOMEM;
+    }
 
-    for (size_t i = 0; i < count; i++)
+    // 页框在缺页时才映射，与匿名共享映射不同，段本身保证了各个进程看到同一个页
+    vm_area_t *vma = (vm_area_t *)kmalloc(sizeof(vm_area_t));
+    vma->start = vaddr;
+    vma->end = vaddr + size;
+    vma->maxprot = PROT_READ;
+    if (!(flags & SHM_RDONLY))
+        vma->maxprot |= PROT_WRITE | PROT_EXEC;
+    vma->prot = vma->maxprot & ~PROT_EXEC;
+    vma->flags = MAP_SHARED;
+    vma->inode = NULL;
+    vma->shm = shm;
+    vma->offset = 0;
+    shm_attach(shm);
+    vma_insert(task, vma);
+
+    LOGK("SHM attach %d at 0x%p\n", shmid, vaddr);
+    return (void *)vaddr;
+}
+
+int sys_shmdt(const void *addr)
+{
+    task_t *task = running_task();
+    vm_area_t *vma = vma_find(task, (u32)addr);
+    if (!vma || !vma->shm || vma->start != (u32)addr || vma->offset)
+        return -EINVAL;
+
+    // mprotect 或 munmap 可能将段拆分为多个区域，解除同一次映射的所有区域
+    shm_t *shm = vma->shm;
+    u32 start = vma->start;
+    u32 end = start + shm->pages * PAGE_SIZE;
+
+    list_t *list = &task->vma_list;
+    for (list_node_t *node = list->head.next; node != &list->tail;)
     {
-        u32 page = vaddr + PAGE_SIZE * i;
-        unlink_page(page);
-        assert(bitmap_test(task->vmap, IDX(page)));
-        bitmap_set(task->vmap, IDX(page), false);
+        vma = element_entry(vm_area_t, node, node);
+        node = node->next;
+
+        if (vma->start >= end)
+            break;
+        if (vma->end <= start || vma->shm != shm)
+            continue;
+        if (vma->offset != vma->start - start)
+            continue;
+
+        for (u32 page = vma->start; page < vma->end; page += PAGE_SIZE)
+        {
+            unlink_page(page);
+        }
+        vma_free(vma);
     }
+    return EOK;
+}
 
-    return 0;
+void mmap_fork(task_t *child)
+{
+    task_t *task = running_task();
+    list_init(&child->vma_list);
+
+    list_t *list = &task->vma_list;
+    for (list_node_t *node = list->head.next; node != &list->tail; node = node->next)
+    {
+        vm_area_t *vma = element_entry(vm_area_t, node, node);
+        vm_area_t *copy = (vm_area_t *)kmalloc(sizeof(vm_area_t));
+        memcpy(copy, vma, sizeof(vm_area_t));
+        if (copy->inode)
+            copy->inode->count++;
+        if (copy->shm)
+            shm_attach(copy->shm);
+        list_insert_before(&child->vma_list.tail, &copy->node);
+    }
+}
+
+void mmap_exit()
+{
+    task_t *task = running_task();
+    list_t *list = &task->vma_list;
+    while (!list_empty(list))
+    {
+        vm_area_t *vma = element_entry(vm_area_t, node, list->head.next);
+        sys_munmap((void *)vma->start, vma->end - vma->start);
+    }
+}
+
+extern list_t task_list;
+
+static char swap_buffer[PAGE_SIZE]; // 交换缓冲，读写磁盘时进程会切换，不能使用临时映射
+static pid_t swap_hand_pid = 0;     // 时钟指针，进程 id
+static u32 swap_hand_addr = 0;      // 时钟指针，虚拟地址
+
+// 将物理页临时映射到第 0 页，与 copy_page 相同，期间不能被打断
+static void *map_temp(u32 paddr)
+{
+    page_entry_t *entry = get_pte(0, false);
+    entry_init(entry, IDX(paddr));
+    flush_tlb(0);
+    return (void *)0;
+}
+
+// 去掉第 0 页的临时映射
+static void unmap_temp()
+{
+    page_entry_t *entry = get_pte(0, false);
+    entry->present = false;
+    flush_tlb(0);
+}
+
+// 只换出进程私有的匿名页，共享内存、写时拷贝共享的页、文件映射的页缓存都不换出
+static _inline bool swap_eligible(page_entry_t *entry)
+{
+    return entry->present && !entry->shared &&
+           entry->index >= IDX(KERNEL_MEMORY_SIZE) &&
+           memory_map[entry->index] == 1;
+}
+
+#define SWAP_MISS_MAX 8 // 一次回收中写入失败或页被重新访问的最大次数
+
+// 选中准备换出的页，写入交换区期间进程可能继续访问该页，提交之前需要重新检查
+typedef struct swap_victim_t
+{
+    pid_t pid; // 进程 id
+    u32 vaddr; // 虚拟地址
+    u32 table; // 页表的物理地址
+    u32 paddr; // 物理页地址
+} swap_victim_t;
+
+// 时钟算法查找最近没有访问过的页，访问过的页清除访问位，给一次机会
+// 找到后页内容拷贝到交换缓冲，页表项不变，写入交换区之后由 swap_commit 修改
+// 页表可能属于其他进程，通过临时映射访问，需要关中断
+static bool swap_select(swap_victim_t *victim)
+{
+    task_t *current = running_task();
+
+    // 时钟指针指向的进程可能已经退出，从任务链表的开头重新开始
+    task_t *hand = get_task(swap_hand_pid);
+    list_node_t *node = hand ? &hand->tnode : task_list.head.next;
+    if (!hand)
+        swap_hand_addr = 0;
+
+    // 最多扫描所有进程两遍，第二遍时访问位都已经清除
+    for (u32 wraps = 0; wraps <= 2;)
+    {
+        if (node == &task_list.tail)
+        {
+            node = task_list.head.next;
+            wraps++;
+            continue;
+        }
+
+        task_t *task = element_entry(task_t, tnode, node);
+        if (task->uid == KERNEL_USER || task->state == TASK_DIED)
+            goto next;
+
+        // 在其他处理器上执行的进程，快表中可能缓存了页表项，不能换出
+        if (task != current && task->state == TASK_RUNNING)
+            goto next;
+
+        page_entry_t *pde = (page_entry_t *)task->pde;
+        u32 vaddr = MAX(swap_hand_addr, USER_EXEC_ADDR);
+        while (vaddr < USER_STACK_TOP)
+        {
+            // 共享的页表不能修改
+            page_entry_t *dentry = &pde[DIDX(vaddr)];
+            if (!dentry->present || memory_map[dentry->index] > 1)
+            {
+                vaddr = (vaddr & ~0x3fffff) + 0x400000;
+                continue;
+            }
+
+            page_entry_t *table = map_temp(PAGE(dentry->index));
+            page_entry_t *entry = NULL;
+
+            u32 end = (vaddr & ~0x3fffff) + 0x400000;
+            for (; vaddr < end; vaddr += PAGE_SIZE)
+            {
+                page_entry_t *ptr = &table[TIDX(vaddr)];
+                if (!swap_eligible(ptr))
+                    continue;
+
+                if (!ptr->accessed)
+                {
+                    entry = ptr;
+                    break;
+                }
+
+                ptr->accessed = false;
+                if (task == current)
+                    flush_tlb(vaddr);
+            }
+
+            if (!entry)
+            {
+                unmap_temp();
+                continue;
+            }
+
+            victim->pid = task->pid;
+            victim->vaddr = vaddr;
+            victim->table = PAGE(dentry->index);
+            victim->paddr = PAGE(entry->index);
+            unmap_temp();
+
+            memcpy(swap_buffer, map_temp(victim->paddr), PAGE_SIZE);
+            unmap_temp();
+
+            swap_hand_pid = task->pid;
+            swap_hand_addr = vaddr + PAGE_SIZE;
+            return true;
+        }
+
+    next:
+        swap_hand_addr = 0;
+        node = node->next;
+    }
+    return false;
+}
+
+// 页已经写入槽位 slot，重新检查之后页表项改为指向槽位的交换项，并释放物理页
+// 写入期间进程退出、页表被共享、页被访问或者重新映射，都放弃换出
+static bool swap_commit(swap_victim_t *victim, u32 slot)
+{
+    task_t *current = running_task();
+    task_t *task = get_task(victim->pid);
+    if (!task || task->uid == KERNEL_USER || task->state == TASK_DIED)
+        return false;
+
+    if (task != current && task->state == TASK_RUNNING)
+        return false;
+
+    page_entry_t *dentry = &((page_entry_t *)task->pde)[DIDX(victim->vaddr)];
+    if (!dentry->present || PAGE(dentry->index) != victim->table ||
+        memory_map[dentry->index] > 1)
+        return false;
+
+    page_entry_t *table = map_temp(victim->table);
+    page_entry_t *entry = &table[TIDX(victim->vaddr)];
+    if (!swap_eligible(entry) || entry->accessed || PAGE(entry->index) != victim->paddr)
+    {
+        unmap_temp();
+        return false;
+    }
+
+    swap_entry_t *sentry = (swap_entry_t *)entry;
+    sentry->present = false;
+    sentry->reserved0 = 0;
+    sentry->reserved1 = 0;
+    sentry->swapped = true;
+    sentry->slot = slot;
+    if (task == current)
+        flush_tlb(victim->vaddr);
+    unmap_temp();
+
+    put_page(victim->paddr);
+    LOGK("SWAP out task %d 0x%p slot %d\n", victim->pid, victim->vaddr, slot);
+    return true;
+}
+
+// 内存回收，换出最近没有访问过的匿名页，返回实际释放的页数
+// 写入失败或者页在写入期间被访问，释放槽位，页留在内存中，继续下一个
+static u32 swap_shrink(u32 count)
+{
+    u32 freed = 0;
+    u32 misses = 0;
+
+    // 交换缓冲只有一个，换入换出互斥
+    lock_acquire(&swap_lock);
+    while (freed < count && misses < SWAP_MISS_MAX)
+    {
+        u32 slot = swap_alloc();
+        if (!slot)
+            break;
+
+        swap_victim_t victim;
+        bool intr = interrupt_disable();
+        bool found = swap_select(&victim);
+        set_interrupt_state(intr);
+
+        if (!found)
+        {
+            swap_free(slot);
+            break;
+        }
+
+        if (swap_write(slot, swap_buffer) < EOK)
+        {
+            LOGK("SWAP write slot %d error\n", slot);
+            swap_free(slot);
+            misses++;
+            continue;
+        }
+
+        intr = interrupt_disable();
+        bool done = swap_commit(&victim, slot);
+        set_interrupt_state(intr);
+
+        if (!done)
+        {
+            swap_free(slot);
+            misses++;
+            continue;
+        }
+        freed++;
+    }
+    lock_release(&swap_lock);
+    return freed;
+}
+
+// 获取 vaddr 对应的交换项，页没有换出返回 NULL
+static swap_entry_t *get_swap_entry(u32 vaddr)
+{
+    page_entry_t *pde = get_pde();
+    if (!pde[DIDX(vaddr)].present)
+        return NULL;
+
+    swap_entry_t *entry = (swap_entry_t *)get_entry(vaddr, false);
+    if (entry->present || !entry->swapped)
+        return NULL;
+    return entry;
+}
+
+// 将 vaddr 对应的页从交换区换入
+static err_t swap_in(u32 vaddr)
+{
+    page_entry_t *entry = get_entry(vaddr, false);
+
+    // 页表还与其他进程共享时先拆分，槽位引用随页表项复制
+    if (copy_on_write((u32)entry, 2) < EOK)
+        return -ENOMEM;
+
+    // 申请页可能换出其他页，需要在持有锁之前
+    u32 paddr = get_page();
+    if (!paddr)
+        return -ENOMEM;
+
+    lock_acquire(&swap_lock);
+
+    swap_entry_t *sentry = (swap_entry_t *)entry;
+    assert(!sentry->present && sentry->swapped);
+    u32 slot = sentry->slot;
+
+    err_t ret = swap_read(slot, swap_buffer);
+    if (ret < EOK)
+    {
+        lock_release(&swap_lock);
+        put_page(paddr);
+        return ret;
+    }
+
+    bool intr = interrupt_disable();
+    copy_to_page(paddr, swap_buffer);
+    set_interrupt_state(intr);
+
+    sentry->swapped = false;
+    entry->index = IDX(paddr);
+    entry->accessed = true;
+    entry->present = true;
+    flush_tlb(vaddr);
+
+    swap_free(slot);
+    lock_release(&swap_lock);
+
+    LOGK("SWAP in 0x%p slot %d\n", vaddr, slot);
+    return EOK;
 }
 
 typedef struct page_error_code_t
@@ -770,9 +2199,17 @@ void page_fault(
 
     page_error_code_t *code = (page_error_code_t *)&error;
     task_t *task = running_task();
+    err_t err = EOK;
 
     // assert(KERNEL_MEMORY_SIZE <= vaddr && vaddr < USER_STACK_TOP);
 
+    // 内核通过页目录的自映射修改 fork 之后共享的页表，拆分页表之后再写
+    if (code->present && code->write && !code->user && vaddr >= PDE_MASK)
+    {
+        err = copy_on_write(vaddr, 2);
+        goto done;
+    }
+
     // 如果用户程序访问了不该访问的内存
     if (vaddr < USER_EXEC_ADDR || vaddr >= USER_STACK_TOP)
     {
@@ -783,30 +2220,84 @@ void page_fault(
 
     if (code->present)
     {
-        assert(code->write);
-
         page_entry_t *entry = get_entry(vaddr, false);
+        assert(entry->present);
 
-        assert(entry->present);   // 目前写内存应该是存在的
-        assert(!entry->shared);   // 共享内存页，不应该引发缺页
-        assert(!entry->readonly); // 只读内存页，不应该被写
+        // 访问 PROT_NONE 的页，或者写只读内存页
+        if (!code->write || !entry->user || entry->readonly)
+            goto segv;
+
+        // 共享内存页只会因为页表共享而缺页，拷贝页表后页框仍然可写
 
         // 页表写时拷贝
-        copy_on_write(vaddr, 3);
+        err = copy_on_write(vaddr, 3);
+        goto done;
+    }
 
-        return;
+    // 换出到交换区的页
+    if (get_swap_entry(vaddr))
+    {
+        err = swap_in(PAGE(IDX(vaddr)));
+        goto done;
     }
 
-    if (!code->present && (vaddr < task->brk || vaddr >= USER_STACK_BOTTOM))
+    if (vaddr < task->brk || vaddr >= USER_STACK_BOTTOM)
     {
         u32 page = PAGE(IDX(vaddr));
-        link_page(page);
+        err = link_page(page);
         // BMB;
-        return;
+        goto done;
+    }
+
+    // 映射区域缺页，检查区域的保护标志
+    vm_area_t *vma = vma_find(task, vaddr);
+    if (vma)
+    {
+        if (vma->prot == PROT_NONE || (code->write && !(vma->prot & PROT_WRITE)))
+            goto segv;
+        err = vma_fault(vma, PAGE(IDX(vaddr)));
+        goto done;
     }
 
     LOGK("task 0x%p name %s brk 0x%p page fault\n", task, task->name, task->brk);
-    panic("page fault!!!");
+
+segv:
+    assert(task->uid);
+    printk("Segmentation Fault!!!\n");
+    task_exit(-1);
+
+done:
+    if (err == EOK)
+        return;
+
+    // 回收之后内存仍然不足，或者文件映射读取失败，结束当前进程，系统继续运行
+    if (err == -EIO)
+    {
+        if (task->uid == KERNEL_USER)
+            panic("Page read error!!!");
+        printk("Page read error!!!\n");
+        task_exit(err);
+    }
+    if (task->uid == KERNEL_USER)
+        panic("Out of Memory!!!");
+    printk("Out of Memory!!!\n");
+    task_exit(err);
+}
+
+// 没有映射的用户页，是否会在缺页时按需映射，判断方式与 page_fault 相同
+static bool memory_on_demand(u32 page, bool write)
+{
+    if (page < USER_EXEC_ADDR || page >= USER_STACK_TOP)
+        return false;
+
+    task_t *task = running_task();
+    if (page < task->brk || page >= USER_STACK_BOTTOM)
+        return true;
+
+    vm_area_t *vma = vma_find(task, page);
+    if (!vma || vma->prot == PROT_NONE)
+        return false;
+    return !write || (vma->prot & PROT_WRITE);
 }
 
 // 检测内存是否可以访问
@@ -820,16 +2311,36 @@ bool memory_access(void *vaddr, int size, bool write, bool user)
     {
         page_entry_t *pde = get_pde();
         idx_t idx = DIDX(page);
-        // 判断页表
+        // 判断页表，还没有页表的地址可能按需映射
         entry = &pde[idx];
         if (!entry->present)
-            return false;
+        {
+            if (!memory_on_demand(page, write))
+                return false;
+            continue;
+        }
+
+        // 内核 4M 页
+        if (entry->pat)
+        {
+            if (user && !entry->user)
+                return false;
+            continue;
+        }
 
         page_entry_t *table = (page_entry_t *)(PDE_MASK | (idx << 12));
         // 页框
         entry = &table[TIDX(page)];
-        if (!entry->present)
-            return false;
+
+        // 还没有访问过的页，内核访问时和用户一样缺页映射
+        if (!entry->present && !((swap_entry_t *)entry)->swapped)
+        {
+            if (!memory_on_demand(page, write))
+                return false;
+            continue;
+        }
+
+        // 换出的页保留了权限位，访问时换入
 
         if (write && entry->readonly)
             return false;
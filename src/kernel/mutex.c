@@ -4,10 +4,117 @@
 #include <onix/assert.h>
 #include <onix/errno.h>
 
+// 原子地交换 *ptr 和 value，返回 *ptr 原来的值
+static _inline u32 atomic_xchg(u32 volatile *ptr, u32 value)
+{
+    asm volatile("xchgl %0, %1\n"
+                 : "+r"(value), "+m"(*ptr)
+                 :
+                 : "memory");
+    return value;
+}
+
+void spin_init(spinlock_t *lock)
+{
+    lock->locked = 0;
+}
+
+void spin_lock(spinlock_t *lock)
+{
+    // 交换失败时只读等待，减少总线上的锁操作
+    while (atomic_xchg(&lock->locked, 1))
+    {
+        while (lock->locked)
+            asm volatile("rep; nop\n"); // pause 指令
+    }
+}
+
+void spin_unlock(spinlock_t *lock)
+{
+    assert(lock->locked);
+    asm volatile("" ::: "memory"); // 临界区的写入在解锁之前完成
+    lock->locked = 0;
+}
+
+bool spin_lock_irqsave(spinlock_t *lock)
+{
+    bool intr = interrupt_disable();
+    spin_lock(lock);
+    return intr;
+}
+
+void spin_unlock_irqrestore(spinlock_t *lock, bool intr)
+{
+    spin_unlock(lock);
+    set_interrupt_state(intr);
+}
+
+static mutex_stat_t stat;
+
 void mutex_init(mutex_t *mutex)
 {
     mutex->value = false; // 初始化时没有被人持有
     list_init(&mutex->waiters);
+    mutex->holder = NULL;
+    mutex->node.next = NULL;
+    mutex->node.prev = NULL;
+    mutex->contended = 0;
+}
+
+void mutex_stat(mutex_stat_t *result)
+{
+    bool intr = interrupt_disable();
+    *result = stat;
+    set_interrupt_state(intr);
+}
+
+// 持有互斥量，加入持有者的互斥量链表
+static void mutex_hold(mutex_t *mutex, task_t *task)
+{
+    mutex->holder = task;
+    list_push(&task->mutexes, &mutex->node);
+}
+
+// 优先级继承，沿着持有者等待的互斥量向后传递
+static void mutex_boost(mutex_t *mutex, u32 priority)
+{
+    while (mutex && mutex->holder->priority < priority)
+    {
+        task_t *holder = mutex->holder;
+        task_set_priority(holder, priority);
+        stat.boosts++;
+        mutex = holder->mutex;
+    }
+}
+
+// 等待队列中优先级最高的任务，同优先级时等待最久的任务
+static task_t *mutex_waiter(mutex_t *mutex)
+{
+    task_t *waiter = NULL;
+    list_t *list = &mutex->waiters;
+    for (list_node_t *node = list->tail.prev; node != &list->head; node = node->prev)
+    {
+        task_t *task = element_entry(task_t, node, node);
+        if (!waiter || task->priority > waiter->priority)
+            waiter = task;
+    }
+    return waiter;
+}
+
+// 释放互斥量之后重新计算优先级，为基础优先级和仍然持有的互斥量中等待者的最高优先级
+static void mutex_restore(task_t *task)
+{
+    u32 priority = task->base_priority;
+    list_t *list = &task->mutexes;
+    for (list_node_t *node = list->head.next; node != &list->tail; node = node->next)
+    {
+        mutex_t *mutex = element_entry(mutex_t, node, node);
+        task_t *waiter = mutex_waiter(mutex);
+        if (waiter && waiter->priority > priority)
+            priority = waiter->priority;
+    }
+    if (priority != task->priority)
+        task_set_priority(task, priority);
 }
 
 // 尝试持有互斥量
@@ -17,19 +124,30 @@ void mutex_lock(mutex_t *mutex)
     bool intr = interrupt_disable();
 
     task_t *current = running_task();
-    while (mutex->value == true)
+    assert(mutex->holder != current);
+    stat.locks++;
+
+    if (mutex->value == false)
     {
-        // 若 value 为 true，表示已经被别人持有
-        // 则将当前任务加入互斥量等待队列
-        task_block(current, &mutex->waiters, TASK_BLOCKED, TIMELESS);
+        // 无人持有，直接持有
+        mutex->value = true;
+        mutex_hold(mutex, current);
+        set_interrupt_state(intr);
+        return;
     }
 
-    // 无人持有
-    assert(mutex->value == false);
+    // 已经被别人持有，提升持有者的优先级，然后等待持有者释放时交给自己
+    mutex->contended++;
+    stat.contended++;
+    mutex_boost(mutex, current->priority);
 
-    // 持有
-    mutex->value++;
+    current->mutex = mutex;
+    task_block(current, &mutex->waiters, TASK_BLOCKED, TIMELESS);
+    current->mutex = NULL;
+
+    // 释放者已经将互斥量交给当前任务
     assert(mutex->value == true);
+    assert(mutex->holder == current);
 
     // 恢复之前的中断状态
     set_interrupt_state(intr);
@@ -42,21 +160,30 @@ void mutex_unlock(mutex_t *mutex)
     bool intr = interrupt_disable();
 
     // 已持有互斥量
+    task_t *current = running_task();
     assert(mutex->value == true);
+    assert(mutex->holder == current);
 
-    // 取消持有
-    mutex->value--;
-    assert(mutex->value == false);
+    list_remove(&mutex->node);
 
-    // 如果等待队列不为空，则恢复执行
-    if (!list_empty(&mutex->waiters))
+    // 直接交给优先级最高的等待者，不需要让出执行权，被唤醒的任务不用再次竞争
+    task_t *task = mutex_waiter(mutex);
+    if (task)
     {
-        task_t *task = element_entry(task_t, node, mutex->waiters.tail.prev);
         assert(task->magic == ONIX_MAGIC);
+        mutex_hold(mutex, task);
+        stat.handoffs++;
         task_unblock(task, EOK);
-        // 保证新进程能获得互斥量，不然可能饿死
-        task_yield();
     }
+    else
+    {
+        mutex->holder = NULL;
+        mutex->value = false;
+    }
+
+    // 不再因为这个互斥量继承优先级
+    if (current->priority != current->base_priority)
+        mutex_restore(current);
 
     // 恢复之前的中断状态
     set_interrupt_state(intr);
@@ -296,6 +296,58 @@ u8 pci_interrupt(pci_device_t *device)
     return data & 0xff;
 }
 
+// 查找能力链表
+u8 pci_find_capability(pci_device_t *device, u8 id)
+{
+    u32 status = pci_inl(device->bus, device->dev, device->func, PCI_CONF_COMMAND) >> 16;
+    if (!(status & PCI_STATUS_CAP_LIST))
+        return 0;
+
+    u8 offset = pci_inl(device->bus, device->dev, device->func, PCI_CONF_CAPABILITY) & 0xFC;
+
+    // 最多 48 个能力，避免错误的链表形成环
+    for (size_t i = 0; offset && i < 48; i++)
+    {
+        u32 data = pci_inl(device->bus, device->dev, device->func, offset);
+        if ((data & 0xff) == id)
+            return offset;
+        offset = (data >> 8) & 0xFC;
+    }
+    return 0;
+}
+
+// 启用 MSI，只使用一个消息
+err_t pci_enable_msi(pci_device_t *device, u32 address, u32 data)
+{
+    u8 cap = pci_find_capability(device, PCI_CAP_ID_MSI);
+    if (!cap)
+        return -EIO;
+
+    // 能力头的高 16 位是消息控制
+    u32 control = pci_inl(device->bus, device->dev, device->func, cap);
+    u8 data_offset = cap + 8;
+    pci_outl(device->bus, device->dev, device->func, cap + 4, address);
+    if (control & (PCI_MSI_FLAGS_64BIT << 16))
+    {
+        pci_outl(device->bus, device->dev, device->func, cap + 8, 0);
+        data_offset = cap + 12;
+    }
+
+    // 消息数据只有 16 位，高 16 位保留
+    u32 value = pci_inl(device->bus, device->dev, device->func, data_offset);
+    value = (value & 0xffff0000) | (data & 0xffff);
+    pci_outl(device->bus, device->dev, device->func, data_offset, value);
+
+    control &= ~(PCI_MSI_FLAGS_QSIZE << 16);
+    control |= PCI_MSI_FLAGS_ENABLE << 16;
+    pci_outl(device->bus, device->dev, device->func, cap, control);
+
+    u32 command = pci_inl(device->bus, device->dev, device->func, PCI_CONF_COMMAND);
+    command |= PCI_COMMAND_INTX_DISABLE;
+    pci_outl(device->bus, device->dev, device->func, PCI_CONF_COMMAND, command);
+    return EOK;
+}
+
 // 启用总线主控，用于发起 DMA
 void pci_enable_busmastering(pci_device_t *device)
 {
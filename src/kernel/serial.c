@@ -3,6 +3,7 @@
 #include <onix/fifo.h>
 #include <onix/task.h>
 #include <onix/mutex.h>
+#include <onix/wait.h>
 #include <onix/assert.h>
 #include <onix/device.h>
 #include <onix/debug.h>
@@ -43,9 +44,9 @@ typedef struct serial_t
     fifo_t rx_fifo;       // 读 fifo
     char rx_buf[BUF_LEN]; // 读 缓冲
     lock_t rlock;         // 读锁
-    task_t *rx_waiter;    // 读等待任务
+    wait_queue_t rx_wait; // 读等待队列
     lock_t wlock;         // 写锁
-    task_t *tx_waiter;    // 写等待任务
+    wait_queue_t tx_wait; // 写等待队列
 } serial_t;
 
 static serial_t serials[2];
@@ -58,11 +59,7 @@ void recv_data(serial_t *serial)
         ch = '\n';
     }
     fifo_put(&serial->rx_fifo, ch);
-    if (serial->rx_waiter != NULL)
-    {
-        task_unblock(serial->rx_waiter, EOK);
-        serial->rx_waiter = NULL;
-    }
+    wake_up(&serial->rx_wait, EOK);
 }
 
 // 中断处理函数
@@ -81,10 +78,9 @@ void serial_handler(int vector)
     }
 
     // 如果可以发送数据，并且写进程阻塞
-    if ((state & LSR_THRE) && serial->tx_waiter)
+    if (state & LSR_THRE)
     {
-        task_unblock(serial->tx_waiter, EOK);
-        serial->tx_waiter = NULL;
+        wake_up(&serial->tx_wait, EOK);
     }
 }
 
@@ -94,12 +90,10 @@ int serial_read(serial_t *serial, char *buf, u32 count)
     int nr = 0;
     while (nr < count)
     {
-        while (fifo_empty(&serial->rx_fifo))
-        {
-            assert(serial->rx_waiter == NULL);
-            serial->rx_waiter = running_task();
-            task_block(serial->rx_waiter, NULL, TASK_BLOCKED, TIMELESS);
-        }
+        int ret;
+        wait_event(ret, &serial->rx_wait, !fifo_empty(&serial->rx_fifo),
+                   TASK_BLOCKED, TIMELESS);
+        assert(ret == EOK);
         buf[nr++] = fifo_get(&serial->rx_fifo);
     }
     lock_release(&serial->rlock);
@@ -118,9 +112,7 @@ int serial_write(serial_t *serial, char *buf, u32 count)
             outb(serial->iobase, buf[nr++]);
             continue;
         }
-        // task_t *task = running_task();
-        // serial->tx_waiter = task;
-        // task_block(task, NULL, TASK_BLOCKED, TIMELESS);
+        // wait_timeout(&serial->tx_wait, TASK_BLOCKED, TIMELESS);
     }
     lock_release(&serial->wlock);
     return nr;
@@ -133,9 +125,9 @@ void serial_init()
     {
         serial_t *serial = &serials[i];
         fifo_init(&serial->rx_fifo, serial->rx_buf, BUF_LEN);
-        serial->rx_waiter = NULL;
+        wait_queue_init(&serial->rx_wait);
         lock_init(&serial->rlock);
-        serial->tx_waiter = NULL;
+        wait_queue_init(&serial->tx_wait);
         lock_init(&serial->wlock);
 
         u16 irq;
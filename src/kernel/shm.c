@@ -0,0 +1,177 @@
+#include <onix/shm.h>
+#include <onix/memory.h>
+#include <onix/syscall.h>
+#include <onix/task.h>
+#include <onix/arena.h>
+#include <onix/string.h>
+#include <onix/stdlib.h>
+#include <onix/assert.h>
+#include <onix/debug.h>
+#include <onix/errno.h>
+
+#define LOGK(fmt, args...) DEBUGK(fmt, ##args)
+
+// 共享内存段表，shmid 就是段在表中的索引
+static shm_t *shm_table[SHM_NR];
+
+// 查找键值为 key 的段
+static int shm_find(key_t key)
+{
+    for (size_t i = 0; i < SHM_NR; i++)
+    {
+        shm_t *shm = shm_table[i];
+        if (shm && !shm->removed && shm->key == key)
+            return i;
+    }
+    return EOF;
+}
+
+// 创建 size 字节的段，返回 shmid
+static int shm_create(key_t key, size_t size)
+{
+    int shmid = EOF;
+    for (size_t i = 0; i < SHM_NR; i++)
+    {
+        if (!shm_table[i])
+        {
+            shmid = i;
+            break;
+        }
+    }
+    if (shmid == EOF)
+        return -ENOSPC;
+
+    shm_t *shm = (shm_t *)kmalloc(sizeof(shm_t));
+    shm->key = key;
+    shm->size = size;
+    shm->pages = div_round_up(size, PAGE_SIZE);
+    shm->frames = (u32 *)kmalloc(shm->pages * sizeof(u32));
+    memset(shm->frames, 0, shm->pages * sizeof(u32));
+    shm->attach = 0;
+    shm->removed = false;
+    shm->cpid = running_task()->pid;
+
+    shm_table[shmid] = shm;
+    LOGK("SHM create %d key %d size %d\n", shmid, key, size);
+    return shmid;
+}
+
+// 释放段，进程中的映射持有各自的页框引用，页框在最后一个映射解除时才归还
+static void shm_destroy(int shmid)
+{
+    shm_t *shm = shm_table[shmid];
+    assert(shm && !shm->attach);
+
+    for (size_t i = 0; i < shm->pages; i++)
+    {
+        if (shm->frames[i])
+            free_frames(shm->frames[i], 1);
+    }
+
+    shm_table[shmid] = NULL;
+    kfree(shm->frames);
+    kfree(shm);
+    LOGK("SHM destroy %d\n", shmid);
+}
+
+shm_t *shm_get(int shmid)
+{
+    if (shmid < 0 || shmid >= SHM_NR)
+        return NULL;
+    return shm_table[shmid];
+}
+
+u32 shm_page_get(shm_t *shm, idx_t index)
+{
+    assert(index < shm->pages);
+    if (shm->frames[index])
+        return shm->frames[index];
+
+    // 分配时可能回收内存而切换进程，其他进程可能已经分配了这一页
+    u32 paddr = get_zero_page();
+    if (!paddr)
+        return 0;
+
+    if (shm->frames[index])
+    {
+        free_frames(paddr, 1);
+        return shm->frames[index];
+    }
+
+    shm->frames[index] = paddr;
+    return paddr;
+}
+
+void shm_attach(shm_t *shm)
+{
+    shm->attach++;
+}
+
+void shm_detach(shm_t *shm)
+{
+    assert(shm->attach > 0);
+    shm->attach--;
+    if (shm->attach || !shm->removed)
+        return;
+
+    for (size_t i = 0; i < SHM_NR; i++)
+    {
+        if (shm_table[i] == shm)
+        {
+            shm_destroy(i);
+            return;
+        }
+    }
+    panic("shm 0x%p not in table!!!", shm);
+}
+
+int sys_shmget(key_t key, size_t size, int flags)
+{
+    if (key != IPC_PRIVATE)
+    {
+        int shmid = shm_find(key);
+        if (shmid != EOF)
+        {
+            if ((flags & IPC_CREAT) && (flags & IPC_EXCL))
+                return -EEXIST;
+            if (size > shm_table[shmid]->size)
+                return -EINVAL;
+            return shmid;
+        }
+
+        if (!(flags & IPC_CREAT))
+            return -ENOENT;
+    }
+
+    if (!size || size > SHM_SIZE_MAX)
+        return -EINVAL;
+
+    return shm_create(key, size);
+}
+
+int sys_shmctl(int shmid, int cmd, shmid_ds_t *buf)
+{
+    shm_t *shm = shm_get(shmid);
+    if (!shm)
+        return -EINVAL;
+
+    switch (cmd)
+    {
+    case IPC_STAT:
+        if (!memory_access(buf, sizeof(shmid_ds_t), true, running_task()->uid))
+            return -EFAULT;
+        buf->shm_key = shm->key;
+        buf->shm_segsz = shm->size;
+        buf->shm_nattch = shm->attach;
+        buf->shm_cpid = shm->cpid;
+        return EOK;
+    case IPC_RMID:
+        // 还有映射时只标记删除，键值可以被新的段使用
+        shm->removed = true;
+        if (!shm->attach)
+            shm_destroy(shmid);
+        return EOK;
+    default:
+        return -EINVAL;
+    }
+}
@@ -73,20 +73,15 @@ int sys_sigaction(int sig, sigaction_t *action, sigaction_t *oldaction)
     return 0;
 }
 
-// 发送信号
-int sys_kill(pid_t pid, int sig)
+// 向进程发送信号，内核进程和 init 进程不接收信号
+static int task_kill(task_t *task, int sig)
 {
-    if (sig < MINSIG || sig > MAXSIG)
-        return EOF;
-    task_t *task = get_task(pid);
-    if (!task)
-        return EOF;
     if (task->uid == KERNEL_USER)
         return EOF;
     if (task->pid == 1)
         return EOF;
 
-    LOGK("kill task %s pid %d signal %d\n", task->name, pid, sig);
+    LOGK("kill task %s pid %d signal %d\n", task->name, task->pid, sig);
     task->signal |= SIGMASK(sig);
     if (task->state == TASK_WAITING || task->state == TASK_SLEEPING)
     {
@@ -95,6 +90,33 @@ int sys_kill(pid_t pid, int sig)
     return 0;
 }
 
+// 发送信号，pid 为 0 发送给当前进程组，小于 -1 发送给进程组 -pid
+int sys_kill(pid_t pid, int sig)
+{
+    if (sig < MINSIG || sig > MAXSIG)
+        return EOF;
+
+    if (pid > 0)
+    {
+        task_t *task = get_task(pid);
+        if (!task)
+            return EOF;
+        return task_kill(task, sig);
+    }
+
+    if (pid == -1)
+        return EOF;
+
+    pid_t pgid = pid ? -pid : running_task()->pgid;
+    int ret = EOF;
+    for (task_t *task = pgrp_next(pgid, NULL); task; task = pgrp_next(pgid, task))
+    {
+        if (task->state != TASK_DIED && task_kill(task, sig) == EOK)
+            ret = EOK;
+    }
+    return ret;
+}
+
 // 内核信号处理函数
 void task_signal()
 {
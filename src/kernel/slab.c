@@ -0,0 +1,197 @@
+#include <onix/slab.h>
+#include <onix/memory.h>
+#include <onix/string.h>
+#include <onix/assert.h>
+#include <onix/debug.h>
+
+#define LOGK(fmt, args...) DEBUGK(fmt, ##args)
+
+#define KMEM_EMPTY_MAX 1 // 每个缓存保留的空闲页数量
+
+static kmem_cache_t caches[KMEM_CACHE_NR];
+static u32 cache_count = 0;
+
+// 对象中的空闲链接
+#define OBJECT_LINK(cache, object) (*(void **)((u32)(object) + (cache)->link))
+
+// 将结点插入链表头，不做查重，保证 O(1)
+static _inline void slab_move(list_t *list, slab_t *slab)
+{
+    if (slab->node.next)
+        list_remove(&slab->node);
+    list_insert_after(&list->head, &slab->node);
+}
+
+static slab_t *get_object_slab(void *object)
+{
+    return (slab_t *)((u32)object & 0xfffff000);
+}
+
+// 内存回收，释放所有缓存中的空闲页
+static u32 kmem_shrink(u32 count)
+{
+    u32 freed = 0;
+    for (size_t i = 0; i < cache_count && freed < count; i++)
+    {
+        kmem_cache_t *cache = &caches[i];
+        while (freed < count && !list_empty(&cache->empty))
+        {
+            slab_t *slab = element_entry(slab_t, node, list_pop(&cache->empty));
+            assert(slab->inuse == 0);
+            slab->magic = 0;
+            free_kpage((u32)slab, 1);
+
+            cache->idle--;
+            cache->pages--;
+            cache->shrinks++;
+            freed++;
+        }
+    }
+    return freed;
+}
+
+// 创建缓存只初始化描述符，不申请内存，可以在内存初始化之前调用
+kmem_cache_t *kmem_cache_create(const char *name, size_t size, kmem_ctor_t ctor)
+{
+    assert(cache_count < KMEM_CACHE_NR);
+    assert(size > 0);
+
+    // 第一个缓存创建时注册回收函数
+    if (!cache_count)
+        shrinker_register(ZONE_KERNEL, kmem_shrink);
+
+    kmem_cache_t *cache = &caches[cache_count++];
+    memset(cache, 0, sizeof(kmem_cache_t));
+    strncpy(cache->name, name, KMEM_NAME_LEN);
+    cache->name[KMEM_NAME_LEN - 1] = EOS;
+
+    // 对象按 4 字节对齐
+    cache->size = (size + 3) & ~3;
+    cache->ctor = ctor;
+
+    // 有构造函数的对象，空闲链接放在对象之后，不破坏构造好的内容
+    if (ctor)
+    {
+        cache->link = cache->size;
+        cache->stride = cache->size + sizeof(void *);
+    }
+    else
+    {
+        cache->link = 0;
+        cache->stride = cache->size;
+    }
+
+    cache->count = (PAGE_SIZE - sizeof(slab_t)) / cache->stride;
+    assert(cache->count > 0);
+
+    list_init(&cache->partial);
+    list_init(&cache->full);
+    list_init(&cache->empty);
+    return cache;
+}
+
+// 申请新页，构造页中所有对象
+static slab_t *kmem_cache_grow(kmem_cache_t *cache)
+{
+    // 对象缓存的调用者不检查返回值，内核内存耗尽无法恢复
+    slab_t *slab = (slab_t *)alloc_kpage(1);
+    if (!slab)
+        panic("Out of kernel memory!!!");
+    slab->node.next = NULL;
+    slab->node.prev = NULL;
+    slab->cache = cache;
+    slab->inuse = 0;
+    slab->free = NULL;
+    slab->magic = ONIX_MAGIC;
+
+    void *object = (void *)(slab + 1) + cache->stride * (cache->count - 1);
+    for (int i = cache->count - 1; i >= 0; i--, object -= cache->stride)
+    {
+        if (cache->ctor)
+            cache->ctor(object);
+        OBJECT_LINK(cache, object) = slab->free;
+        slab->free = object;
+    }
+
+    cache->pages++;
+    cache->grows++;
+    return slab;
+}
+
+void *kmem_cache_alloc(kmem_cache_t *cache)
+{
+    slab_t *slab;
+    if (!list_empty(&cache->partial))
+    {
+        slab = element_entry(slab_t, node, cache->partial.head.next);
+    }
+    else if (!list_empty(&cache->empty))
+    {
+        slab = element_entry(slab_t, node, cache->empty.head.next);
+        slab_move(&cache->partial, slab);
+        cache->idle--;
+    }
+    else
+    {
+        slab = kmem_cache_grow(cache);
+        slab_move(&cache->partial, slab);
+    }
+
+    assert(slab->magic == ONIX_MAGIC && slab->free);
+
+    void *object = slab->free;
+    slab->free = OBJECT_LINK(cache, object);
+    slab->inuse++;
+
+    if (slab->inuse == cache->count)
+        slab_move(&cache->full, slab);
+
+    cache->active++;
+    cache->allocs++;
+    return object;
+}
+
+void kmem_cache_free(kmem_cache_t *cache, void *object)
+{
+    assert(object);
+
+    slab_t *slab = get_object_slab(object);
+    assert(slab->magic == ONIX_MAGIC);
+    assert(slab->cache == cache);
+    assert(slab->inuse > 0);
+
+    OBJECT_LINK(cache, object) = slab->free;
+    slab->free = object;
+
+    if (slab->inuse == cache->count)
+        slab_move(&cache->partial, slab);
+
+    slab->inuse--;
+    cache->active--;
+    cache->frees++;
+
+    if (slab->inuse)
+        return;
+
+    // 空闲页足够多，则将该页还给内核
+    if (cache->idle >= KMEM_EMPTY_MAX)
+    {
+        list_remove(&slab->node);
+        slab->magic = 0;
+        free_kpage((u32)slab, 1);
+        cache->pages--;
+        cache->shrinks++;
+        return;
+    }
+
+    slab_move(&cache->empty, slab);
+    cache->idle++;
+}
+
+kmem_cache_t *kmem_cache_next(kmem_cache_t *cache)
+{
+    u32 idx = cache ? cache - caches + 1 : 0;
+    if (idx >= cache_count)
+        return NULL;
+    return &caches[idx];
+}
@@ -0,0 +1,456 @@
+#include <onix/smp.h>
+#include <onix/apic.h>
+#include <onix/task.h>
+#include <onix/mutex.h>
+#include <onix/interrupt.h>
+#include <onix/memory.h>
+#include <onix/clock.h>
+#include <onix/cpu.h>
+#include <onix/string.h>
+#include <onix/debug.h>
+#include <onix/assert.h>
+
+#define LOGK(fmt, args...) DEBUGK(fmt, ##args)
+
+#define MP_CPU 0    // 处理器表项
+#define MP_BUS 1    // 总线表项
+#define MP_IOAPIC 2 // IOAPIC 表项
+#define MP_INTR 3   // IO 中断表项
+
+#define MP_IMCRP 0x80 // features[1]，有中断模式控制寄存器
+
+#define MP_INTR_INT 0 // 向量中断
+
+#define MP_POLARITY_HIGH 0b01   // 高电平有效
+#define MP_POLARITY_LOW 0b11    // 低电平有效
+#define MP_TRIGGER_EDGE 0b0100  // 边沿触发
+#define MP_TRIGGER_LEVEL 0b1100 // 电平触发
+
+#define MP_CPU_ENABLED 0b01 // 处理器可用
+#define MP_CPU_BSP 0b10     // 启动处理器
+
+#define MP_IOAPIC_ENABLED 0b01 // IOAPIC 可用
+
+#define AP_STARTUP_TIMEOUT (100 * NSEC_PER_MSEC) // 应用处理器启动超时
+
+// MultiProcessor Specification 1.4
+// 浮点结构，BIOS 放在扩展数据区的第一个 1K，或者 0xF0000 ~ 0xFFFFF 中
+typedef struct mp_float_t
+{
+    char signature[4]; // "_MP_"
+    u32 config;        // 配置表物理地址
+    u8 length;         // 以 16 字节为单位的长度
+    u8 version;        // 版本
+    u8 checksum;       // 校验和，所有字节之和为 0
+    u8 features[5];    // 特性，features[0] 不为 0 表示使用默认配置
+} _packed mp_float_t;
+
+// 配置表头，之后是 count 个表项
+typedef struct mp_config_t
+{
+    char signature[4]; // "PCMP"
+    u16 length;        // 包括表项的长度
+    u8 version;        // 版本
+    u8 checksum;       // 校验和
+    char oem[8];       // 制造商
+    char product[12];  // 产品
+    u32 oem_table;     // 制造商表地址
+    u16 oem_length;    // 制造商表长度
+    u16 count;         // 表项数量
+    u32 lapic;         // 本地 APIC 物理地址
+    u16 ext_length;    // 扩展表长度
+    u8 ext_checksum;   // 扩展表校验和
+    u8 reserved;
+} _packed mp_config_t;
+
+// 处理器表项，其他表项都是 8 个字节
+typedef struct mp_cpu_t
+{
+    u8 type;       // MP_CPU
+    u8 apic_id;    // 本地 APIC 编号
+    u8 version;    // 本地 APIC 版本
+    u8 flags;      // 是否可用，是否是启动处理器
+    u32 signature; // 处理器型号
+    u32 features;  // cpuid 特性
+    u32 reserved[2];
+} _packed mp_cpu_t;
+
+// 总线表项
+typedef struct mp_bus_t
+{
+    u8 type;      // MP_BUS
+    u8 bus_id;    // 总线编号
+    char name[6]; // 总线类型，"ISA   " 或 "PCI   "
+} _packed mp_bus_t;
+
+// IOAPIC 表项
+typedef struct mp_ioapic_t
+{
+    u8 type;    // MP_IOAPIC
+    u8 apic_id; // IOAPIC 编号
+    u8 version; // 版本
+    u8 flags;   // 是否可用
+    u32 addr;   // 物理地址
+} _packed mp_ioapic_t;
+
+// IO 中断表项，描述总线上的中断连接的 IOAPIC 引脚
+typedef struct mp_intr_t
+{
+    u8 type;      // MP_INTR
+    u8 intr_type; // 中断类型
+    u16 flags;    // 极性和触发方式，为 0 时与总线一致
+    u8 src_bus;   // 源总线编号
+    u8 src_irq;   // 源总线中断，PCI 总线是设备号和引脚
+    u8 dst_apic;  // 目的 IOAPIC 编号
+    u8 dst_pin;   // 目的 IOAPIC 引脚
+} _packed mp_intr_t;
+
+cpu_t cpus[CPU_NR];
+u32 cpu_count = 1;
+
+static spinlock_t big_kernel_lock;
+
+extern pointer_t gdt_ptr;
+extern u8 ap_trampoline[];
+extern u8 ap_trampoline_end[];
+extern pointer_t ap_gdt_ptr;
+extern u32 ap_cr0;
+extern u32 ap_cr4;
+extern u32 ap_stack;
+
+extern u32 get_cr0();
+extern u32 volatile jiffies;
+
+cpu_t *cpu_current()
+{
+    return running_task()->cpu;
+}
+
+bool smp_idle()
+{
+    cpu_t *current = cpu_current();
+    for (size_t i = 0; i < cpu_count; i++)
+    {
+        cpu_t *cpu = &cpus[i];
+        if (cpu != current && cpu->online && !cpu_idle(cpu))
+            return false;
+    }
+    return true;
+}
+
+void kernel_lock()
+{
+    assert(!get_interrupt_state());
+    cpu_t *cpu = cpu_current();
+    if (cpu->locked)
+        return;
+    spin_lock(&big_kernel_lock);
+    cpu->locked = true;
+}
+
+void kernel_unlock()
+{
+    assert(!get_interrupt_state());
+    cpu_t *cpu = cpu_current();
+    assert(cpu->locked);
+    cpu->locked = false;
+    spin_unlock(&big_kernel_lock);
+}
+
+void kernel_lock_relax()
+{
+    if (cpu_count == 1)
+        return;
+
+    bool intr = interrupt_disable();
+    kernel_unlock();
+    asm volatile("rep; nop\n");
+    kernel_lock();
+    set_interrupt_state(intr);
+}
+
+// 初始化启动处理器，在内核初始化的最开始调用
+// 启动处理器从开机开始就持有大内核锁
+void cpu_setup()
+{
+    cpu_t *cpu = &cpus[0];
+    cpu->id = 0;
+    cpu->online = true;
+    cpu->current = running_task();
+    cpu->current->cpu = cpu;
+
+    spin_init(&big_kernel_lock);
+    spin_lock(&big_kernel_lock);
+    cpu->locked = true;
+
+    tss_init(cpu);
+}
+
+static bool mp_checksum(void *addr, u32 length)
+{
+    u8 sum = 0;
+    for (size_t i = 0; i < length; i++)
+    {
+        sum += ((u8 *)addr)[i];
+    }
+    return sum == 0;
+}
+
+// 在 [start, start + length) 中按 16 字节对齐查找浮点结构
+static mp_float_t *mp_search(u32 start, u32 length)
+{
+    for (u32 addr = start; addr < start + length; addr += 16)
+    {
+        mp_float_t *mp = (mp_float_t *)addr;
+        if (memcmp(mp->signature, "_MP_", 4))
+            continue;
+        if (mp_checksum(mp, mp->length * 16))
+            return mp;
+    }
+    return NULL;
+}
+
+// 按照表项的极性和触发方式设置 irq，默认值与总线一致
+static void mp_route(mp_intr_t *item, u32 irq, bool pci)
+{
+    u32 flags = pci ? IOAPIC_LOW | IOAPIC_LEVEL : 0;
+
+    if ((item->flags & 0b11) == MP_POLARITY_HIGH)
+        flags &= ~IOAPIC_LOW;
+    else if ((item->flags & 0b11) == MP_POLARITY_LOW)
+        flags |= IOAPIC_LOW;
+
+    if ((item->flags & 0b1100) == MP_TRIGGER_EDGE)
+        flags &= ~IOAPIC_LEVEL;
+    else if ((item->flags & 0b1100) == MP_TRIGGER_LEVEL)
+        flags |= IOAPIC_LEVEL;
+
+    ioapic_route(irq, item->dst_pin, flags);
+}
+
+// 记录 IO 中断表项，只使用第一个 IOAPIC
+// PCI 设备的中断线号由 BIOS 设置为连接的引脚号，所以按引脚号作为 irq
+static void mp_intr(mp_intr_t *item, u8 ioapic_id, u32 isa_buses)
+{
+    if (item->intr_type != MP_INTR_INT || item->dst_apic != ioapic_id)
+        return;
+
+    bool isa = item->src_bus < 32 && (isa_buses & (1 << item->src_bus));
+    if (isa && item->src_irq < 16)
+        mp_route(item, item->src_irq, false);
+    else if (!isa && item->dst_pin < 16)
+        mp_route(item, item->dst_pin, true);
+}
+
+// 从 MP 配置表得到处理器，本地 APIC 和 IOAPIC 的地址，以及中断的连接方式
+// 第 0 页没有映射，不能从 BIOS 数据区读取扩展数据区的位置，只查找常见的位置
+static u32 mp_parse(u32 *ioapic, bool *imcr)
+{
+    mp_float_t *mp = mp_search(0x9FC00, 0x400);
+    if (!mp)
+        mp = mp_search(0xF0000, 0x10000);
+    if (!mp || !mp->config || mp->features[0])
+        return 0;
+
+    mp_config_t *config = (mp_config_t *)mp->config;
+    if (mp->config >= KERNEL_MEMORY_SIZE ||
+        memcmp(config->signature, "PCMP", 4) ||
+        !mp_checksum(config, config->length))
+        return 0;
+
+    *imcr = mp->features[1] & MP_IMCRP;
+
+    // 表项按照类型排序，总线和 IOAPIC 在中断之前
+    u32 isa_buses = 0;
+    u8 ioapic_id = 0;
+    u8 *entry = (u8 *)(config + 1);
+    for (size_t i = 0; i < config->count; i++)
+    {
+        if (*entry == MP_BUS)
+        {
+            mp_bus_t *bus = (mp_bus_t *)entry;
+            if (bus->bus_id < 32 && !memcmp(bus->name, "ISA", 3))
+                isa_buses |= 1 << bus->bus_id;
+        }
+        else if (*entry == MP_IOAPIC)
+        {
+            mp_ioapic_t *item = (mp_ioapic_t *)entry;
+            if ((item->flags & MP_IOAPIC_ENABLED) && !*ioapic)
+            {
+                *ioapic = item->addr;
+                ioapic_id = item->apic_id;
+            }
+        }
+        else if (*entry == MP_INTR && *ioapic)
+        {
+            mp_intr((mp_intr_t *)entry, ioapic_id, isa_buses);
+        }
+
+        if (*entry != MP_CPU)
+        {
+            entry += 8;
+            continue;
+        }
+
+        mp_cpu_t *item = (mp_cpu_t *)entry;
+        entry += sizeof(mp_cpu_t);
+        if (!(item->flags & MP_CPU_ENABLED))
+            continue;
+
+        if (item->flags & MP_CPU_BSP)
+        {
+            cpus[0].apic_id = item->apic_id;
+            continue;
+        }
+
+        if (cpu_count == CPU_NR)
+        {
+            LOGK("too many cpus, apic %d ignored\n", item->apic_id);
+            continue;
+        }
+
+        cpu_t *cpu = &cpus[cpu_count];
+        cpu->id = cpu_count++;
+        cpu->apic_id = item->apic_id;
+    }
+    return config->lapic;
+}
+
+// 应用处理器的时间片，和启动处理器的时钟中断一样，时间片用完时调度
+static void apic_timer_handler(int vector)
+{
+    assert(vector == INTR_APIC_TIMER);
+    lapic_eoi();
+
+    task_t *task = running_task();
+    assert(task->magic == ONIX_MAGIC);
+
+    task->jiffies = jiffies;
+    task->ticks--;
+    if (task->ticks <= 0)
+    {
+        preempt_schedule();
+    }
+}
+
+// 其他处理器在当前处理器空闲时加入了就绪任务
+static void reschedule_handler(int vector)
+{
+    assert(vector == INTR_RESCHEDULE);
+    lapic_eoi();
+    preempt_schedule();
+}
+
+// 伪中断不需要结束
+static void spurious_handler(int vector)
+{
+}
+
+// 应用处理器进入内核的入口，栈是启动处理器准备的启动页
+// 和启动处理器一样，启动页作为最初的任务，调度到空闲任务之后不再使用
+void ap_main()
+{
+    cpu_t *cpu = running_task()->cpu;
+
+    asm volatile("lidt idt_ptr\n");
+    tss_init(cpu);
+    lapic_init(false);
+    lapic_timer_start(INTR_APIC_TIMER);
+
+    cpu->online = true;
+
+    kernel_lock();
+    LOGK("cpu %d apic %d online\n", cpu->id, cpu->apic_id);
+
+    schedule();
+    panic("cpu %d should not be here!!!", cpu->id);
+}
+
+// 启动应用处理器，返回是否成功
+static bool ap_startup(cpu_t *cpu)
+{
+    // 启动页，用作处理器最初的任务和栈
+    task_t *task = (task_t *)alloc_kpage(1);
+    assert(task);
+    memset(task, 0, PAGE_SIZE);
+    task->cpu = cpu;
+    task->priority = 1;
+    task->ticks = 1;
+    task->pde = KERNEL_PAGE_DIR;
+    task->magic = ONIX_MAGIC;
+
+    cpu->current = task;
+    task_idle_create(cpu);
+
+    ap_gdt_ptr = gdt_ptr;
+    ap_cr0 = get_cr0();
+    ap_cr4 = get_cr4();
+    ap_stack = (u32)task + PAGE_SIZE;
+    memcpy((void *)AP_TRAMPOLINE, ap_trampoline, ap_trampoline_end - ap_trampoline);
+
+    lapic_startup(cpu->apic_id, AP_TRAMPOLINE);
+
+    // 处理器启动之后才能再次使用启动代码
+    u64 expires = clock_monotonic() + AP_STARTUP_TIMEOUT;
+    while (!cpu->online)
+    {
+        if (clock_monotonic() > expires)
+            return false;
+    }
+    return true;
+}
+
+// 解析 MP 配置表，初始化本地 APIC，有 IOAPIC 时外部中断改由 IOAPIC 传递
+// 需要在中断初始化之后，打开任何外部中断之前调用，没有配置表时继续使用 8259
+void mp_init()
+{
+    u32 ioapic = 0;
+    bool imcr = false;
+    u32 lapic = mp_parse(&ioapic, &imcr);
+    if (!lapic)
+    {
+        LOGK("MP configuration table not found, single cpu\n");
+        cpu_count = 1;
+        return;
+    }
+
+    lapic_map(lapic);
+    lapic_init(!ioapic);
+    assert(lapic_id() == cpus[0].apic_id);
+
+    set_apic_handler(INTR_APIC_TIMER, apic_timer_handler);
+    set_apic_handler(INTR_RESCHEDULE, reschedule_handler);
+    set_apic_handler(INTR_SPURIOUS, spurious_handler);
+
+    if (!ioapic)
+    {
+        LOGK("IOAPIC not found, use 8259 PIC\n");
+        return;
+    }
+    ioapic_map(ioapic);
+    ioapic_enable(imcr);
+}
+
+// 启动其他处理器，需要在任务初始化之后调用
+// 其他处理器启动之后等待大内核锁，直到启动处理器完成初始化
+void smp_init()
+{
+    if (cpu_count == 1)
+        return;
+
+    lapic_timer_calibrate();
+
+    u32 online = 1;
+    for (size_t i = 1; i < cpu_count; i++)
+    {
+        cpu_t *cpu = &cpus[i];
+        if (!ap_startup(cpu))
+        {
+            // 启动代码可能还在使用，不再启动其他处理器
+            LOGK("cpu %d apic %d startup failure\n", cpu->id, cpu->apic_id);
+            break;
+        }
+        online++;
+    }
+    LOGK("%d of %d cpus online\n", online, cpu_count);
+}
@@ -0,0 +1,167 @@
+#include <onix/softirq.h>
+#include <onix/interrupt.h>
+#include <onix/task.h>
+#include <onix/errno.h>
+#include <onix/debug.h>
+#include <onix/assert.h>
+
+#define LOGK(fmt, args...) DEBUGK(fmt, ##args)
+
+#define SOFTIRQ_RESTART 10 // 中断返回时最多执行的轮数
+
+static void (*softirq_handlers[SOFTIRQ_NR])();
+
+static u32 volatile softirq_pending; // 等待执行的软中断位图
+static bool softirq_active;          // 正在执行软中断，避免嵌套的中断重复进入，执行期间禁止抢占
+
+static list_t tasklet_lists[SOFTIRQ_NR]; // 小任务链表，只使用 HI 和 TASKLET 两项
+
+static task_t *softirq_task; // 软中断线程
+
+void softirq_register(u32 nr, void (*handler)())
+{
+    assert(nr < SOFTIRQ_NR);
+    softirq_handlers[nr] = handler;
+}
+
+void softirq_raise(u32 nr)
+{
+    assert(nr < SOFTIRQ_NR);
+    bool intr = interrupt_disable();
+    softirq_pending |= 1 << nr;
+    set_interrupt_state(intr);
+}
+
+// 打开中断执行一轮软中断，执行期间的中断可以再次标记软中断
+static void softirq_round()
+{
+    u32 pending = softirq_pending;
+    softirq_pending = 0;
+
+    set_interrupt_state(true);
+    for (size_t nr = 0; nr < SOFTIRQ_NR; nr++)
+    {
+        if (pending & (1 << nr))
+            softirq_handlers[nr]();
+    }
+    set_interrupt_state(false);
+}
+
+void softirq_run()
+{
+    assert(!get_interrupt_state());
+    if (!softirq_pending || softirq_active)
+        return;
+
+    // 执行期间嵌套的中断需要调度时推迟到执行结束，否则切换走的任务会一直占着 softirq_active
+    preempt_disable();
+    softirq_active = true;
+    for (size_t i = 0; i < SOFTIRQ_RESTART && softirq_pending; i++)
+    {
+        softirq_round();
+    }
+    softirq_active = false;
+
+    // 软中断太多，交给线程执行，避免被中断的任务一直无法执行
+    if (softirq_pending && softirq_task->state == TASK_WAITING)
+    {
+        task_unblock(softirq_task, EOK);
+    }
+    preempt_enable();
+}
+
+// 软中断线程，每执行一轮让出一次执行权
+static void softirq_thread()
+{
+    set_interrupt_state(false);
+    while (true)
+    {
+        if (!softirq_pending)
+        {
+            task_block(softirq_task, NULL, TASK_WAITING, TIMELESS);
+            continue;
+        }
+        if (!softirq_active)
+        {
+            preempt_disable();
+            softirq_active = true;
+            softirq_round();
+            softirq_active = false;
+            preempt_enable();
+        }
+        task_yield();
+    }
+}
+
+void tasklet_init(tasklet_t *tasklet, void (*handler)(tasklet_t *), void *arg)
+{
+    tasklet->node.next = NULL;
+    tasklet->node.prev = NULL;
+    tasklet->handler = handler;
+    tasklet->arg = arg;
+    tasklet->scheduled = false;
+}
+
+static void tasklet_enqueue(tasklet_t *tasklet, u32 nr)
+{
+    bool intr = interrupt_disable();
+    if (!tasklet->scheduled)
+    {
+        tasklet->scheduled = true;
+        list_push(&tasklet_lists[nr], &tasklet->node);
+        softirq_pending |= 1 << nr;
+    }
+    set_interrupt_state(intr);
+}
+
+void tasklet_schedule(tasklet_t *tasklet)
+{
+    tasklet_enqueue(tasklet, SOFTIRQ_TASKLET);
+}
+
+void tasklet_hi_schedule(tasklet_t *tasklet)
+{
+    tasklet_enqueue(tasklet, SOFTIRQ_HI);
+}
+
+// 按调度的顺序执行小任务，执行之前清除调度标记，执行期间可以再次调度
+static void tasklet_run(list_t *list)
+{
+    while (true)
+    {
+        bool intr = interrupt_disable();
+        if (list_empty(list))
+        {
+            set_interrupt_state(intr);
+            return;
+        }
+        tasklet_t *tasklet = element_entry(tasklet_t, node, list_popback(list));
+        tasklet->scheduled = false;
+        set_interrupt_state(intr);
+
+        tasklet->handler(tasklet);
+    }
+}
+
+static void tasklet_hi_action()
+{
+    tasklet_run(&tasklet_lists[SOFTIRQ_HI]);
+}
+
+static void tasklet_action()
+{
+    tasklet_run(&tasklet_lists[SOFTIRQ_TASKLET]);
+}
+
+// 需要在任务初始化之后调用
+void softirq_init()
+{
+    for (size_t nr = 0; nr < SOFTIRQ_NR; nr++)
+    {
+        list_init(&tasklet_lists[nr]);
+    }
+    softirq_register(SOFTIRQ_HI, tasklet_hi_action);
+    softirq_register(SOFTIRQ_TASKLET, tasklet_action);
+
+    softirq_task = task_create(softirq_thread, "softirqd", 5, KERNEL_USER);
+}
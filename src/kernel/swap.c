@@ -0,0 +1,138 @@
+#include <onix/swap.h>
+#include <onix/memory.h>
+#include <onix/device.h>
+#include <onix/fs.h>
+#include <onix/stat.h>
+#include <onix/string.h>
+#include <onix/stdlib.h>
+#include <onix/assert.h>
+#include <onix/debug.h>
+#include <onix/errno.h>
+
+#define LOGK(fmt, args...) DEBUGK(fmt, ##args)
+
+#define SWAP_SLOT_MAX (1 << 20) // 页表项中槽位只有 20 位
+
+static bool swap_enable = false; // 是否已启用交换区
+static dev_t swap_dev;           // 交换设备
+static u32 swap_sectors;         // 每个槽位的扇区数
+static u32 swap_count;           // 槽位数量
+static u32 swap_used;            // 已使用的槽位数量
+static u32 swap_next;            // 下次开始查找空闲槽位的位置
+static u8 *swap_map;             // 槽位引用计数
+
+u32 swap_alloc()
+{
+    if (!swap_enable || swap_used == swap_count)
+        return 0;
+
+    for (size_t i = 0; i < swap_count; i++)
+    {
+        u32 slot = swap_next;
+        swap_next = (swap_next + 1) % swap_count;
+        if (swap_map[slot])
+            continue;
+
+        swap_map[slot] = 1;
+        swap_used++;
+        return slot;
+    }
+    panic("swap map is corrupted!!!");
+}
+
+void swap_dup(u32 slot)
+{
+    assert(slot > 0 && slot < swap_count);
+    assert(swap_map[slot] > 0 && swap_map[slot] < 255);
+    swap_map[slot]++;
+}
+
+void swap_free(u32 slot)
+{
+    assert(slot > 0 && slot < swap_count);
+    assert(swap_map[slot] > 0);
+    swap_map[slot]--;
+    if (!swap_map[slot])
+        swap_used--;
+}
+
+u32 swap_avail()
+{
+    if (!swap_enable)
+        return 0;
+    return swap_count - swap_used;
+}
+
+err_t swap_read(u32 slot, void *page)
+{
+    assert(swap_map[slot] > 0);
+    return device_request(swap_dev, page, swap_sectors, slot * swap_sectors, 0, REQ_READ);
+}
+
+err_t swap_write(u32 slot, void *page)
+{
+    assert(swap_map[slot] > 0);
+    return device_request(swap_dev, page, swap_sectors, slot * swap_sectors, 0, REQ_WRITE);
+}
+
+// 启用块设备 devname 作为交换区，设备原有的数据会被覆盖
+int sys_swapon(char *devname)
+{
+    LOGK("swapon %s\n", devname);
+
+    if (swap_enable)
+        return -EBUSY;
+
+    inode_t *inode = namei(devname);
+    if (!inode)
+        return -ENOENT;
+
+    int ret = EOK;
+    if (!ISBLK(inode->mode))
+    {
+        ret = -EPERM;
+        goto rollback;
+    }
+
+    dev_t dev = inode->rdev;
+    if (dev == 0)
+    {
+        ret = -ENOSYS;
+        goto rollback;
+    }
+
+    u32 sector_size = device_ioctl(dev, DEV_CMD_SECTOR_SIZE, 0, 0);
+    u32 sector_count = device_ioctl(dev, DEV_CMD_SECTOR_COUNT, 0, 0);
+    if (sector_size > PAGE_SIZE)
+    {
+        ret = -EINVAL;
+        goto rollback;
+    }
+
+    u32 count = MIN(sector_count / (PAGE_SIZE / sector_size), SWAP_SLOT_MAX);
+    if (count < 2)
+    {
+        ret = -EINVAL;
+        goto rollback;
+    }
+
+    swap_map = (u8 *)alloc_kpage(div_round_up(count, PAGE_SIZE));
+    assert(swap_map);
+    memset(swap_map, 0, count);
+
+    // 第 0 个槽位保留，槽位为 0 表示没有换出
+    swap_map[0] = 1;
+    swap_used = 1;
+    swap_next = 1;
+
+    swap_dev = dev;
+    swap_sectors = PAGE_SIZE / sector_size;
+    swap_count = count;
+    swap_enable = true;
+
+    LOGK("swap device %d slots %d\n", dev, count);
+
+rollback:
+    iput(inode);
+    return ret;
+}
@@ -1,8 +1,6 @@
 #include <onix/task.h>
 #include <onix/errno.h>
 
-extern task_t *task_table[TASK_NR];
-
 mode_t sys_umask(mode_t mask)
 {
     task_t *task = running_task();
@@ -21,21 +19,15 @@ int sys_setpgid(int pid, int pgid)
     if (!pgid)
         pgid = current->pid;
 
-    for (int i = 0; i < TASK_NR; i++)
-    {
-        task_t *task = task_table[i];
-        if (!task)
-            continue;
-        if (task->pid != pid)
-            continue;
-        if (task_leader(task))
-            return -EPERM;
-        if (task->sid != current->sid)
-            return -EPERM;
-        task->pgid = pgid;
-        return EOK;
-    }
-    return -ESRCH;
+    task_t *task = get_task(pid);
+    if (!task)
+        return -ESRCH;
+    if (task_leader(task))
+        return -EPERM;
+    if (task->sid != current->sid)
+        return -EPERM;
+    task_set_pgid(task, pgid);
+    return EOK;
 }
 
 int sys_getpgrp()
@@ -49,6 +41,7 @@ int sys_setsid()
     task_t *task = running_task();
     if (task_leader(task))
         return -EPERM;
-    task->sid = task->pgid = task->pid;
+    task_set_sid(task, task->pid);
+    task_set_pgid(task, task->pid);
     return task->sid;
 }
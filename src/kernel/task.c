@@ -5,6 +5,7 @@
 #include <onix/assert.h>
 #include <onix/interrupt.h>
 #include <onix/string.h>
+#include <onix/stdlib.h>
 #include <onix/bitmap.h>
 #include <onix/syscall.h>
 #include <onix/list.h>
@@ -16,49 +17,158 @@
 #include <onix/device.h>
 #include <onix/tty.h>
 #include <onix/fpu.h>
+#include <onix/spawn.h>
+#include <onix/smp.h>
+#include <onix/apic.h>
 
 #define LOGK(fmt, args...) DEBUGK(fmt, ##args)
 
 extern u32 volatile jiffies;
 extern u32 jiffy;
-extern bitmap_t kernel_map;
-extern tss_t tss;
 extern file_t file_table[];
 
 extern void task_switch(task_t *next);
+extern void idle_thread();
+
+list_t task_list;         // 所有任务，按创建顺序排列
+static list_t block_list; // 任务默认阻塞链表
+static list_t sleep_list; // 任务睡眠链表
+
+static list_t pid_hash[PID_HASH_NR];     // pid 哈希表
+static list_t pgrp_hash[PID_HASH_NR];    // 进程组哈希表，按 pgid 链接组中的进程
+static list_t session_hash[PID_HASH_NR]; // 会话哈希表，按 sid 链接会话中的进程
 
-task_t *task_table[TASK_NR]; // 任务表
-static list_t block_list;    // 任务默认阻塞链表
-static list_t sleep_list;    // 任务睡眠链表
+static u32 task_count = 0;  // 任务数量，包括还没有回收的僵尸进程
+static pid_t last_pid = -1; // 上次分配的 pid，第一个任务是空闲任务，pid 为 0
 
-static task_t *idle_task;
+#define PID_HASH(pid) ((u32)(pid) % PID_HASH_NR)
+
+// 就绪队列，每个优先级一个链表，位图记录非空的链表
+// 每个处理器一个就绪队列，处理器只从自己的队列中取任务
+typedef struct run_queue_t
+{
+    list_t lists[TASK_PRIORITY_NR]; // 就绪链表，同一优先级先进先出
+    u32 bitmap;                     // 非空链表位图
+    u32 count;                      // 就绪任务数量，不包括空闲任务
+} run_queue_t;
+
+static run_queue_t run_queues[CPU_NR];
+
+// 获得 pid 对应的 task
+task_t *get_task(pid_t pid)
+{
+    list_t *list = &pid_hash[PID_HASH(pid)];
+    for (list_node_t *node = list->head.next; node != &list->tail; node = node->next)
+    {
+        task_t *task = element_entry(task_t, hnode, node);
+        if (task->pid == pid)
+            return task;
+    }
+    return NULL;
+}
+
+// 分配一个没有使用的 pid，从上次分配的位置向后查找，到 PID_MAX 之后回绕
+static pid_t pid_alloc()
+{
+    // 任务数量少于 PID_MAX，一定能找到
+    while (true)
+    {
+        last_pid = (last_pid + 1) % PID_MAX;
+        if (!get_task(last_pid))
+            return last_pid;
+    }
+}
 
-// 从 task_table 里获得一个空闲的任务
+// 分配任务的内核页和 pid，任务数量达到上限或内核内存不足返回 NULL
+// 任务初始化完成之后需要调用 task_link 加入任务链表
 static task_t *get_free_task()
 {
-    for (size_t i = 0; i < TASK_NR; i++)
+    if (task_count >= TASK_NR)
+        return NULL;
+
+    task_t *task = (task_t *)alloc_kpage(1);
+    if (!task)
+        return NULL;
+    memset(task, 0, PAGE_SIZE);
+    task->pid = pid_alloc();
+    task_count++;
+    return task;
+}
+
+// 任务加入任务链表和各个哈希表，parent 不为空时加入其子进程链表
+static void task_link(task_t *task, task_t *parent)
+{
+    list_insert_before(&task_list.tail, &task->tnode);
+    list_insert_before(&pid_hash[PID_HASH(task->pid)].tail, &task->hnode);
+    list_insert_before(&pgrp_hash[PID_HASH(task->pgid)].tail, &task->pgnode);
+    list_insert_before(&session_hash[PID_HASH(task->sid)].tail, &task->snode);
+
+    list_init(&task->children);
+    task->sibling.next = task->sibling.prev = NULL;
+    if (parent)
+        list_insert_before(&parent->children.tail, &task->sibling);
+}
+
+// 回收任务，从所有链表中删除，释放内核页
+static void task_free(task_t *task)
+{
+    assert(list_empty(&task->children));
+    list_remove(&task->tnode);
+    list_remove(&task->hnode);
+    list_remove(&task->pgnode);
+    list_remove(&task->snode);
+    if (task->sibling.next)
+        list_remove(&task->sibling);
+
+    task_count--;
+    free_kpage((u32)task, 1);
+}
+
+// 放弃还没有加入任务链表的任务，用于 fork 和 spawn 分配失败
+static void task_discard(task_t *task)
+{
+    if (task->pwd)
+        free_kpage((u32)task->pwd, 1);
+    task_count--;
+    free_kpage((u32)task, 1);
+}
+
+void task_set_pgid(task_t *task, pid_t pgid)
+{
+    list_remove(&task->pgnode);
+    task->pgid = pgid;
+    list_insert_before(&pgrp_hash[PID_HASH(pgid)].tail, &task->pgnode);
+}
+
+void task_set_sid(task_t *task, pid_t sid)
+{
+    list_remove(&task->snode);
+    task->sid = sid;
+    list_insert_before(&session_hash[PID_HASH(sid)].tail, &task->snode);
+}
+
+task_t *pgrp_next(pid_t pgid, task_t *task)
+{
+    list_t *list = &pgrp_hash[PID_HASH(pgid)];
+    list_node_t *node = task ? task->pgnode.next : list->head.next;
+    for (; node != &list->tail; node = node->next)
     {
-        if (task_table[i] == NULL)
-        {
-            task_t *task = (task_t *)alloc_kpage(1);
-            memset(task, 0, PAGE_SIZE);
-            task->pid = i;
-            task_table[i] = task;
+        task = element_entry(task_t, pgnode, node);
+        if (task->pgid == pgid)
             return task;
-        }
     }
-    panic("No more tasks");
+    return NULL;
 }
 
-// 获得 pid 对应的 task
-task_t *get_task(pid_t pid)
+task_t *session_next(pid_t sid, task_t *task)
 {
-    for (size_t i = 0; i < TASK_NR; i++)
+    list_t *list = &session_hash[PID_HASH(sid)];
+    list_node_t *node = task ? task->snode.next : list->head.next;
+    for (; node != &list->tail; node = node->next)
     {
-        if (!task_table[i])
-            continue;
-        if (task_table[i]->pid == pid)
-            return task_table[i];
+        task = element_entry(task_t, snode, node);
+        if (task->sid == sid)
+            return task;
     }
     return NULL;
 }
@@ -77,38 +187,157 @@ pid_t sys_getppid()
     return task->ppid;
 }
 
-// 从任务数组中查找某种状态的任务，自己除外
-static task_t *task_search(task_state_t state)
+// 得到字中最高的置位的位置，word 不能为 0
+static _inline u32 bit_scan_reverse(u32 word)
+{
+    u32 index;
+    asm volatile("bsrl %1, %0\n"
+                 : "=r"(index)
+                 : "rm"(word));
+    return index;
+}
+
+// 任务进入就绪状态，加入 task->cpu 就绪队列中对应优先级链表的尾部
+static void task_enqueue(task_t *task)
 {
     assert(!get_interrupt_state());
-    task_t *task = NULL;
-    task_t *current = running_task();
+    assert(task->node.next == NULL && task->node.prev == NULL);
+
+    cpu_t *cpu = task->cpu;
+    run_queue_t *rq = &run_queues[cpu->id];
+    list_t *list = &rq->lists[task->priority];
+    list_insert_before(&list->tail, &task->node);
+    rq->bitmap |= 1 << task->priority;
+    if (task != cpu->idle)
+        rq->count++;
+    task->state = TASK_READY;
+
+    // 处理器正在空闲，通知它调度
+    if (cpu != cpu_current() && cpu->current == cpu->idle)
+        lapic_send_ipi(cpu->apic_id, INTR_RESCHEDULE);
+}
+
+// 从所在的就绪队列中删除任务
+static void task_unqueue(task_t *task)
+{
+    cpu_t *cpu = task->cpu;
+    run_queue_t *rq = &run_queues[cpu->id];
+    list_t *list = &rq->lists[task->priority];
+    list_remove(&task->node);
+    if (list_empty(list))
+        rq->bitmap &= ~(1 << task->priority);
+    if (task != cpu->idle)
+        rq->count--;
+}
+
+// 取出 cpu 就绪队列中最高优先级链表头部的任务
+// 空闲任务的优先级最低，不会阻塞，所以就绪队列总不为空
+static task_t *task_dequeue(cpu_t *cpu)
+{
+    assert(!get_interrupt_state());
+
+    run_queue_t *rq = &run_queues[cpu->id];
+    assert(rq->bitmap);
+
+    u32 priority = bit_scan_reverse(rq->bitmap);
+    task_t *task = element_entry(task_t, node, rq->lists[priority].head.next);
+    task_unqueue(task);
+
+    assert(task->state == TASK_READY);
+    return task;
+}
+
+// 处理器的负载，就绪和正在执行的任务数量，不包括空闲任务
+static u32 cpu_load(cpu_t *cpu)
+{
+    u32 load = run_queues[cpu->id].count;
+    if (cpu->current != cpu->idle)
+        load++;
+    return load;
+}
 
-    for (size_t i = 0; i < TASK_NR; i++)
+bool cpu_idle(cpu_t *cpu)
+{
+    return cpu_load(cpu) == 0;
+}
+
+// 为进入就绪状态的任务选择处理器
+// 上次执行的处理器空闲时优先使用，否则选择一个空闲的处理器，都不空闲时留在原来的处理器
+static cpu_t *task_select_cpu(task_t *task)
+{
+    cpu_t *cpu = task->cpu ? task->cpu : cpu_current();
+    if (cpu_count == 1 || cpu_idle(cpu))
+        return cpu;
+
+    for (size_t i = 0; i < cpu_count; i++)
     {
-        task_t *ptr = task_table[i];
-        if (ptr == NULL)
-            continue;
+        if (cpus[i].online && cpu_idle(&cpus[i]))
+            return &cpus[i];
+    }
+    return cpu;
+}
 
-        if (ptr->state != state)
-            continue;
-        if (current == ptr)
+// 任务进入就绪状态，选择处理器之后加入就绪队列
+static void task_wakeup(task_t *task)
+{
+    task->cpu = task_select_cpu(task);
+    task_enqueue(task);
+}
+
+// 负载均衡，当前处理器比最忙的处理器至少少两个任务时，从中取来优先级最高的任务
+// 在调度时调用，current 还没有加入就绪队列
+static void task_balance(cpu_t *cpu, task_t *current)
+{
+    if (cpu_count == 1)
+        return;
+
+    u32 load = run_queues[cpu->id].count;
+    if (current != cpu->idle && current->state == TASK_RUNNING)
+        load++;
+
+    cpu_t *busiest = NULL;
+    u32 max = load + 1;
+    for (size_t i = 0; i < cpu_count; i++)
+    {
+        cpu_t *other = &cpus[i];
+        if (other == cpu || !other->online || !run_queues[i].count)
             continue;
-        if (task == NULL || task->ticks < ptr->ticks || ptr->jiffies < task->jiffies)
-            task = ptr;
+        if (cpu_load(other) > max)
+        {
+            busiest = other;
+            max = cpu_load(other);
+        }
     }
+    if (!busiest)
+        return;
 
-    if (task == NULL && state == TASK_READY)
+    // 从最高优先级开始查找，跳过空闲任务
+    run_queue_t *rq = &run_queues[busiest->id];
+    for (u32 bitmap = rq->bitmap; bitmap;)
     {
-        task = idle_task;
-    }
+        u32 priority = bit_scan_reverse(bitmap);
+        bitmap &= ~(1 << priority);
 
-    return task;
+        list_t *list = &rq->lists[priority];
+        for (list_node_t *node = list->head.next; node != &list->tail; node = node->next)
+        {
+            task_t *task = element_entry(task_t, node, node);
+            if (task == busiest->idle)
+                continue;
+
+            task_unqueue(task);
+            task->cpu = cpu;
+            task_enqueue(task);
+            return;
+        }
+    }
 }
 
 void task_yield()
 {
     schedule();
+    // 没有其他任务时马上返回，短暂释放大内核锁，让其他处理器进入内核
+    kernel_lock_relax();
 }
 
 bool _inline task_leader(task_t *task)
@@ -116,8 +345,14 @@ bool _inline task_leader(task_t *task)
     return task->sid == task->pid;
 }
 
-// 任务阻塞
-err_t task_block(task_t *task, list_t *blist, task_state_t state, int timeout_ms)
+// 阻塞超时
+static void task_timeout(hrtimer_t *timer)
+{
+    task_unblock((task_t *)timer->arg, -ETIME);
+}
+
+// 任务阻塞直到被唤醒，或者到达 expires 纳秒，expires 为 0 表示不会超时
+err_t task_block_until(task_t *task, list_t *blist, task_state_t state, u64 expires)
 {
     assert(!get_interrupt_state());
     assert(task->node.next == NULL);
@@ -131,10 +366,10 @@ err_t task_block(task_t *task, list_t *blist, task_state_t state, int timeout_ms
     assert(state != TASK_READY && state != TASK_RUNNING);
 
     list_push(blist, &task->node);
-    if (timeout_ms > 0)
+    if (expires)
     {
-        assert(task->timer == NULL);
-        task->timer = timer_add(timeout_ms, NULL, NULL);
+        assert(!hrtimer_active(&task->timer));
+        hrtimer_start(&task->timer, expires);
     }
 
     task->state = state;
@@ -148,31 +383,55 @@ err_t task_block(task_t *task, list_t *blist, task_state_t state, int timeout_ms
     return task->status;
 }
 
+// 任务阻塞
+err_t task_block(task_t *task, list_t *blist, task_state_t state, int timeout_ms)
+{
+    u64 expires = 0;
+    if (timeout_ms > 0)
+    {
+        expires = clock_monotonic() + (u64)timeout_ms * NSEC_PER_MSEC;
+    }
+    return task_block_until(task, blist, state, expires);
+}
+
 // 解除任务阻塞
 void task_unblock(task_t *task, int reason)
 {
     assert(!get_interrupt_state());
 
+    // 已经被唤醒，在就绪队列中等待执行
+    if (task->state == TASK_READY)
+        return;
+
     if (task->node.next)
     {
         list_remove(&task->node);
     }
 
-    if (task->timer)
-    {
-        if (!task->timer->active)
-        {
-            timer_put(task->timer);
-        }
-        task->timer = NULL;
-    }
+    hrtimer_cancel(&task->timer);
 
     assert(task->node.next == NULL);
     assert(task->node.prev == NULL);
 
     assert(task->state != TASK_RUNNING);
     task->status = reason;
-    task->state = TASK_READY;
+    task_wakeup(task);
+}
+
+void task_set_priority(task_t *task, u32 priority)
+{
+    assert(!get_interrupt_state());
+    assert(priority > 0 && priority < TASK_PRIORITY_NR);
+
+    if (task->state != TASK_READY)
+    {
+        task->priority = priority;
+        return;
+    }
+
+    task_unqueue(task);
+    task->priority = priority;
+    task_enqueue(task);
 }
 
 void task_sleep(u32 ms)
@@ -184,6 +443,33 @@ void task_sleep(u32 ms)
     task_block(task, &sleep_list, TASK_SLEEPING, ms);
 }
 
+int sys_nanosleep(const timespec_t *req, timespec_t *rem)
+{
+    task_t *task = running_task();
+    if (!memory_access((void *)req, sizeof(timespec_t), false, task->uid))
+        return -EFAULT;
+    if (rem && !memory_access(rem, sizeof(timespec_t), true, task->uid))
+        return -EFAULT;
+    if (req->tv_nsec < 0 || req->tv_nsec >= NSEC_PER_SEC)
+        return -EINVAL;
+
+    u64 expires = clock_monotonic() + (u64)req->tv_sec * NSEC_PER_SEC + req->tv_nsec;
+    int ret = task_block_until(task, &sleep_list, TASK_SLEEPING, expires);
+    if (ret == -ETIME)
+        return EOK;
+
+    // 被信号打断，返回剩余的时间
+    if (rem)
+    {
+        u64 now = clock_monotonic();
+        u64 left = expires > now ? expires - now : 0;
+        u32 nsec;
+        rem->tv_sec = div64(left, NSEC_PER_SEC, &nsec);
+        rem->tv_nsec = nsec;
+    }
+    return ret;
+}
+
 // 激活任务
 void task_activate(task_t *task)
 {
@@ -197,7 +483,7 @@ void task_activate(task_t *task)
 
     if (task->uid != KERNEL_USER)
     {
-        tss.esp0 = (u32)task + PAGE_SIZE;
+        cpu_current()->tss.esp0 = (u32)task + PAGE_SIZE;
     }
 }
 
@@ -213,22 +499,32 @@ void schedule()
     assert(!get_interrupt_state()); // 不可中断
 
     task_t *current = running_task();
-    task_t *next = task_search(TASK_READY);
+    cpu_t *cpu = current->cpu;
 
-    assert(next != NULL);
-    assert(next->magic == ONIX_MAGIC);
+    assert(!cpu->preempt_count);
+    cpu->need_resched = false;
 
-    if (current->state == TASK_RUNNING)
+    // 禁止抢占期间时间片可能已经减到负数
+    if (current->ticks <= 0)
     {
-        current->state = TASK_READY;
+        current->ticks = current->priority;
     }
 
-    if (!current->ticks)
+    task_balance(cpu, current);
+
+    // 当前任务排到同一优先级的最后，时间片用完或者让出执行权时同优先级的任务轮流执行
+    if (current->state == TASK_RUNNING)
     {
-        current->ticks = current->priority;
+        task_enqueue(current);
     }
 
+    task_t *next = task_dequeue(cpu);
+
+    assert(next != NULL);
+    assert(next->magic == ONIX_MAGIC);
+
     next->state = TASK_RUNNING;
+    cpu->current = next;
     if (next == current)
         return;
 
@@ -237,9 +533,42 @@ void schedule()
     task_switch(next);    // 调度到下一进程
 }
 
+void preempt_disable()
+{
+    assert(!get_interrupt_state());
+    running_task()->cpu->preempt_count++;
+}
+
+void preempt_enable()
+{
+    assert(!get_interrupt_state());
+    cpu_t *cpu = running_task()->cpu;
+    assert(cpu->preempt_count);
+    cpu->preempt_count--;
+    if (!cpu->preempt_count && cpu->need_resched)
+    {
+        schedule();
+    }
+}
+
+void preempt_schedule()
+{
+    assert(!get_interrupt_state());
+    cpu_t *cpu = running_task()->cpu;
+    if (cpu->preempt_count)
+    {
+        cpu->need_resched = true;
+        return;
+    }
+    schedule();
+}
+
 task_t *task_create(target_t target, const char *name, u32 priority, u32 uid)
 {
+    assert(priority > 0 && priority < TASK_PRIORITY_NR);
     task_t *task = get_free_task();
+    if (!task)
+        panic("No more tasks");
 
     u32 stack = (u32)task + PAGE_SIZE;
 
@@ -255,14 +584,15 @@ task_t *task_create(target_t target, const char *name, u32 priority, u32 uid)
 
     task->stack = (u32 *)stack;
     task->priority = priority;
+    task->base_priority = priority;
     task->ticks = task->priority;
     task->jiffies = 0;
-    task->state = TASK_READY;
+    task->state = TASK_INIT;
     task->uid = uid;
     task->gid = 0; // TODO: group
     task->pgid = 0;
     task->sid = 0;
-    task->vmap = &kernel_map;
+    list_init(&task->vma_list);
     task->pde = KERNEL_PAGE_DIR; // page directory entry
     task->brk = USER_EXEC_ADDR;
     task->text = USER_EXEC_ADDR;
@@ -273,6 +603,8 @@ task_t *task_create(target_t target, const char *name, u32 priority, u32 uid)
     task->iroot->count += 2;
 
     task->pwd = (void *)alloc_kpage(1);
+    if (!task->pwd)
+        panic("Out of kernel memory!!!");
     strcpy(task->pwd, "/");
 
     task->umask = 0022; // 对应 0755
@@ -296,15 +628,38 @@ task_t *task_create(target_t target, const char *name, u32 priority, u32 uid)
         action->restorer = NULL;
     }
 
-    task->timer = NULL;
+    hrtimer_init(&task->timer, task_timeout, task);
     task->alarm = NULL;
+    list_init(&task->timers);
+    list_init(&task->mutexes);
+    task->mutex = NULL;
 
     task->magic = ONIX_MAGIC;
 
+    bool intr = interrupt_disable();
+    task_link(task, NULL);
+    task_wakeup(task);
+    set_interrupt_state(intr);
+    return task;
+}
+
+task_t *task_idle_create(cpu_t *cpu)
+{
+    task_t *task = task_create(idle_thread, "idle", 1, KERNEL_USER);
+
+    bool intr = interrupt_disable();
+    task_unqueue(task);
+    task->cpu = cpu;
+    cpu->idle = task;
+    task_enqueue(task);
+    set_interrupt_state(intr);
     return task;
 }
 
 extern int sys_execve();
+extern void sys_close();
+extern fd_t sys_dup2();
+extern int sys_setpgid();
 extern int init_user_thread();
 
 // 调用该函数的地方不能有任何局部变量
@@ -313,13 +668,10 @@ void task_to_user_mode()
 {
     task_t *task = running_task();
 
-    // 创建用户进程虚拟内存位图
-    task->vmap = kmalloc(sizeof(bitmap_t));
-    void *buf = (void *)alloc_kpage(1);
-    bitmap_init(task->vmap, buf, USER_MMAP_SIZE / PAGE_SIZE / 8, USER_MMAP_ADDR / PAGE_SIZE);
-
     // 创建用户进程页表
     task->pde = (u32)copy_pde();
+    if (!task->pde)
+        panic("Out of kernel memory!!!");
     set_cr3(task->pde);
 
     u32 addr = (u32)task + PAGE_SIZE;
@@ -394,23 +746,40 @@ pid_t task_fork()
 
     // 拷贝内核栈 和 PCB
     task_t *child = get_free_task();
+    if (!child)
+        return -EAGAIN;
     pid_t pid = child->pid;
     memcpy(child, task, PAGE_SIZE);
 
     child->pid = pid;
     child->ppid = task->pid;
 
+    // 先分配页目录和 pwd，失败时子进程还没有持有任何引用
+    child->pde = 0;
+    child->pwd = (char *)alloc_kpage(1);
+    if (child->pwd)
+        child->pde = (u32)copy_pde();
+    if (!child->pde)
+    {
+        task_discard(child);
+        return -ENOMEM;
+    }
+    strncpy(child->pwd, task->pwd, PAGE_SIZE);
+
+    child->priority = child->base_priority;
     child->ticks = child->priority;
-    child->state = TASK_READY;
+    child->state = TASK_INIT;
+
+    // 定时器不继承
+    child->alarm = NULL;
+    hrtimer_init(&child->timer, task_timeout, child);
+    list_init(&child->timers);
 
-    // 拷贝用户进程虚拟内存位图
-    child->vmap = kmalloc(sizeof(bitmap_t));
-    memcpy(child->vmap, task->vmap, sizeof(bitmap_t));
+    // 互斥量不继承
+    list_init(&child->mutexes);
 
-    // 拷贝虚拟位图缓存
-    void *buf = (void *)alloc_kpage(1);
-    memcpy(buf, task->vmap->bits, PAGE_SIZE);
-    child->vmap->bits = buf;
+    // 拷贝映射区域
+    mmap_fork(child);
 
     // 拷贝 FPU 状态
     if (task->fpu)
@@ -419,13 +788,190 @@ pid_t task_fork()
         memcpy(child->fpu, task->fpu, sizeof(fpu_t));
     }
 
-    // 拷贝页目录
-    child->pde = (u32)copy_pde();
+    // 工作目录引用加一
+    task->ipwd->count++;
+    task->iroot->count++;
+    if (task->iexec)
+        task->iexec->count++;
+
+    // 文件引用加一
+    for (size_t i = 0; i < TASK_FILE_NR; i++)
+    {
+        file_t *file = child->files[i];
+        if (file)
+            file->count++;
+    }
+
+    // 构造 child 内核栈
+    task_build_stack(child); // ROP
+    task_link(child, task);
+    task_wakeup(child);
+    // schedule();
+
+    return child->pid;
+}
+
+// 将参数和环境变量拷贝到 spawn 参数页中，空间不足返回 false
+static bool spawn_copy_argv(spawn_t *spawn, u32 *ptr, char ***dest, char *argv[])
+{
+    int count = 0;
+    while (argv && argv[count])
+        count++;
+
+    u32 end = (u32)spawn + SPAWN_PAGES * PAGE_SIZE;
+    char **array = (char **)*ptr;
+    *ptr += (count + 1) * sizeof(char *);
+    if (*ptr > end)
+        return false;
+
+    for (int i = 0; i < count; i++)
+    {
+        int len = strlen(argv[i]) + 1;
+        if (*ptr + len > end)
+            return false;
+        array[i] = (char *)*ptr;
+        memcpy(array[i], argv[i], len);
+        *ptr += len;
+    }
+    array[count] = NULL;
+    *dest = array;
+    return true;
+}
+
+// spawn 子进程首次被调度时从这里开始执行
+static void task_spawn_entry()
+{
+    task_t *task = running_task();
+    spawn_t *spawn = task->spawn;
+
+    posix_spawn_file_actions_t *actions = &spawn->actions;
+    for (size_t i = 0; i < actions->count; i++)
+    {
+        spawn_action_t *action = &actions->actions[i];
+        if (action->type == SPAWN_ACTION_CLOSE)
+            sys_close(action->fd);
+        else if (action->type == SPAWN_ACTION_DUP2 && action->fd != action->newfd)
+            sys_dup2(action->fd, action->newfd);
+    }
+
+    posix_spawnattr_t *attr = &spawn->attr;
+    if (attr->flags & POSIX_SPAWN_SETPGROUP)
+        sys_setpgid(0, attr->pgroup);
+
+    if (attr->flags & POSIX_SPAWN_SETSIGDEF)
+    {
+        for (size_t sig = MINSIG; sig <= MAXSIG; sig++)
+        {
+            if (attr->sigdefault & SIGMASK(sig))
+                task->actions[sig - 1].handler = SIG_DFL;
+        }
+    }
+
+    if (attr->flags & POSIX_SPAWN_SETSIGMASK)
+        task->blocked = attr->sigmask & ~SIGMASK(SIGKILL);
+
+    // 执行成功不会返回，参数页由 execve 释放
+    sys_execve(spawn->filename, spawn->argv, spawn->envp);
+    task_exit(127);
+}
+
+void task_spawn_release(task_t *task)
+{
+    if (!task->spawn)
+        return;
+    free_kpage((u32)task->spawn, SPAWN_PAGES);
+    task->spawn = NULL;
+}
+
+pid_t task_spawn(char *filename, char *argv[], char *envp[],
+                 posix_spawn_file_actions_t *actions, posix_spawnattr_t *attr)
+{
+    task_t *task = running_task();
+
+    // 当前进程没有阻塞，且正在执行
+    assert(task->node.next == NULL && task->node.prev == NULL && task->state == TASK_RUNNING);
+
+    // 先检查程序文件，常见的错误直接返回给父进程
+    inode_t *inode = namei(filename);
+    if (!inode)
+        return -ENOENT;
+
+    bool exec = ISFILE(inode->mode) && inode->op->permission(inode, P_EXEC);
+    iput(inode);
+    if (!exec)
+        return -EPERM;
+
+    if (actions && actions->count > SPAWN_ACTION_NR)
+        return -EINVAL;
+
+    // 子进程看不到父进程的地址空间，参数需要拷贝到内核中
+    spawn_t *spawn = (spawn_t *)alloc_kpage(SPAWN_PAGES);
+    if (!spawn)
+        return -ENOMEM;
+    memset(spawn, 0, sizeof(spawn_t));
+    if (actions)
+        memcpy(&spawn->actions, actions, sizeof(posix_spawn_file_actions_t));
+    if (attr)
+        memcpy(&spawn->attr, attr, sizeof(posix_spawnattr_t));
+
+    u32 ptr = (u32)spawn + sizeof(spawn_t);
+    char *name[] = {filename, NULL};
+    char **names;
+    if (!spawn_copy_argv(spawn, &ptr, &names, name) ||
+        !spawn_copy_argv(spawn, &ptr, &spawn->argv, argv) ||
+        !spawn_copy_argv(spawn, &ptr, &spawn->envp, envp))
+    {
+        free_kpage((u32)spawn, SPAWN_PAGES);
+        return -E2BIG;
+    }
+    spawn->filename = names[0];
+
+    // 拷贝内核栈 和 PCB，与 fork 相同，但不拷贝地址空间
+    task_t *child = get_free_task();
+    if (!child)
+    {
+        free_kpage((u32)spawn, SPAWN_PAGES);
+        return -EAGAIN;
+    }
+    pid_t pid = child->pid;
+    memcpy(child, task, PAGE_SIZE);
+
+    child->pid = pid;
+    child->ppid = task->pid;
 
-    // 拷贝 pwd
+    // 只有内核映射的页目录，用户内存由 execve 建立
+    child->pde = 0;
     child->pwd = (char *)alloc_kpage(1);
+    if (child->pwd)
+        child->pde = (u32)create_pde();
+    if (!child->pde)
+    {
+        task_discard(child);
+        free_kpage((u32)spawn, SPAWN_PAGES);
+        return -ENOMEM;
+    }
     strncpy(child->pwd, task->pwd, PAGE_SIZE);
 
+    child->priority = child->base_priority;
+    child->ticks = child->priority;
+    child->state = TASK_INIT;
+    child->signal = 0;
+    child->alarm = NULL;
+    hrtimer_init(&child->timer, task_timeout, child);
+    list_init(&child->timers);
+    list_init(&child->mutexes);
+    child->spawn = spawn;
+
+    // 新程序没有映射区域
+    list_init(&child->vma_list);
+
+    // 新程序重新初始化 FPU
+    child->fpu = NULL;
+    child->flags = 0;
+
+    child->brk = USER_EXEC_ADDR;
+    child->end = USER_EXEC_ADDR;
+
     // 工作目录引用加一
     task->ipwd->count++;
     task->iroot->count++;
@@ -440,10 +986,13 @@ pid_t task_fork()
             file->count++;
     }
 
-    // 构造 child 内核栈
-    task_build_stack(child); // ROP
-    // schedule();
+    // 构造 child 内核栈，从 task_spawn_entry 开始执行
+    task_build_stack(child);
+    task_frame_t *frame = (task_frame_t *)child->stack;
+    frame->eip = task_spawn_entry;
 
+    task_link(child, task);
+    task_wakeup(child);
     return child->pid;
 }
 
@@ -453,14 +1002,10 @@ static void task_kill_session(task_t *task)
     if (!task_leader(task))
         return;
 
-    for (size_t i = 0; i < TASK_NR; i++)
+    for (task_t *ptr = session_next(task->sid, NULL); ptr; ptr = session_next(task->sid, ptr))
     {
-        task_t *child = task_table[i];
-        if (!child)
-            continue;
-        if (task == child || task->sid != child->sid)
-            continue;
-        child->signal |= SIGMASK(SIGHUP);
+        if (ptr != task)
+            ptr->signal |= SIGMASK(SIGHUP);
     }
 }
 
@@ -480,17 +1025,10 @@ static void task_tell_father(task_t *task)
 {
     if (!task->ppid)
         return;
-    for (size_t i = 0; i < TASK_NR; i++)
-    {
-        task_t *parent = task_table[i];
-        if (!parent)
-            continue;
-        if (parent->pid != task->ppid)
-            continue;
-        parent->signal |= SIGMASK(SIGCHLD);
-        return;
-    }
-    panic("No Parent found!!!");
+    task_t *parent = get_task(task->ppid);
+    if (!parent)
+        panic("No Parent found!!!");
+    parent->signal |= SIGMASK(SIGCHLD);
 }
 
 void task_exit(int status)
@@ -509,10 +1047,13 @@ void task_exit(int status)
 
     timer_remove(task);
 
-    free_pde();
+    // 解除文件映射，需要在释放页表之前
+    mmap_exit();
 
-    free_kpage((u32)task->vmap->bits, 1);
-    kfree(task->vmap);
+    // spawn 执行程序失败时，参数页还没有释放
+    task_spawn_release(task);
+
+    free_pde();
 
     // 释放 FPU 状态
     if (task->fpu)
@@ -537,18 +1078,18 @@ void task_exit(int status)
     }
 
     // 将子进程的父进程赋值为自己的父进程
-    for (size_t i = 2; i < TASK_NR; i++)
+    task_t *parent = get_task(task->ppid);
+    assert(parent);
+    list_t *children = &task->children;
+    while (!list_empty(children))
     {
-        task_t *child = task_table[i];
-        if (!child)
-            continue;
-        if (child->ppid != task->pid)
-            continue;
+        task_t *child = element_entry(task_t, sibling, children->head.next);
+        list_remove(&child->sibling);
         child->ppid = task->ppid;
+        list_insert_before(&parent->children.tail, &child->sibling);
     }
     LOGK("task %s 0x%p exit....\n", task->name, task);
 
-    task_t *parent = task_table[task->ppid];
     if (parent->state == TASK_WAITING &&
         (parent->waitpid == -1 || parent->waitpid == task->pid))
     {
@@ -566,21 +1107,16 @@ pid_t task_waitpid(pid_t pid, int32 *status)
     while (true)
     {
         bool has_child = false;
-        for (size_t i = 2; i < TASK_NR; i++)
+        list_t *list = &task->children;
+        for (list_node_t *node = list->head.next; node != &list->tail; node = node->next)
         {
-            task_t *ptr = task_table[i];
-            if (!ptr)
-                continue;
-
-            if (ptr->ppid != task->pid)
-                continue;
+            task_t *ptr = element_entry(task_t, sibling, node);
             if (pid != ptr->pid && pid != -1)
                 continue;
 
             if (ptr->state == TASK_DIED)
             {
                 child = ptr;
-                task_table[i] = NULL;
                 goto rollback;
             }
 
@@ -601,20 +1137,29 @@ pid_t task_waitpid(pid_t pid, int32 *status)
 rollback:
     *status = child->status;
     u32 ret = child->pid;
-    free_kpage((u32)child, 1);
+    task_free(child);
     return ret;
 }
 
 static void task_setup()
 {
     task_t *task = running_task();
+    assert(task == cpu_current()->current);
     task->magic = ONIX_MAGIC;
     task->ticks = 1;
+    hrtimer_init(&task->timer, task_timeout, task);
+    list_init(&task->timers);
+    list_init(&task->mutexes);
 
-    memset(task_table, 0, sizeof(task_table));
+    list_init(&task_list);
+    for (size_t i = 0; i < PID_HASH_NR; i++)
+    {
+        list_init(&pid_hash[i]);
+        list_init(&pgrp_hash[i]);
+        list_init(&session_hash[i]);
+    }
 }
 
-extern void idle_thread();
 extern void init_thread();
 
 void task_init()
@@ -622,8 +1167,19 @@ void task_init()
     list_init(&block_list);
     list_init(&sleep_list);
 
+    for (size_t cpu = 0; cpu < CPU_NR; cpu++)
+    {
+        run_queue_t *rq = &run_queues[cpu];
+        for (size_t i = 0; i < TASK_PRIORITY_NR; i++)
+        {
+            list_init(&rq->lists[i]);
+        }
+        rq->bitmap = 0;
+        rq->count = 0;
+    }
+
     task_setup();
 
-    idle_task = task_create(idle_thread, "idle", 1, KERNEL_USER);
+    task_idle_create(cpu_current());
     task_create(init_thread, "init", 5, NORMAL_USER);
 }
@@ -10,10 +10,18 @@
 #include <onix/memory.h>
 #include <onix/net.h>
 #include <onix/syscall.h>
+#include <onix/stdlib.h>
+#include <onix/arena.h>
+#include <onix/timer.h>
+#include <onix/mutex.h>
+#include <onix/ide.h>
+#include <onix/slab.h>
+#include <onix/task.h>
 
 #define LOGK(fmt, args...) DEBUGK(fmt, ##args)
 
-int sys_test()
+// 默认测试，osh 启动时调用，方便调试
+static int test_default()
 {
     char ch;
     device_t *device;
@@ -23,8 +31,191 @@ int sys_test()
         return 0;
 
     void *buf = (void *)alloc_kpage(1);
+    if (!buf)
+        return -ENOMEM;
     memset(buf, 0, PAGE_SIZE);
     device_read(device->dev, buf, 2, 0, 0);
     free_kpage((u32)buf, 1);
     return EOK;
 }
+
+#define ARENA_TEST_COUNT 1024 // 同时存活的对象数量，1024 字节时约占 1.4M 内核内存
+#define ARENA_TEST_ROUNDS 16  // 测试轮数
+
+// kmalloc/kfree 测试，大量对象存活时，交错释放，使整页空闲的路径被频繁执行
+static int test_arena()
+{
+    u32 pages = div_round_up(ARENA_TEST_COUNT * sizeof(void *), PAGE_SIZE);
+    void **ptrs = (void **)alloc_kpage(pages);
+    if (!ptrs)
+        return -ENOMEM;
+    u32 sizes[] = {16, 64, 256, 1024};
+
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(u32); i++)
+    {
+        u32 cycles = 0;
+        for (size_t round = 0; round < ARENA_TEST_ROUNDS; round++)
+        {
+            u64 start = cpu_rdtsc();
+            for (size_t j = 0; j < ARENA_TEST_COUNT; j++)
+            {
+                ptrs[j] = kmalloc(sizes[i]);
+            }
+            for (size_t j = 0; j < ARENA_TEST_COUNT; j += 2)
+            {
+                kfree(ptrs[j]);
+            }
+            for (size_t j = 1; j < ARENA_TEST_COUNT; j += 2)
+            {
+                kfree(ptrs[j]);
+            }
+            // 每轮的周期数不会超过 32 位，累计每次操作的平均周期数
+            cycles += (u32)(cpu_rdtsc() - start) / (ARENA_TEST_COUNT * 2);
+        }
+        printk("arena size %d live %d: %d cycles per kmalloc/kfree\n",
+               sizes[i], ARENA_TEST_COUNT, cycles / ARENA_TEST_ROUNDS);
+    }
+
+    free_kpage((u32)ptrs, pages);
+    return EOK;
+}
+
+#define TIMER_TEST_COUNT 4096 // 同时存在的定时器数量
+
+static void test_timeout(timer_t *timer)
+{
+}
+
+// 定时器测试，模拟大量连接的套接字超时，添加、更新、删除大量定时器
+// 超时时间在 10 毫秒到 30 秒之间随机分布，系统调用中关中断，测试期间定时器不会超时
+static int test_timer()
+{
+    u32 pages = div_round_up(TIMER_TEST_COUNT * sizeof(timer_t *), PAGE_SIZE);
+    timer_t **timers = (timer_t **)alloc_kpage(pages);
+    if (!timers)
+        return -ENOMEM;
+    u32 seed = 1;
+
+    u64 start = cpu_rdtsc();
+    for (size_t i = 0; i < TIMER_TEST_COUNT; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        timers[i] = timer_add(10 + (seed >> 8) % 30000, test_timeout, NULL);
+    }
+    u32 add = (u32)(cpu_rdtsc() - start) / TIMER_TEST_COUNT;
+
+    // 连接收到数据时重新设置超时
+    start = cpu_rdtsc();
+    for (size_t i = 0; i < TIMER_TEST_COUNT; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        timer_update(timers[i], 10 + (seed >> 8) % 30000);
+    }
+    u32 update = (u32)(cpu_rdtsc() - start) / TIMER_TEST_COUNT;
+
+    // 交错删除，模拟连接随机关闭
+    start = cpu_rdtsc();
+    for (size_t i = 0; i < TIMER_TEST_COUNT; i += 2)
+    {
+        timer_put(timers[i]);
+    }
+    for (size_t i = 1; i < TIMER_TEST_COUNT; i += 2)
+    {
+        timer_put(timers[i]);
+    }
+    u32 put = (u32)(cpu_rdtsc() - start) / TIMER_TEST_COUNT;
+
+    printk("timer live %d: %d cycles per add, %d per update, %d per cancel\n",
+           TIMER_TEST_COUNT, add, update, put);
+
+    free_kpage((u32)timers, pages);
+    return EOK;
+}
+
+// 预先清零的页池统计
+static int test_zero()
+{
+    zero_pool_stat_t stat;
+    zero_pool_stat(&stat);
+    printk("zero pool %d/%d pages, %d hits %d misses\n",
+           stat.count, stat.size, stat.hits, stat.misses);
+    return EOK;
+}
+
+extern ide_ctrl_t controllers[IDE_CTRL_NR];
+
+// 互斥量竞争统计，以及硬盘控制器锁的竞争次数
+static int test_lock()
+{
+    mutex_stat_t stat;
+    mutex_stat(&stat);
+    printk("mutex %d locks, %d contended, %d handoffs, %d boosts\n",
+           stat.locks, stat.contended, stat.handoffs, stat.boosts);
+
+    for (size_t i = 0; i < IDE_CTRL_NR; i++)
+    {
+        ide_ctrl_t *ctrl = &controllers[i];
+        printk("%s lock %d contended\n", ctrl->name, ctrl->lock.mutex.contended);
+    }
+    return EOK;
+}
+
+// 对象缓存统计
+static int test_slab()
+{
+    for (kmem_cache_t *cache = kmem_cache_next(NULL); cache; cache = kmem_cache_next(cache))
+    {
+        printk("slab %s size %d: %d pages %d idle, %d active, "
+               "%d allocs %d frees, %d grows %d shrinks\n",
+               cache->name, cache->size, cache->pages, cache->idle, cache->active,
+               cache->allocs, cache->frees, cache->grows, cache->shrinks);
+    }
+    return EOK;
+}
+
+typedef struct test_t
+{
+    char *name;    // 测试名
+    int (*func)(); // 测试函数
+} test_t;
+
+static test_t tests[] = {
+    {"arena", test_arena},
+    {"lock", test_lock},
+    {"slab", test_slab},
+    {"zero", test_zero},
+    {"timer", test_timer},
+};
+
+#define TEST_NAME_LEN 16 // 测试名的最大长度，包括结尾的 0
+
+// 执行名为 name 的内核测试，name 为 NULL 时执行默认测试
+int sys_test(char *name)
+{
+    if (!name)
+        return test_default();
+
+    // name 是用户指针，逐字节检查之后拷贝到内核中
+    char buf[TEST_NAME_LEN];
+    bool user = running_task()->uid != KERNEL_USER;
+    size_t len = 0;
+    for (; len < TEST_NAME_LEN; len++)
+    {
+        if (!memory_access(name + len, 1, false, user))
+            return -EFAULT;
+        buf[len] = name[len];
+        if (!buf[len])
+            break;
+    }
+    if (len == TEST_NAME_LEN)
+        return -EINVAL;
+
+    for (size_t i = 0; i < sizeof(tests) / sizeof(test_t); i++)
+    {
+        if (!strcmp(tests[i].name, buf))
+            return tests[i].func();
+    }
+
+    printk("test %s not found\n", buf);
+    return -EINVAL;
+}
@@ -2,6 +2,7 @@
 #include <onix/debug.h>
 #include <onix/stdlib.h>
 #include <onix/rtc.h>
+#include <onix/clock.h>
 
 #define LOGK(fmt, args...) DEBUGK(fmt, ##args)
 
@@ -192,6 +193,7 @@ void time_init()
     tm time;
     time_read(&time);
     startup_time = mktime(&time);
+    clock_set_startup(startup_time);
     LOGK("startup time: %d%d-%02d-%02d %02d:%02d:%02d\n",
          century,
          time.tm_year,
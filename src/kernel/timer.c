@@ -3,7 +3,7 @@
 #include <onix/syscall.h>
 #include <onix/task.h>
 #include <onix/mutex.h>
-#include <onix/arena.h>
+#include <onix/slab.h>
 #include <onix/errno.h>
 #include <onix/assert.h>
 #include <onix/debug.h>
@@ -13,18 +13,63 @@
 extern u32 volatile jiffies;
 extern u32 jiffy;
 
-static list_t timer_list;
+// 分层时间轮，第一层 256 个槽，每槽一个时间片，其余四层每层 64 个槽
+// 每层一个槽对应上一层转一圈的时间，五层覆盖全部 32 位时间片
+// 定时器按照超时时间与当前时间的距离放入某一层的槽中，添加和删除都是 O(1)
+// 第一层转完一圈时，将第二层下一个槽中的定时器重新分配到第一层，以此类推
+#define WHEEL_ROOT_BITS 8
+#define WHEEL_BITS 6
+#define WHEEL_ROOT_SIZE (1 << WHEEL_ROOT_BITS)
+#define WHEEL_SIZE (1 << WHEEL_BITS)
+#define WHEEL_ROOT_MASK (WHEEL_ROOT_SIZE - 1)
+#define WHEEL_MASK (WHEEL_SIZE - 1)
+#define WHEEL_LEVELS 4 // 第一层之外的层数
+
+// 第 level 层时间轮，level 从 0 开始，不包括第一层
+#define WHEEL_SHIFT(level) (WHEEL_ROOT_BITS + (level) * WHEEL_BITS)
+
+static list_t wheel_root[WHEEL_ROOT_SIZE];     // 第一层时间轮
+static list_t wheel[WHEEL_LEVELS][WHEEL_SIZE]; // 其余各层时间轮
+static u32 wheel_jiffies;                      // 时间轮下一次要处理的时间片
+static kmem_cache_t *timer_cache;
 
 static timer_t *timer_get()
 {
-    timer_t *timer = (timer_t *)kmalloc(sizeof(timer_t));
+    timer_t *timer = (timer_t *)kmem_cache_alloc(timer_cache);
     return timer;
 }
 
+// 按照超时时间将定时器放入时间轮中对应的槽
+static void timer_insert(timer_t *timer)
+{
+    u32 expires = timer->expires;
+    u32 delta = expires - wheel_jiffies;
+    list_t *slot;
+
+    if ((int)delta < 0)
+    {
+        // 已经超时的定时器，下一个时间片处理
+        slot = &wheel_root[wheel_jiffies & WHEEL_ROOT_MASK];
+    }
+    else if (delta < WHEEL_ROOT_SIZE)
+    {
+        slot = &wheel_root[expires & WHEEL_ROOT_MASK];
+    }
+    else
+    {
+        size_t level = 0;
+        while (level < WHEEL_LEVELS - 1 && delta >= (1 << WHEEL_SHIFT(level + 1)))
+            level++;
+        slot = &wheel[level][(expires >> WHEEL_SHIFT(level)) & WHEEL_MASK];
+    }
+    list_insert_before(&slot->tail, &timer->node);
+}
+
 void timer_put(timer_t *timer)
 {
     list_remove(&timer->node);
-    kfree(timer);
+    list_remove(&timer->tnode);
+    kmem_cache_free(timer_cache, timer);
 }
 
 void default_timeout(timer_t *timer)
@@ -42,7 +87,8 @@ timer_t *timer_add(u32 expire_ms, handler_t handler, void *arg)
     timer->arg = arg;
     timer->active = false;
 
-    list_insert_sort(&timer_list, &timer->node, element_node_offset(timer_t, node, expires));
+    list_insert_before(&timer->task->timers.tail, &timer->tnode);
+    timer_insert(timer);
     return timer;
 }
 
@@ -51,17 +97,7 @@ void timer_update(timer_t *timer, u32 expire_ms)
 {
     list_remove(&timer->node);
     timer->expires = jiffies + expire_ms / jiffy;
-    list_insert_sort(&timer_list, &timer->node, element_node_offset(timer_t, node, expires));
-}
-
-u32 timer_expires()
-{
-    if (list_empty(&timer_list))
-    {
-        return EOF;
-    }
-    timer_t *timer = element_entry(timer_t, node, timer_list.head.next);
-    return timer->expires;
+    timer_insert(timer);
 }
 
 // 得到超时时间片
@@ -79,39 +115,105 @@ bool timer_is_expires(u32 expires)
 void timer_init()
 {
     LOGK("timer init...\n");
-    list_init(&timer_list);
+    for (size_t i = 0; i < WHEEL_ROOT_SIZE; i++)
+    {
+        list_init(&wheel_root[i]);
+    }
+    for (size_t level = 0; level < WHEEL_LEVELS; level++)
+    {
+        for (size_t i = 0; i < WHEEL_SIZE; i++)
+        {
+            list_init(&wheel[level][i]);
+        }
+    }
+    wheel_jiffies = jiffies;
+    timer_cache = kmem_cache_create("timer", sizeof(timer_t), NULL);
+}
+
+// 时间轮下一个需要处理的时间片，用于空闲时停止周期时钟
+// 第一层转完一圈时需要从上层分配定时器，最多查找到这个时间片
+u32 timer_next_jiffies()
+{
+    u32 next = wheel_jiffies;
+    while ((next & WHEEL_ROOT_MASK) && list_empty(&wheel_root[next & WHEEL_ROOT_MASK]))
+    {
+        next++;
+    }
+    return next;
 }
 
-// 从定时器链表中找到 task 任务的定时器，删除之，用于 task_exit
+// 删除 task 任务的全部定时器，用于 task_exit
 void timer_remove(task_t *task)
 {
-    list_t *list = &timer_list;
-    for (list_node_t *ptr = list->head.next; ptr != &list->tail;)
+    list_t *list = &task->timers;
+    while (!list_empty(list))
     {
-        timer_t *timer = element_entry(timer_t, node, ptr);
-        ptr = ptr->next;
-        if (timer->task != task)
-            continue;
+        timer_t *timer = element_entry(timer_t, tnode, list->head.next);
         timer_put(timer);
     }
 }
 
+// 将第 level 层当前槽中的定时器重新分配到下面的层，返回槽的索引
+// 索引为 0 表示这一层也转完了一圈，需要继续处理上一层
+static u32 timer_cascade(size_t level)
+{
+    u32 index = (wheel_jiffies >> WHEEL_SHIFT(level)) & WHEEL_MASK;
+    list_t *slot = &wheel[level][index];
+    while (!list_empty(slot))
+    {
+        timer_t *timer = element_entry(timer_t, node, slot->head.next);
+        list_remove(&timer->node);
+        timer_insert(timer);
+    }
+    return index;
+}
+
 void timer_wakeup()
 {
-    while (timer_expires() <= jiffies)
+    list_t expired;
+    list_init(&expired);
+
+    while ((int)(jiffies - wheel_jiffies) >= 0)
     {
-        timer_t *timer = element_entry(timer_t, node, timer_list.head.next);
-        timer->active = true;
+        u32 index = wheel_jiffies & WHEEL_ROOT_MASK;
 
-        assert(timer->expires <= jiffies);
-        if (timer->handler)
+        // 第一层转完一圈，逐层向下分配
+        for (size_t level = 0; !index && level < WHEEL_LEVELS; level++)
         {
-            timer->handler(timer);
+            if (timer_cascade(level))
+                break;
         }
-        else
+
+        // 先移动时间轮，处理函数中添加的已超时定时器放到下一个槽
+        list_t *slot = &wheel_root[index];
+        wheel_jiffies++;
+
+        if (list_empty(slot))
+            continue;
+
+        // 整个槽移到超时链表
+        expired.head.next = slot->head.next;
+        expired.tail.prev = slot->tail.prev;
+        expired.head.next->prev = &expired.head;
+        expired.tail.prev->next = &expired.tail;
+        list_init(slot);
+
+        // 处理函数可能释放同一个槽中的其他定时器，每次都从链表头取
+        while (!list_empty(&expired))
         {
-            default_timeout(timer);
+            timer_t *timer = element_entry(timer_t, node, expired.head.next);
+            timer->active = true;
+
+            assert((int)(jiffies - timer->expires) >= 0);
+            if (timer->handler)
+            {
+                timer->handler(timer);
+            }
+            else
+            {
+                default_timeout(timer);
+            }
+            timer_put(timer);
         }
-        timer_put(timer);
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,77 @@
+[bits 16]
+
+; 应用处理器启动代码，启动处理器将其拷贝到 AP_TRAMPOLINE 之后发送 STARTUP
+; 处理器从实模式开始执行，cs = AP_TRAMPOLINE >> 4，ip = 0
+; 代码在拷贝之后的位置执行，所有地址都要换算成拷贝之后的地址
+
+AP_TRAMPOLINE equ 0x8000   ; 与 onix/smp.h 一致
+KERNEL_PAGE_DIR equ 0x1000 ; 与 onix/memory.h 一致
+
+code_selector equ (1 << 3)
+data_selector equ (2 << 3)
+
+%define ADDR(label) (label - ap_trampoline + AP_TRAMPOLINE)
+
+extern ap_main
+
+section .text
+
+global ap_trampoline
+ap_trampoline:
+    cli
+    mov ax, cs
+    mov ds, ax
+
+    ; 加载内核全局描述符表，进入保护模式
+    o32 lgdt [ap_gdt_ptr - ap_trampoline]
+
+    mov eax, cr0
+    or eax, 1
+    mov cr0, eax
+
+    jmp dword code_selector:ADDR(ap_protected)
+
+[bits 32]
+ap_protected:
+    mov ax, data_selector
+    mov ds, ax
+    mov es, ax
+    mov fs, ax
+    mov gs, ax
+    mov ss, ax
+
+    ; 使用内核页目录，控制寄存器与启动处理器相同，开启分页
+    mov eax, [ADDR(ap_cr4)]
+    mov cr4, eax
+    mov eax, KERNEL_PAGE_DIR
+    mov cr3, eax
+    mov eax, [ADDR(ap_cr0)]
+    mov cr0, eax
+
+    ; 使用启动处理器准备的栈，跳转到内核
+    mov esp, [ADDR(ap_stack)]
+    mov eax, ap_main
+    jmp eax
+
+; 下面的参数由启动处理器在拷贝之前设置
+align 4
+global ap_gdt_ptr
+ap_gdt_ptr:
+    dw 0
+    dd 0
+
+align 4
+global ap_cr0
+ap_cr0:
+    dd 0
+
+global ap_cr4
+ap_cr4:
+    dd 0
+
+global ap_stack
+ap_stack:
+    dd 0
+
+global ap_trampoline_end
+ap_trampoline_end:
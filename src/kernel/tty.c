@@ -10,7 +10,6 @@
 
 #define LOGK(fmt, args...) DEBUGK(fmt, ##args)
 
-extern task_t *task_table[TASK_NR]; // 任务表
 static tty_t typewriter;
 
 // 向前台组进程发送 SIGINT 信号
@@ -21,15 +20,7 @@ int tty_intr()
     {
         return 0;
     }
-    for (size_t i = 0; i < TASK_NR; i++)
-    {
-        task_t *task = task_table[i];
-        if (!task)
-            continue;
-        if (task->pgid != tty->pgid)
-            continue;
-        kill(task->pid, SIGINT);
-    }
+    kill(-tty->pgid, SIGINT);
     return 0;
 }
 
@@ -0,0 +1,59 @@
+#include <onix/wait.h>
+#include <onix/task.h>
+#include <onix/clock.h>
+#include <onix/interrupt.h>
+#include <onix/assert.h>
+#include <onix/errno.h>
+
+void wait_queue_init(wait_queue_t *wq)
+{
+    list_init(&wq->waiters);
+}
+
+bool wait_queue_active(wait_queue_t *wq)
+{
+    return !list_empty(&wq->waiters);
+}
+
+u64 wait_expires(int timeout_ms)
+{
+    if (timeout_ms <= 0)
+        return 0;
+    return clock_monotonic() + (u64)timeout_ms * NSEC_PER_MSEC;
+}
+
+err_t wait_until(wait_queue_t *wq, int state, u64 expires)
+{
+    assert(!get_interrupt_state());
+    assert(state == TASK_BLOCKED || state == TASK_WAITING || state == TASK_SLEEPING);
+    return task_block_until(running_task(), &wq->waiters, state, expires);
+}
+
+err_t wait_timeout(wait_queue_t *wq, int state, int timeout_ms)
+{
+    return wait_until(wq, state, wait_expires(timeout_ms));
+}
+
+void wake_up(wait_queue_t *wq, int reason)
+{
+    bool intr = interrupt_disable();
+    if (!list_empty(&wq->waiters))
+    {
+        task_t *task = element_entry(task_t, node, wq->waiters.tail.prev);
+        assert(task->magic == ONIX_MAGIC);
+        task_unblock(task, reason);
+    }
+    set_interrupt_state(intr);
+}
+
+void wake_up_all(wait_queue_t *wq, int reason)
+{
+    bool intr = interrupt_disable();
+    while (!list_empty(&wq->waiters))
+    {
+        task_t *task = element_entry(task_t, node, wq->waiters.tail.prev);
+        assert(task->magic == ONIX_MAGIC);
+        task_unblock(task, reason);
+    }
+    set_interrupt_state(intr);
+}
@@ -1,14 +1,96 @@
 #include <onix/bitmap.h>
 #include <onix/string.h>
+#include <onix/stdlib.h>
 #include <onix/onix.h>
 #include <onix/assert.h>
 
+#define WORD_BITS 32         // 每个字的位数
+#define WORD_FULL 0xffffffff // 全部置位的字
+
+// 位图中字的数量
+static _inline u32 bitmap_words(bitmap_t *map)
+{
+    return div_round_up(map->length, 4);
+}
+
+// 得到字中最低的置位的位置，word 不能为 0
+static _inline u32 bit_scan(u32 word)
+{
+    u32 index;
+    asm volatile("bsfl %1, %0\n"
+                 : "=r"(index)
+                 : "rm"(word));
+    return index;
+}
+
+// 得到位图的第 idx 个字，超出缓冲区的位视为已占用
+static u32 bitmap_word(bitmap_t *map, u32 idx)
+{
+    if ((idx + 1) * 4 <= map->length)
+        return ((u32 *)map->bits)[idx];
+
+    u32 word = WORD_FULL;
+    for (u32 i = idx * 4; i < map->length; i++)
+    {
+        u32 shift = (i - idx * 4) * 8;
+        word &= ~(0xff << shift);
+        word |= map->bits[i] << shift;
+    }
+    return word;
+}
+
+// 重新计算第 idx 个字所在组的摘要位
+static void bitmap_group_update(bitmap_t *map, u32 idx)
+{
+    u32 group = idx >> map->shift;
+    assert(group < BITMAP_GROUPS);
+    u32 start = group << map->shift;
+    u32 end = start + (1 << map->shift);
+    u32 words = bitmap_words(map);
+    if (end > words)
+        end = words;
+
+    for (u32 i = start; i < end; i++)
+    {
+        if (bitmap_word(map, i) != WORD_FULL)
+        {
+            map->summary[group / 32] &= ~(1 << (group % 32));
+            return;
+        }
+    }
+    map->summary[group / 32] |= (1 << (group % 32));
+}
+
+// 从第 group 组开始，利用摘要找到第一个未满的组
+static u32 bitmap_next_group(bitmap_t *map, u32 group)
+{
+    while (group < BITMAP_GROUPS)
+    {
+        u32 word = map->summary[group / 32] | ((1 << (group % 32)) - 1);
+        if (word != WORD_FULL)
+            return (group & ~31) + bit_scan(~word);
+        group = (group & ~31) + 32;
+    }
+    return BITMAP_GROUPS;
+}
+
 // 构造位图
 void bitmap_make(bitmap_t *map, char *bits, u32 length, u32 offset)
 {
     map->bits = bits;
     map->length = length;
     map->offset = offset;
+    map->cursor = 0;
+
+    // 组的数量不超过摘要的位数
+    map->shift = 0;
+    while (div_round_up(bitmap_words(map), 1 << map->shift) > BITMAP_GROUPS)
+    {
+        map->shift++;
+    }
+
+    // 摘要全部清零，表示每组都可能有空闲位，置位只作为跳过的依据
+    memset(map->summary, 0, sizeof(map->summary));
 }
 
 // 位图初始化，全部置为 0
@@ -64,39 +146,105 @@ void bitmap_set(bitmap_t *map, idx_t index, bool value)
         // 置为 0
         map->bits[bytes] &= ~(1 << bits);
     }
+
+    // 更新摘要
+    if (value)
+    {
+        bitmap_group_update(map, idx / WORD_BITS);
+    }
+    else
+    {
+        u32 group = (idx / WORD_BITS) >> map->shift;
+        assert(group < BITMAP_GROUPS);
+        map->summary[group / 32] &= ~(1 << (group % 32));
+    }
 }
 
-// 从位图中得到连续的 count 位
-int bitmap_scan(bitmap_t *map, u32 count)
+// 从第 from 位开始查找第一个为 0 的位，找不到返回 end
+static u32 bitmap_find_zero(bitmap_t *map, u32 from, u32 end)
 {
-    int start = EOF;                 // 标记目标开始的位置
-    u32 bits_left = map->length * 8; // 剩余的位数
-    u32 next_bit = 0;                // 下一个位
-    u32 counter = 0;                 // 计数器
+    u32 mask = (1 << map->shift) - 1;
+    u32 idx = from / WORD_BITS;
+
+    // 忽略 from 之前的位
+    u32 word = bitmap_word(map, idx) | ((1 << (from % WORD_BITS)) - 1);
 
-    // 从头开始找
-    while (bits_left-- > 0)
+    while (true)
     {
-        if (!bitmap_test(map, map->offset + next_bit))
-        {
-            // 如果下一个位没有占用，则计数器加一
-            counter++;
-        }
-        else
-        {
-            // 否则计数器置为 0，继续寻找
-            counter = 0;
-        }
+        if (word != WORD_FULL)
+            return MIN(idx * WORD_BITS + bit_scan(~word), end);
 
-        // 下一位，位置加一
-        next_bit++;
+        idx++;
 
-        // 找到数量一致，则设置开始的位置，结束
-        if (counter == count)
-        {
-            start = next_bit - count;
+        // 进入新的一组，跳过摘要中已满的组
+        if ((idx & mask) == 0)
+            idx = bitmap_next_group(map, idx >> map->shift) << map->shift;
+
+        if (idx * WORD_BITS >= end)
+            return end;
+
+        word = bitmap_word(map, idx);
+    }
+}
+
+// 从第 from 位开始查找第一个为 1 的位，找不到返回 end
+static u32 bitmap_find_one(bitmap_t *map, u32 from, u32 end)
+{
+    u32 idx = from / WORD_BITS;
+
+    // 忽略 from 之前的位
+    u32 word = bitmap_word(map, idx) & ~((1 << (from % WORD_BITS)) - 1);
+
+    while (true)
+    {
+        if (word)
+            return MIN(idx * WORD_BITS + bit_scan(word), end);
+
+        idx++;
+        if (idx * WORD_BITS >= end)
+            return end;
+
+        word = bitmap_word(map, idx);
+    }
+}
+
+// 在 [from, end) 中查找连续 count 个为 0 的位
+static int bitmap_search(bitmap_t *map, u32 from, u32 end, u32 count)
+{
+    u32 start = from;
+    while (start < end)
+    {
+        // 找到空闲位的开始
+        start = bitmap_find_zero(map, start, end);
+        if (start + count > end)
             break;
-        }
+
+        // 找到空闲位的结束，长度足够则成功
+        u32 stop = bitmap_find_one(map, start, start + count);
+        if (stop == start + count)
+            return start;
+
+        start = stop;
+    }
+    return EOF;
+}
+
+// 从位图中得到连续的 count 位
+int bitmap_scan(bitmap_t *map, u32 count)
+{
+    u32 total = map->length * 8; // 总位数
+
+    if (count == 0 || count > total)
+        return EOF;
+
+    // 从上次分配结束的位置开始找，找不到再从头开始找
+    int start = bitmap_search(map, map->cursor, total, count);
+    if (start == EOF)
+    {
+        u32 end = map->cursor + count - 1;
+        if (end > total)
+            end = total;
+        start = bitmap_search(map, 0, end, count);
     }
 
     // 如果没找到，则返回 EOF(END OF FILE)
@@ -104,14 +252,23 @@ int bitmap_scan(bitmap_t *map, u32 count)
         return EOF;
 
     // 否则将找到的位，全部置为 1
-    bits_left = count;
-    next_bit = start;
-    while (bits_left--)
+    for (u32 i = start; i < start + count; i++)
     {
-        bitmap_set(map, map->offset + next_bit, true);
-        next_bit++;
+        map->bits[i / 8] |= (1 << (i % 8));
     }
 
+    // 更新涉及到的组的摘要
+    u32 first = (start / WORD_BITS) >> map->shift;
+    u32 last = ((start + count - 1) / WORD_BITS) >> map->shift;
+    for (u32 group = first; group <= last; group++)
+    {
+        bitmap_group_update(map, group << map->shift);
+    }
+
+    map->cursor = start + count;
+    if (map->cursor >= total)
+        map->cursor = 0;
+
     // 然后返回索引
     return start + map->offset;
 }
@@ -0,0 +1,429 @@
+#include <onix/stdlib.h>
+#include <onix/syscall.h>
+#include <onix/string.h>
+#include <onix/assert.h>
+#include <onix/memory.h>
+
+// 用户态内存分配
+// 小对象按大小分级，从堆上的页中切分，每一级都有一个空闲块缓存，分配和释放通常只操作缓存
+// 中等对象直接分配堆上连续的页，大对象使用 mmap 单独映射
+// 堆顶连续的空闲页通过 brk 还给内核，大对象释放时 munmap
+
+#define SMALL_MAX 2032      // 小对象最大字节数，每页至少两块
+#define MEDIUM_MAX 0x20000  // 中等对象最大字节数，更大的对象使用 mmap
+#define HEAP_GROW 4         // 堆每次至少扩展的页数
+#define HEAP_TRIM 16        // 堆顶空闲页超过该值时收缩
+#define BIN_BATCH 32        // 缓存每次从页中取出的最大块数
+
+// 页段类型魔数
+enum span_type_t
+{
+    SPAN_FREE = 0x20220c01, // 堆上的空闲页
+    SPAN_SMALL,             // 切分为小对象的页
+    SPAN_MEDIUM,            // 中等对象占用的连续页
+    SPAN_LARGE,             // mmap 映射的大对象
+};
+
+// 空闲块
+typedef struct block_t
+{
+    struct block_t *next; // 下一个空闲块
+} block_t;
+
+// 页段，位于每段连续页的开头，对象指针向下对齐到页就是所在的页段
+typedef struct span_t
+{
+    u32 magic;           // 类型魔数
+    u32 pages;           // 页数
+    struct span_t *prev; // 链表前驱，空闲页段或者还有空闲块的小对象页
+    struct span_t *next; // 链表后继
+    block_t *free;       // 页内空闲块，只用于小对象页
+    u16 cls;             // 小对象大小级别
+    u16 used;            // 已经取出的块数，包括缓存中的块
+    u32 reserved[2];     // 保留，头部 32 字节，保证对象对齐到 16 字节
+} span_t;
+
+// 每一级小对象的缓存
+typedef struct bin_t
+{
+    block_t *cache;  // 空闲块缓存
+    u32 count;       // 缓存中的块数
+    u32 batch;       // 每次从页中取出的块数
+    span_t *partial; // 还有空闲块的页
+} bin_t;
+
+// 小对象大小级别，按 16 字节对齐，每页的浪费不超过八分之一
+static const u16 class_size[] = {
+    16, 32, 48, 64, 80, 96, 112, 128,
+    160, 192, 224, 256, 320, 384, 448, 512,
+    640, 768, 1008, 1344, 2032};
+
+#define CLASS_NR (sizeof(class_size) / sizeof(class_size[0]))
+
+static bin_t bins[CLASS_NR];
+static u8 class_index[SMALL_MAX / 16 + 1]; // 按 16 字节查找大小级别
+
+static u32 heap_base = 0;         // 堆开始位置
+static u32 heap_top = 0;          // 堆结束位置，也就是当前的 brk
+static span_t *free_spans = NULL; // 堆上的空闲页段，按地址排序
+
+extern char _end[];
+
+#define SPAN(ptr) ((span_t *)((u32)(ptr) & ~(PAGE_SIZE - 1)))
+#define SPAN_END(span) ((u32)(span) + (span)->pages * PAGE_SIZE)
+
+static void heap_init()
+{
+    heap_base = ((u32)_end + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    heap_top = heap_base;
+
+    u32 cls = 0;
+    for (size_t i = 0; i <= SMALL_MAX / 16; i++)
+    {
+        while (class_size[cls] < i * 16)
+            cls++;
+        class_index[i] = cls;
+    }
+
+    for (size_t i = 0; i < CLASS_NR; i++)
+    {
+        u32 count = (PAGE_SIZE - sizeof(span_t)) / class_size[i];
+        bins[i].batch = MIN(count, BIN_BATCH);
+    }
+}
+
+// 从双向链表中移除页段
+static void span_unlink(span_t **list, span_t *span)
+{
+    if (span->prev)
+        span->prev->next = span->next;
+    else
+        *list = span->next;
+    if (span->next)
+        span->next->prev = span->prev;
+    span->prev = NULL;
+    span->next = NULL;
+}
+
+// 插入到双向链表头部
+static void span_push(span_t **list, span_t *span)
+{
+    span->prev = NULL;
+    span->next = *list;
+    if (*list)
+        (*list)->prev = span;
+    *list = span;
+}
+
+// 收缩堆顶的空闲页，保留少量的页供下次使用
+static void heap_trim()
+{
+    span_t *last = free_spans;
+    while (last && last->next)
+        last = last->next;
+
+    if (!last || SPAN_END(last) != heap_top || last->pages < HEAP_TRIM)
+        return;
+
+    u32 top = (u32)last + HEAP_GROW * PAGE_SIZE;
+    if (brk((void *)top) < 0)
+        return;
+
+    last->pages = HEAP_GROW;
+    heap_top = top;
+}
+
+// 将页段插入空闲链表，与相邻的空闲页段合并
+static void span_insert(span_t *span)
+{
+    span->magic = SPAN_FREE;
+
+    span_t *prev = NULL;
+    span_t *next = free_spans;
+    while (next && next < span)
+    {
+        prev = next;
+        next = next->next;
+    }
+
+    if (prev && SPAN_END(prev) == (u32)span)
+    {
+        prev->pages += span->pages;
+        span = prev;
+    }
+    else
+    {
+        span->prev = prev;
+        span->next = next;
+        if (prev)
+            prev->next = span;
+        else
+            free_spans = span;
+        if (next)
+            next->prev = span;
+    }
+
+    if (next && SPAN_END(span) == (u32)next)
+    {
+        span->pages += next->pages;
+        span_unlink(&free_spans, next);
+    }
+}
+
+// 释放页段，堆顶空闲页太多时还给内核
+static void span_release(span_t *span)
+{
+    span_insert(span);
+    heap_trim();
+}
+
+// 首次适应分配 pages 个连续页，不够时扩展堆
+static span_t *span_alloc(u32 pages)
+{
+    if (!heap_base)
+        heap_init();
+
+    while (true)
+    {
+        for (span_t *span = free_spans; span; span = span->next)
+        {
+            if (span->pages < pages)
+                continue;
+
+            // 从空闲页段的尾部切出，链表结点保持不变
+            if (span->pages > pages)
+            {
+                span->pages -= pages;
+                span = (span_t *)SPAN_END(span);
+            }
+            else
+            {
+                span_unlink(&free_spans, span);
+            }
+
+            span->pages = pages;
+            span->prev = NULL;
+            span->next = NULL;
+            return span;
+        }
+
+        u32 grow = MAX(pages, HEAP_GROW);
+        u32 top = heap_top + grow * PAGE_SIZE;
+        if (top > USER_MMAP_ADDR || top < heap_top || brk((void *)top) < 0)
+            return NULL;
+
+        span_t *span = (span_t *)heap_top;
+        span->pages = grow;
+        heap_top = top;
+        span_insert(span);
+    }
+}
+
+// 从页中取出一批空闲块放入缓存
+static bool bin_refill(bin_t *bin, u32 cls)
+{
+    while (bin->count < bin->batch)
+    {
+        span_t *span = bin->partial;
+        if (!span)
+        {
+            span = span_alloc(1);
+            if (!span)
+                break;
+
+            // 新页切分为空闲块
+            span->magic = SPAN_SMALL;
+            span->cls = cls;
+            span->used = 0;
+            span->free = NULL;
+
+            u32 size = class_size[cls];
+            u32 count = (PAGE_SIZE - sizeof(span_t)) / size;
+            block_t *block = (block_t *)((u32)(span + 1) + (count - 1) * size);
+            for (size_t i = 0; i < count; i++)
+            {
+                block->next = span->free;
+                span->free = block;
+                block = (block_t *)((u32)block - size);
+            }
+            span_push(&bin->partial, span);
+        }
+
+        while (span->free && bin->count < bin->batch)
+        {
+            block_t *block = span->free;
+            span->free = block->next;
+            span->used++;
+
+            block->next = bin->cache;
+            bin->cache = block;
+            bin->count++;
+        }
+
+        if (!span->free)
+            span_unlink(&bin->partial, span);
+    }
+    return bin->cache != NULL;
+}
+
+// 将缓存中的 count 块还给所在的页，整页空闲时释放
+static void bin_flush(bin_t *bin, u32 count)
+{
+    while (count-- && bin->cache)
+    {
+        block_t *block = bin->cache;
+        bin->cache = block->next;
+        bin->count--;
+
+        span_t *span = SPAN(block);
+        assert(span->magic == SPAN_SMALL);
+
+        // 已经全部取出的页，重新有了空闲块
+        if (!span->free)
+            span_push(&bin->partial, span);
+
+        block->next = span->free;
+        span->free = block;
+        span->used--;
+
+        if (!span->used)
+        {
+            span_unlink(&bin->partial, span);
+            span_release(span);
+        }
+    }
+}
+
+// 对象可用的字节数
+static u32 usable_size(void *ptr)
+{
+    span_t *span = SPAN(ptr);
+    switch (span->magic)
+    {
+    case SPAN_SMALL:
+        return class_size[span->cls];
+    case SPAN_MEDIUM:
+    case SPAN_LARGE:
+        return span->pages * PAGE_SIZE - sizeof(span_t);
+    default:
+        assert(false);
+    }
+    return 0;
+}
+
+void *malloc(size_t size)
+{
+    if (!heap_base)
+        heap_init();
+
+    if (size == 0)
+        size = 1;
+
+    if (size <= SMALL_MAX)
+    {
+        u32 cls = class_index[(size + 15) / 16];
+        bin_t *bin = &bins[cls];
+        if (!bin->cache && !bin_refill(bin, cls))
+            return NULL;
+
+        block_t *block = bin->cache;
+        bin->cache = block->next;
+        bin->count--;
+        return block;
+    }
+
+    if (size > (u32)-1 - sizeof(span_t) - PAGE_SIZE)
+        return NULL;
+
+    u32 pages = div_round_up(size + sizeof(span_t), PAGE_SIZE);
+    span_t *span;
+
+    if (size <= MEDIUM_MAX)
+    {
+        span = span_alloc(pages);
+        if (!span)
+            return NULL;
+        span->magic = SPAN_MEDIUM;
+    }
+    else
+    {
+        // 匿名映射在缺页时才分配物理内存
+        span = mmap(NULL, pages * PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE, EOF, 0);
+        if ((int)span < 0)
+            return NULL;
+        span->magic = SPAN_LARGE;
+        span->pages = pages;
+    }
+    return span + 1;
+}
+
+void free(void *ptr)
+{
+    if (!ptr)
+        return;
+
+    span_t *span = SPAN(ptr);
+    switch (span->magic)
+    {
+    case SPAN_SMALL:
+    {
+        bin_t *bin = &bins[span->cls];
+        block_t *block = (block_t *)ptr;
+        block->next = bin->cache;
+        bin->cache = block;
+        bin->count++;
+
+        // 缓存太多时，把一批块还给页
+        if (bin->count > bin->batch * 2)
+            bin_flush(bin, bin->batch);
+        break;
+    }
+    case SPAN_MEDIUM:
+        assert(ptr == span + 1);
+        span_release(span);
+        break;
+    case SPAN_LARGE:
+        assert(ptr == span + 1);
+        span->magic = 0;
+        munmap(span, span->pages * PAGE_SIZE);
+        break;
+    default:
+        assert(false);
+    }
+}
+
+void *calloc(size_t count, size_t size)
+{
+    if (size && count > (u32)-1 / size)
+        return NULL;
+
+    void *ptr = malloc(count * size);
+    if (ptr)
+        memset(ptr, 0, count * size);
+    return ptr;
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    if (!ptr)
+        return malloc(size);
+
+    if (!size)
+    {
+        free(ptr);
+        return NULL;
+    }
+
+    // 原来的空间足够，并且不会浪费一半以上，直接使用
+    u32 usable = usable_size(ptr);
+    if (size <= usable && (size > SMALL_MAX || size > usable / 2))
+        return ptr;
+
+    void *new = malloc(size);
+    if (!new)
+        return NULL;
+
+    memcpy(new, ptr, MIN(size, usable));
+    free(ptr);
+    return new;
+}
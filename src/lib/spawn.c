@@ -0,0 +1,61 @@
+#include <onix/spawn.h>
+#include <onix/string.h>
+#include <onix/errno.h>
+
+int posix_spawn_file_actions_init(posix_spawn_file_actions_t *actions)
+{
+    memset(actions, 0, sizeof(posix_spawn_file_actions_t));
+    return EOK;
+}
+
+static int add_action(posix_spawn_file_actions_t *actions, int type, fd_t fd, fd_t newfd)
+{
+    if (actions->count >= SPAWN_ACTION_NR)
+        return ENOMEM;
+
+    spawn_action_t *action = &actions->actions[actions->count++];
+    action->type = type;
+    action->fd = fd;
+    action->newfd = newfd;
+    return EOK;
+}
+
+int posix_spawn_file_actions_adddup2(posix_spawn_file_actions_t *actions, fd_t fd, fd_t newfd)
+{
+    return add_action(actions, SPAWN_ACTION_DUP2, fd, newfd);
+}
+
+int posix_spawn_file_actions_addclose(posix_spawn_file_actions_t *actions, fd_t fd)
+{
+    return add_action(actions, SPAWN_ACTION_CLOSE, fd, EOF);
+}
+
+int posix_spawnattr_init(posix_spawnattr_t *attr)
+{
+    memset(attr, 0, sizeof(posix_spawnattr_t));
+    return EOK;
+}
+
+int posix_spawnattr_setflags(posix_spawnattr_t *attr, int flags)
+{
+    attr->flags = flags;
+    return EOK;
+}
+
+int posix_spawnattr_setpgroup(posix_spawnattr_t *attr, pid_t pgroup)
+{
+    attr->pgroup = pgroup;
+    return EOK;
+}
+
+int posix_spawnattr_setsigdefault(posix_spawnattr_t *attr, sigset_t sigdefault)
+{
+    attr->sigdefault = sigdefault;
+    return EOK;
+}
+
+int posix_spawnattr_setsigmask(posix_spawnattr_t *attr, sigset_t sigmask)
+{
+    attr->sigmask = sigmask;
+    return EOK;
+}
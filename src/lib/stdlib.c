@@ -46,6 +46,24 @@ u32 div_round_up(u32 num, u32 size)
     return (num + size - 1) / size;
 }
 
+// 没有 64 位除法的库函数，先用高 32 位得到商的高位，再用 divl 得到商的低位
+u64 div64(u64 num, u32 base, u32 *rem)
+{
+    u32 high = num >> 32;
+    u32 low = num;
+    u32 quot = high / base;
+    high %= base;
+
+    asm volatile(
+        "divl %4\n"
+        : "=a"(low), "=d"(high)
+        : "a"(low), "d"(high), "rm"(base));
+
+    if (rem)
+        *rem = high;
+    return ((u64)quot << 32) | low;
+}
+
 // 判断是否是数字
 bool isdigit(int c)
 {
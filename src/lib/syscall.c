@@ -1,5 +1,8 @@
 #include <onix/syscall.h>
 #include <onix/signal.h>
+#include <onix/spawn.h>
+#include <onix/clock.h>
+#include <onix/memory.h>
 
 static _inline u32 _syscall0(u32 nr)
 {
@@ -74,9 +77,9 @@ static _inline u32 _syscall6(u32 nr, u32 arg1, u32 arg2, u32 arg3, u32 arg4, u32
     return ret;
 }
 
-u32 test()
+u32 test(char *name)
 {
-    return _syscall0(SYS_NR_TEST);
+    return _syscall1(SYS_NR_TEST, (u32)name);
 }
 
 void exit(int status)
@@ -99,6 +102,19 @@ int execve(char *filename, char *argv[], char *envp[])
     return _syscall3(SYS_NR_EXECVE, (u32)filename, (u32)argv, (u32)envp);
 }
 
+int posix_spawn(pid_t *pid, char *path,
+                posix_spawn_file_actions_t *actions,
+                posix_spawnattr_t *attr,
+                char *argv[], char *envp[])
+{
+    int ret = _syscall5(SYS_NR_SPAWN, (u32)path, (u32)argv, (u32)envp, (u32)actions, (u32)attr);
+    if (ret < 0)
+        return -ret;
+    if (pid)
+        *pid = ret;
+    return EOK;
+}
+
 int kill(pid_t pid, int signal)
 {
     return _syscall2(SYS_NR_KILL, pid, signal);
@@ -119,6 +135,11 @@ void sleep(u32 ms)
     _syscall1(SYS_NR_SLEEP, ms);
 }
 
+int nanosleep(const timespec_t *req, timespec_t *rem)
+{
+    return _syscall2(SYS_NR_NANOSLEEP, (u32)req, (u32)rem);
+}
+
 pid_t getpid()
 {
     return _syscall0(SYS_NR_GETPID);
@@ -179,6 +200,36 @@ int munmap(void *addr, size_t length)
     return _syscall2(SYS_NR_MUNMAP, (u32)addr, length);
 }
 
+int msync(void *addr, size_t length, int flags)
+{
+    return _syscall3(SYS_NR_MSYNC, (u32)addr, length, flags);
+}
+
+int mprotect(void *addr, size_t length, int prot)
+{
+    return _syscall3(SYS_NR_MPROTECT, (u32)addr, length, prot);
+}
+
+int shmget(key_t key, size_t size, int flags)
+{
+    return _syscall3(SYS_NR_SHMGET, key, size, flags);
+}
+
+int shmctl(int shmid, int cmd, shmid_ds_t *buf)
+{
+    return _syscall3(SYS_NR_SHMCTL, shmid, cmd, (u32)buf);
+}
+
+void *shmat(int shmid, const void *addr, int flags)
+{
+    return (void *)_syscall3(SYS_NR_SHMAT, shmid, (u32)addr, flags);
+}
+
+int shmdt(const void *addr)
+{
+    return _syscall1(SYS_NR_SHMDT, (u32)addr);
+}
+
 fd_t dup(fd_t oldfd)
 {
     return _syscall1(SYS_NR_DUP, oldfd);
@@ -274,14 +325,27 @@ int umount(char *target)
     return _syscall1(SYS_NR_UMOUNT, (u32)target);
 }
 
+int swapon(char *devname)
+{
+    return _syscall1(SYS_NR_SWAPON, (u32)devname);
+}
+
 int mknod(char *filename, int mode, int dev)
 {
     return _syscall3(SYS_NR_MKNOD, (u32)filename, (u32)mode, (u32)dev);
 }
 
+// 读取时间不需要系统调用，直接读取内核时间页
 time_t time()
 {
-    return _syscall0(SYS_NR_TIME);
+    timespec_t tp;
+    vtime_gettime((vtime_t *)USER_VTIME_ADDR, CLOCK_REALTIME, &tp);
+    return tp.tv_sec;
+}
+
+int clock_gettime(clockid_t clock, timespec_t *tp)
+{
+    return vtime_gettime((vtime_t *)USER_VTIME_ADDR, clock, tp);
 }
 
 mode_t umask(mode_t mask)
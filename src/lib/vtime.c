@@ -0,0 +1,44 @@
+#include <onix/clock.h>
+#include <onix/syscall.h>
+#include <onix/stdlib.h>
+#include <onix/cpu.h>
+#include <onix/errno.h>
+
+// 周期数 64 位乘以 32 位，分成高低两部分避免溢出
+u64 vtime_monotonic(vtime_t *vt)
+{
+    u64 cycles = cpu_rdtsc() - vt->tsc_boot;
+    u64 low = (u64)(u32)cycles * vt->tsc_mult;
+    u64 high = (u64)(u32)(cycles >> 32) * vt->tsc_mult;
+    return (low >> TSC_SHIFT) + (high << (32 - TSC_SHIFT));
+}
+
+int vtime_gettime(vtime_t *vt, int clock, timespec_t *tp)
+{
+    u32 sec;
+    u32 nsec;
+    u32 jiffies;
+
+    switch (clock)
+    {
+    case CLOCK_REALTIME:
+    case CLOCK_MONOTONIC:
+        sec = div64(vtime_monotonic(vt), NSEC_PER_SEC, &nsec);
+        break;
+    case CLOCK_REALTIME_COARSE:
+    case CLOCK_MONOTONIC_COARSE:
+        jiffies = vt->jiffies;
+        sec = jiffies / HZ;
+        nsec = (jiffies % HZ) * NSEC_PER_JIFFY;
+        break;
+    default:
+        return -EINVAL;
+    }
+
+    if (clock == CLOCK_REALTIME || clock == CLOCK_REALTIME_COARSE)
+        sec += vt->startup_time;
+
+    tp->tv_sec = sec;
+    tp->tv_nsec = nsec;
+    return EOK;
+}
@@ -1,7 +1,7 @@
 #include <onix/net.h>
 #include <onix/net/arp.h>
 #include <onix/list.h>
-#include <onix/arena.h>
+#include <onix/slab.h>
 #include <onix/syscall.h>
 #include <onix/string.h>
 #include <onix/task.h>
@@ -31,10 +31,21 @@ typedef struct arp_entry_t
     netif_t *netif;    // 虚拟网卡
 } arp_entry_t;
 
+// ARP 缓存对象缓存
+static kmem_cache_t *arp_entry_cache;
+
+// 构造 ARP 缓存，等待队列释放时总是为空
+static void arp_entry_ctor(void *object)
+{
+    arp_entry_t *entry = (arp_entry_t *)object;
+    list_init(&entry->pbuf_list);
+}
+
 // 获取 ARP 缓存
 static arp_entry_t *arp_entry_get(netif_t *netif, ip_addr_t addr)
 {
-    arp_entry_t *entry = (arp_entry_t *)kmalloc(sizeof(arp_entry_t));
+    arp_entry_t *entry = (arp_entry_t *)kmem_cache_alloc(arp_entry_cache);
+    assert(list_empty(&entry->pbuf_list));
     entry->netif = netif;
     ip_addr_copy(entry->ipaddr, addr);
     eth_addr_copy(entry->hwaddr, ETH_BROADCAST);
@@ -43,7 +54,6 @@ static arp_entry_t *arp_entry_get(netif_t *netif, ip_addr_t addr)
     entry->retry = 0;
     entry->used = 1;
 
-    list_init(&entry->pbuf_list);
     list_insert_sort(
         &arp_entry_list,
         &entry->node,
@@ -63,7 +73,7 @@ static void arp_entry_put(arp_entry_t *entry)
     }
 
     list_remove(&entry->node);
-    kfree(entry);
+    kmem_cache_free(arp_entry_cache, entry);
 }
 
 static arp_entry_t *arp_lookup(netif_t *netif, ip_addr_t addr)
@@ -112,6 +122,8 @@ static err_t arp_query(arp_entry_t *entry)
     }
 
     pbuf_t *pbuf = pbuf_get();
+    if (!pbuf)
+        return -ENOMEM;
     arp_t *arp = pbuf->eth->arp;
 
     arp->opcode = htons(ARP_OP_REQUEST);
@@ -291,5 +303,6 @@ void arp_init()
 {
     LOGK("Address Resolution Protocol init...\n");
     list_init(&arp_entry_list);
+    arp_entry_cache = kmem_cache_create("arp_entry", sizeof(arp_entry_t), arp_entry_ctor);
     arp_task = task_create(arp_thread, "arp", 5, KERNEL_USER);
 }
@@ -224,6 +224,8 @@ void dhcp_release(dhcp_pcb_t *pcb)
         goto rollback;
 
     pbuf = pbuf_get();
+    if (!pbuf)
+        goto rollback;
 
     dhcp_t *dhcp = (dhcp_t *)pbuf->payload;
 
@@ -248,7 +250,8 @@ void dhcp_release(dhcp_pcb_t *pcb)
     LOGK("socket send %d\n", ret);
 
 rollback:
-    pbuf_put(pbuf);
+    if (pbuf)
+        pbuf_put(pbuf);
     close(fd);
 }
 
@@ -444,6 +447,8 @@ static void dhcp_discover(dhcp_pcb_t *pcb)
     }
 
     pbuf = pbuf_get();
+    if (!pbuf)
+        goto rollback;
 
     eth_t *eth = pbuf->eth;
     ip_t *ip = eth->ip;
@@ -528,7 +533,8 @@ static void dhcp_discover(dhcp_pcb_t *pcb)
     dhcp_parse_option(pcb, dhcp);
 
 rollback:
-    pbuf_put(pbuf);
+    if (pbuf)
+        pbuf_put(pbuf);
     close(fd);
 }
 
@@ -597,6 +603,8 @@ static void dhcp_request(dhcp_pcb_t *pcb)
         goto rollback;
 
     pbuf = pbuf_get();
+    if (!pbuf)
+        goto rollback;
 
     dhcp_t *dhcp = (dhcp_t *)pbuf->payload;
 
@@ -640,7 +648,8 @@ static void dhcp_request(dhcp_pcb_t *pcb)
     dhcp_parse_option(pcb, dhcp);
 
 rollback:
-    pbuf_put(pbuf);
+    if (pbuf)
+        pbuf_put(pbuf);
     close(fd);
 }
 
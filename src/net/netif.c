@@ -2,6 +2,7 @@
 #include <onix/net/dhcp.h>
 #include <onix/list.h>
 #include <onix/task.h>
+#include <onix/interrupt.h>
 #include <onix/device.h>
 #include <onix/arena.h>
 #include <onix/string.h>
@@ -102,7 +103,6 @@ netif_t *netif_create()
 {
     netif_t *netif = kmalloc(sizeof(netif_t));
     memset(netif, 0, sizeof(netif_t));
-    lock_init(&netif->rx_lock);
     lock_init(&netif->tx_lock);
 
     netif->index = list_size(&netif_list);
@@ -180,10 +180,10 @@ bool ip_addr_isown(ip_addr_t addr)
     return false;
 }
 
-// 网卡接收任务输入
+// 网卡接收任务输入，可能在软中断中调用，所以关中断保护接收队列，不能使用锁
 void netif_input(netif_t *netif, pbuf_t *pbuf)
 {
-    lock_acquire(&netif->rx_lock);
+    bool intr = interrupt_disable();
 
     while (netif->rx_pbuf_size >= NETIF_RX_PBUF_SIZE)
     {
@@ -200,7 +200,7 @@ void netif_input(netif_t *netif, pbuf_t *pbuf)
     {
         task_unblock(neti_task, EOK);
     }
-    lock_release(&netif->rx_lock);
+    set_interrupt_state(intr);
 }
 
 // 网卡发送任务输出
@@ -231,11 +231,11 @@ static void neti_thread()
 
             if (!list_empty(&netif->rx_pbuf_list))
             {
-                lock_acquire(&netif->rx_lock);
+                bool intr = interrupt_disable();
                 pbuf = element_entry(pbuf_t, node, list_popback(&netif->rx_pbuf_list));
                 assert(!pbuf->node.next && !pbuf->node.prev);
                 netif->rx_pbuf_size--;
-                lock_release(&netif->rx_lock);
+                set_interrupt_state(intr);
 
                 // LOGK("ETH RECV [%04X]: %m -> %m %d\n",
                 //      ntohs(pbuf->eth->type),
@@ -2,6 +2,7 @@
 #include <onix/memory.h>
 #include <onix/arena.h>
 #include <onix/string.h>
+#include <onix/interrupt.h>
 #include <onix/assert.h>
 #include <onix/debug.h>
 
@@ -11,18 +12,28 @@ static list_t free_pbuf_list;
 static size_t pbuf_count = 0;
 static size_t free_count = 0;
 
-// 获取空闲缓冲
+// 获取空闲缓冲，网卡在软中断中也会获取和释放缓冲，所以关中断访问空闲链表
+// 内核内存不足返回 NULL
 pbuf_t *pbuf_get()
 {
+    bool intr = interrupt_disable();
+
     pbuf_t *pbuf = NULL;
     if (list_empty(&free_pbuf_list))
     {
         u32 page = alloc_kpage(1);
+        if (!page)
+        {
+            set_interrupt_state(intr);
+            return NULL;
+        }
         pbuf = (pbuf_t *)page;
+        pbuf->count = 0;
         list_push(&free_pbuf_list, &pbuf->node);
 
         page += PAGE_SIZE / 2;
         pbuf = (pbuf_t *)page;
+        pbuf->count = 0;
         list_push(&free_pbuf_list, &pbuf->node);
 
         pbuf_count += 2;
@@ -35,6 +46,8 @@ pbuf_t *pbuf_get()
 
     pbuf->count = 1;
     free_count--;
+
+    set_interrupt_state(intr);
     return pbuf;
 }
 
@@ -44,20 +57,57 @@ void pbuf_put(pbuf_t *pbuf)
     // 应该对齐到 2K
     assert(((u32)pbuf & 0x7ff) == 0);
 
+    bool intr = interrupt_disable();
+
     assert(pbuf->count > 0 && pbuf->count <= 2);
     pbuf->count--;
-    if (pbuf->count > 0)
+    if (pbuf->count == 0)
     {
-        return;
+        list_push(&free_pbuf_list, &pbuf->node);
+        free_count++;
     }
 
-    list_push(&free_pbuf_list, &pbuf->node);
-    free_count++;
+    set_interrupt_state(intr);
     // LOGK("pbuf count (%d/%d)\n", free_count, pbuf_count);
 }
 
+// 内存回收，释放两半都空闲的页
+static u32 pbuf_shrink(u32 count)
+{
+    bool intr = interrupt_disable();
+
+    u32 freed = 0;
+    list_node_t *node = free_pbuf_list.tail.prev;
+    while (freed < count && node != &free_pbuf_list.head)
+    {
+        pbuf_t *pbuf = element_entry(pbuf_t, node, node);
+        pbuf_t *buddy = (pbuf_t *)((u32)pbuf ^ (PAGE_SIZE / 2));
+        if (buddy->count)
+        {
+            node = node->prev;
+            continue;
+        }
+
+        list_remove(&pbuf->node);
+        list_remove(&buddy->node);
+        free_kpage((u32)pbuf & ~(PAGE_SIZE - 1), 1);
+
+        pbuf_count -= 2;
+        free_count -= 2;
+        freed++;
+
+        // 链表已经改变，从头开始
+        node = free_pbuf_list.tail.prev;
+    }
+    set_interrupt_state(intr);
+
+    LOGK("pbuf shrink %d pages count (%d/%d)\n", freed, free_count, pbuf_count);
+    return freed;
+}
+
 // 初始化数据包缓冲
 void pbuf_init()
 {
     list_init(&free_pbuf_list);
+    shrinker_register(ZONE_KERNEL, pbuf_shrink);
 }
@@ -24,6 +24,7 @@ static int pkt_socket(socket_t *s, int domain, int type, int protocol)
     pcb->protocol = protocol;
 
     list_init(&pcb->rx_pbuf_list);
+    wait_queue_init(&pcb->rx_wait);
     list_push(&pkt_pcb_list, &pcb->node);
     return EOK;
 }
@@ -99,14 +100,9 @@ static int pkt_setsockopt(socket_t *s, int level, int optname, const void *optva
 
 static int pkt_recvmsg(socket_t *s, msghdr_t *msg, u32 flags)
 {
-    err_t ret = EOK;
-    if (list_empty(&s->pkt->rx_pbuf_list))
-    {
-        s->pkt->rx_waiter = running_task();
-        ret = task_block(s->pkt->rx_waiter, NULL, TASK_WAITING, s->rcvtimeo);
-        s->pkt->rx_waiter = NULL;
-    }
-
+    err_t ret;
+    wait_event(ret, &s->pkt->rx_wait, !list_empty(&s->pkt->rx_pbuf_list),
+               TASK_WAITING, s->rcvtimeo);
     if (ret != EOK)
         return ret;
 
@@ -133,10 +129,15 @@ static int pkt_sendmsg(socket_t *s, msghdr_t *msg, u32 flags)
         return EOK;
 
     pbuf_t *pbuf = pbuf_get();
+    if (!pbuf)
+        return -ENOMEM;
 
     ret = iovec_read(msg->iov, msg->iovlen, pbuf->payload, size);
     if (ret < EOK)
+    {
+        pbuf_put(pbuf);
         return ret;
+    }
     pbuf->length = size;
 
     netif_output(netif, pbuf);
@@ -181,11 +182,7 @@ static int pkt_recv(pkt_pcb_t *pcb, pbuf_t *pbuf)
 
     pbuf->count++;
     list_push(&pcb->rx_pbuf_list, &pbuf->node);
-    if (pcb->rx_waiter)
-    {
-        task_unblock(pcb->rx_waiter, EOK);
-        pcb->rx_waiter = NULL;
-    }
+    wake_up(&pcb->rx_wait, EOK);
     return true;
 }
 
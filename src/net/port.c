@@ -32,5 +32,6 @@ void port_put(port_map_t *map, u16 port)
 void port_init(port_map_t *map)
 {
     map->buf = alloc_kpage(2);
+    assert(map->buf);
     bitmap_init(&map->map, (char *)map->buf, PAGE_SIZE * 2, 0);
 }
\ No newline at end of file
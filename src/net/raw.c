@@ -23,6 +23,7 @@ static int raw_socket(socket_t *s, int domain, int type, int protocol)
     raw_pcb_t *pcb = s->raw;
     pcb->protocol = protocol;
     list_init(&pcb->rx_pbuf_list);
+    wait_queue_init(&pcb->rx_wait);
     list_push(&raw_pcb_list, &pcb->node);
 
     return EOK;
@@ -84,14 +85,9 @@ static int raw_getsockname(socket_t *s, sockaddr_t *name, int *namelen)
 
 static int raw_recvmsg(socket_t *s, msghdr_t *msg, u32 flags)
 {
-    err_t ret = EOK;
-    if (list_empty(&s->raw->rx_pbuf_list))
-    {
-        s->raw->rx_waiter = running_task();
-        ret = task_block(s->raw->rx_waiter, NULL, TASK_WAITING, s->rcvtimeo);
-        s->raw->rx_waiter = NULL;
-    }
-
+    err_t ret;
+    wait_event(ret, &s->raw->rx_wait, !list_empty(&s->raw->rx_pbuf_list),
+               TASK_WAITING, s->rcvtimeo);
     if (ret != EOK)
         return ret;
 
@@ -124,10 +120,15 @@ static int raw_sendmsg(socket_t *s, msghdr_t *msg, u32 flags)
         return ret;
 
     pbuf_t *pbuf = pbuf_get();
+    if (!pbuf)
+        return -ENOMEM;
 
     ret = iovec_read(msg->iov, msg->iovlen, pbuf->eth->payload, size);
     if (ret < EOK)
+    {
+        pbuf_put(pbuf);
         return ret;
+    }
 
     netif_t *netif = netif_route(pbuf->eth->ip->dst);
 
@@ -150,11 +151,7 @@ static int raw_recv(raw_pcb_t *pcb, pbuf_t *pbuf)
 
     pbuf->count++;
     list_push(&pcb->rx_pbuf_list, &pbuf->node);
-    if (pcb->rx_waiter)
-    {
-        task_unblock(pcb->rx_waiter, EOK);
-        pcb->rx_waiter = NULL;
-    }
+    wake_up(&pcb->rx_wait, EOK);
     return true;
 }
 
@@ -5,6 +5,7 @@
 #include <onix/mutex.h>
 #include <onix/fs.h>
 #include <onix/string.h>
+#include <onix/assert.h>
 #include <onix/debug.h>
 #include <onix/errno.h>
 
@@ -297,6 +298,7 @@ rollback:
 void resolv_init()
 {
     buf = pbuf_get();
+    assert(buf);
 
     lock_init(&resolv_lock);
     inet_aton("114.114.114.114", nameserver);
@@ -118,20 +118,13 @@ static int tcp_accept(socket_t *s, sockaddr_t *addr, int *addrlen, socket_t **ns
     if (pcb->state != LISTEN)
         return -EINVAL;
 
-    err_t ret = EOK;
-
-    tcp_pcb_t *npcb = tcp_find_npcb(pcb);
-    if (!npcb)
-    {
-        pcb->ac_waiter = running_task();
-        ret = task_block(pcb->ac_waiter, NULL, TASK_WAITING, s->rcvtimeo);
-        pcb->ac_waiter = NULL;
-
-        if (ret < 0)
-            return ret;
-        npcb = tcp_find_npcb(pcb);
-        assert(npcb);
-    }
+    // 多个任务可以在同一个监听套接字上等待，每个建立的连接只被一个任务取走
+    err_t ret;
+    tcp_pcb_t *npcb;
+    wait_event(ret, &pcb->ac_wait, (npcb = tcp_find_npcb(pcb)) != NULL,
+               TASK_WAITING, s->rcvtimeo);
+    if (ret < 0)
+        return ret;
 
     socket_t *sock = socket_create();
     sock->type = SOCK_TYPE_TCP;
@@ -197,21 +190,20 @@ static int tcp_connect(socket_t *s, const sockaddr_t *name, int namelen)
     if (!pcb->lport)
         pcb->lport = port_get(&tcp_port_map, 0);
 
+    err_t ret = tcp_enqueue(pcb, NULL, 0, TCP_SYN);
+    if (ret < EOK)
+        return ret;
+
     pcb->state = SYN_SENT;
 
     list_remove(&pcb->node);
     list_push(&tcp_pcb_active_list, &pcb->node);
 
-    tcp_enqueue(pcb, NULL, 0, TCP_SYN);
     tcp_output(pcb);
 
     pcb->timers[TCP_TIMER_SYN] = TCP_TO_SYN;
 
-    pcb->ac_waiter = running_task();
-    int ret = task_block(pcb->ac_waiter, NULL, TASK_WAITING, s->sndtimeo);
-    pcb->ac_waiter = NULL;
-
-    return ret;
+    return wait_timeout(&pcb->ac_wait, TASK_WAITING, s->sndtimeo);
 }
 
 static int tcp_shutdown(socket_t *s, int how)
@@ -294,13 +286,7 @@ static int tcp_recvmsg(socket_t *s, msghdr_t *msg, u32 flags)
     if (pcb->state != ESTABLISHED)
         return -EINVAL;
 
-    if (list_empty(&pcb->recved))
-    {
-        pcb->rx_waiter = running_task();
-        ret = task_block(pcb->rx_waiter, NULL, TASK_WAITING, s->rcvtimeo);
-        pcb->rx_waiter = NULL;
-    }
-
+    wait_event(ret, &pcb->rx_wait, !list_empty(&pcb->recved), TASK_WAITING, s->rcvtimeo);
     if (ret < EOK)
         return ret;
 
@@ -377,18 +363,21 @@ static int tcp_sendmsg(socket_t *s, msghdr_t *msg, u32 flags)
             continue;
 
         int len = left < iov->size ? left : iov->size;
-        tcp_enqueue(pcb, iov->base, len, flags);
-        left -= len;
+        u32 nbb = pcb->snd_nbb;
+        ret = tcp_enqueue(pcb, iov->base, len, flags);
+        left -= pcb->snd_nbb - nbb;
+        if (ret < EOK)
+            break;
     }
-    tcp_output(pcb);
-
-    if (list_empty(&pcb->unacked) && list_empty(&pcb->unsent))
-        return size - left;
 
-    pcb->tx_waiter = running_task();
-    ret = task_block(pcb->tx_waiter, NULL, TASK_WAITING, s->sndtimeo);
-    pcb->tx_waiter = NULL;
+    // 内存不足，一个字节也没有发送
+    if (left == size && ret < EOK)
+        return ret;
+    tcp_output(pcb);
 
+    wait_event(ret, &pcb->tx_wait,
+               list_empty(&pcb->unacked) && list_empty(&pcb->unsent),
+               TASK_WAITING, s->sndtimeo);
     if (ret < 0)
         return ret;
 
@@ -142,10 +142,9 @@ static void tcp_update_ack(tcp_pcb_t *pcb, pbuf_t *pbuf, tcp_t *tcp)
         pcb->snd_buf = NULL;
     }
 
-    if (list_empty(&pcb->unacked) && list_empty(&pcb->unsent) && pcb->tx_waiter)
+    if (list_empty(&pcb->unacked) && list_empty(&pcb->unsent) && wait_queue_active(&pcb->tx_wait))
     {
-        task_unblock(pcb->tx_waiter, EOK);
-        pcb->tx_waiter = NULL;
+        wake_up_all(&pcb->tx_wait, EOK);
         pcb->timers[TCP_TIMER_REXMIT] = 0;
     }
 }
@@ -205,11 +204,7 @@ static void tcp_update_buf(tcp_pcb_t *pcb, pbuf_t *pbuf, tcp_t *tcp)
         &pbuf->tcpnode,
         element_node_offset(pbuf_t, tcpnode, seqno));
 
-    if (pcb->rx_waiter)
-    {
-        task_unblock(pcb->rx_waiter, EOK);
-        pcb->rx_waiter = NULL;
-    }
+    wake_up_all(&pcb->rx_wait, EOK);
 }
 
 static err_t tcp_receive(tcp_pcb_t *pcb, pbuf_t *pbuf, tcp_t *tcp)
@@ -244,11 +239,7 @@ static err_t tcp_handle_syn_sent(tcp_pcb_t *pcb, tcp_t *tcp)
     if (pcb->flags & TF_QUICKACK)
         tcp_send_ack(pcb, TCP_ACK);
 
-    if (pcb->ac_waiter)
-    {
-        task_unblock(pcb->ac_waiter, EOK);
-        pcb->ac_waiter = NULL;
-    }
+    wake_up_all(&pcb->ac_wait, EOK);
 
     LOGK("TCP ESTABLISHED client\n");
     return EOK;
@@ -328,11 +319,7 @@ static err_t tcp_process(tcp_pcb_t *pcb, netif_t *netif, pbuf_t *pbuf, ip_t *ip,
         pcb->snd_nbb = tcp->ackno;
 
         assert(pcb->listen);
-        if (pcb->listen->ac_waiter)
-        {
-            task_unblock(pcb->listen->ac_waiter, EOK);
-            pcb->listen->ac_waiter;
-        }
+        wake_up(&pcb->listen->ac_wait, EOK);
         break;
     case CLOSE_WAIT:
     case ESTABLISHED:
@@ -55,7 +55,10 @@ err_t tcp_enqueue(tcp_pcb_t *pcb, void *data, size_t size, int flags)
     {
         if (!pcb->snd_buf)
         {
+            // 内存不足，已经拷贝的数据留在队列中，调用者根据 snd_nbb 得到拷贝的数量
             pcb->snd_buf = pbuf_get();
+            if (!pcb->snd_buf)
+                return -ENOMEM;
             pbuf = pcb->snd_buf;
 
             ip = pbuf->eth->ip;
@@ -187,6 +190,8 @@ err_t tcp_rexmit(tcp_pcb_t *pcb)
 err_t tcp_send_ack(tcp_pcb_t *pcb, u8 flags)
 {
     pbuf_t *pbuf = pbuf_get();
+    if (!pbuf)
+        return -ENOMEM;
     ip_t *ip = pbuf->eth->ip;
     ip_addr_copy(ip->dst, pcb->raddr);
 
@@ -215,6 +220,8 @@ err_t tcp_reset(u32 seqno, u32 ackno, ip_addr_t laddr, u16 lport, ip_addr_t radd
     assert(netif);
 
     pbuf_t *pbuf = pbuf_get();
+    if (!pbuf)
+        return -ENOMEM;
     ip_t *ip = pbuf->eth->ip;
     tcp_t *tcp = ip->tcp;
 
@@ -244,6 +251,8 @@ err_t tcp_response(tcp_pcb_t *pcb, u32 seqno, u32 ackno, u8 flags)
     assert(netif);
 
     pbuf_t *pbuf = pbuf_get();
+    if (!pbuf)
+        return -ENOMEM;
     ip_t *ip = pbuf->eth->ip;
     tcp_t *tcp = ip->tcp;
 
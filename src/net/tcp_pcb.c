@@ -2,7 +2,7 @@
 #include <onix/net/port.h>
 #include <onix/net.h>
 #include <onix/list.h>
-#include <onix/arena.h>
+#include <onix/slab.h>
 #include <onix/task.h>
 #include <onix/string.h>
 #include <onix/assert.h>
@@ -17,10 +17,12 @@ list_t tcp_pcb_timewait_list; // 等待 pcb 列表
 
 extern port_map_t tcp_port_map; // 端口位图
 
+static kmem_cache_t *tcp_pcb_cache; // pcb 缓存
+
 tcp_pcb_t *tcp_pcb_get()
 {
     LOGK("tcp pcb get...\n");
-    tcp_pcb_t *pcb = (tcp_pcb_t *)kmalloc(sizeof(tcp_pcb_t));
+    tcp_pcb_t *pcb = (tcp_pcb_t *)kmem_cache_alloc(tcp_pcb_cache);
     memset(pcb, 0, sizeof(tcp_pcb_t));
 
     pcb->rcv_nxt = 0;
@@ -49,6 +51,10 @@ tcp_pcb_t *tcp_pcb_get()
     list_init(&pcb->recved);
     list_init(&pcb->acclist);
 
+    wait_queue_init(&pcb->ac_wait);
+    wait_queue_init(&pcb->tx_wait);
+    wait_queue_init(&pcb->rx_wait);
+
     list_push(&tcp_pcb_create_list, &pcb->node);
     return pcb;
 }
@@ -82,23 +88,9 @@ void tcp_pcb_purge(tcp_pcb_t *pcb, err_t reason)
         tcp_pcb_put(npcb);
     }
 
-    if (pcb->ac_waiter)
-    {
-        task_unblock(pcb->ac_waiter, reason);
-        pcb->ac_waiter = NULL;
-    }
-
-    if (pcb->rx_waiter)
-    {
-        task_unblock(pcb->rx_waiter, reason);
-        pcb->rx_waiter = NULL;
-    }
-
-    if (pcb->tx_waiter)
-    {
-        task_unblock(pcb->tx_waiter, reason);
-        pcb->tx_waiter = NULL;
-    }
+    wake_up_all(&pcb->ac_wait, reason);
+    wake_up_all(&pcb->rx_wait, reason);
+    wake_up_all(&pcb->tx_wait, reason);
     LOGK("TCP PURGE %#p\n", pcb);
 }
 
@@ -119,7 +111,7 @@ void tcp_pcb_put(tcp_pcb_t *pcb)
         port_put(&tcp_port_map, pcb->lport);
     tcp_pcb_purge(pcb, -ETIME);
     list_remove(&pcb->node);
-    kfree(pcb);
+    kmem_cache_free(tcp_pcb_cache, pcb);
     LOGK("tcp pcb put...\n");
 }
 
@@ -164,4 +156,6 @@ void tcp_pcb_init()
     list_init(&tcp_pcb_active_list);
     list_init(&tcp_pcb_timewait_list);
     list_init(&tcp_pcb_listen_list);
+
+    tcp_pcb_cache = kmem_cache_create("tcp_pcb", sizeof(tcp_pcb_t), NULL);
 }
\ No newline at end of file
@@ -23,6 +23,7 @@ static int udp_socket(socket_t *s, int domain, int type, int protocol)
 
     udp_pcb_t *pcb = s->udp;
     list_init(&pcb->rx_pbuf_list);
+    wait_queue_init(&pcb->rx_wait);
     list_push(&udp_pcb_list, &pcb->node);
     return EOK;
 }
@@ -125,14 +126,10 @@ static udp_pcb_t *find_udp_pcb(ip_addr_t raddr, u16 rport, ip_addr_t laddr, u16
 
 static int udp_recvmsg(socket_t *s, msghdr_t *msg, u32 flags)
 {
-    err_t ret = EOK;
-    if (list_empty(&s->udp->rx_pbuf_list))
-    {
-        s->udp->rx_waiter = running_task();
-        ret = task_block(s->udp->rx_waiter, NULL, TASK_WAITING, s->rcvtimeo);
-        s->udp->rx_waiter = NULL;
-    }
-
+    // 多个任务在同一个套接字上接收时，被唤醒后数据包可能已经被取走
+    err_t ret;
+    wait_event(ret, &s->udp->rx_wait, !list_empty(&s->udp->rx_pbuf_list),
+               TASK_WAITING, s->rcvtimeo);
     if (ret != EOK)
         return ret;
 
@@ -211,11 +208,16 @@ static int udp_sendmsg(socket_t *s, msghdr_t *msg, u32 flags)
         return ret;
 
     pbuf_t *pbuf = pbuf_get();
+    if (!pbuf)
+        return -ENOMEM;
     udp_t *udp = pbuf->eth->ip->udp;
 
     ret = iovec_read(msg->iov, msg->iovlen, udp->payload, size);
     if (ret < EOK)
+    {
+        pbuf_put(pbuf);
         return ret;
+    }
 
     if (msg->name)
     {
@@ -250,11 +252,7 @@ int udp_input(netif_t *netif, pbuf_t *pbuf)
 
     pbuf->count++;
     list_push(&pcb->rx_pbuf_list, &pbuf->node);
-    if (pcb->rx_waiter)
-    {
-        task_unblock(pcb->rx_waiter, EOK);
-        pcb->rx_waiter = NULL;
-    }
+    wake_up(&pcb->rx_wait, EOK);
 
     return EOK;
 }
@@ -9,6 +9,7 @@ bochsg: $(IMAGES)
 
 QEMU:= qemu-system-i386 # 虚拟机
 QEMU+= -m 32M # 内存
+QEMU+= -smp 4 # 处理器数量
 QEMU+= -audiodev pa,id=snd # 音频设备
 QEMU+= -machine pcspk-audiodev=snd # pcspeaker 设备
 QEMU+= -device sb16,audiodev=snd # Sound Blaster 16